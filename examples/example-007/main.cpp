@@ -13,6 +13,9 @@
 #include <vector>
 
 #include "../../src/vtx/ctx.h"
+#include "../../src/vtx/shader-program.h"
+#include "../../src/vtx/gpu-memory-panel.h"
+#include "../../src/vtx/profiler-panel.h"
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
 #include "imgui_impl_sdl2.h"
@@ -64,12 +67,12 @@ struct Gizmo {
     // clang-format on
 
     GLuint gizmoVAO;
-    GLuint gizmoShader;
+    vtx::GpuBuffer gizmoVBO;
+    vtx::ShaderProgram gizmoShader;
+    vtx::UniformHandle modelToWorldUniform = "u_modelToWorld";
 
     void init();
-    void updateProjectionMatrix(const glm::mat4 projectionMatrix) const;
     void updateTransformationMatrix(const glm::mat4 transformationMatrix) const;
-    void updateViewMatrix(const glm::mat4 viewMatrix) const;
     void draw() const;
 };  
 
@@ -79,6 +82,7 @@ const char* Gizmo::GIZMO_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
     precision mediump float;
 
@@ -88,8 +92,6 @@ const char* Gizmo::GIZMO_VERTEX_SHADER =
     out float v_direction;
 
     uniform mat4 u_modelToWorld;
-    uniform mat4 u_worldToView;  // World to View matrix
-    uniform mat4 u_projection;   // Projection matrix
 
     void main() {
         v_direction = a_direction;
@@ -97,7 +99,7 @@ const char* Gizmo::GIZMO_VERTEX_SHADER =
         // Transform the vertex position from world space to view space
         // and then to clip space
         vec3 crntPos = vec3(u_modelToWorld * vec4(a_position, 1.0f));
-        gl_Position  = u_projection * u_worldToView * vec4(crntPos, 1.0f);
+        gl_Position  = u_viewProjection * vec4(crntPos, 1.0f);
     }
     )";
 
@@ -128,15 +130,12 @@ const char* Gizmo::GIZMO_FRAGMENT_SHADER =
 void Gizmo::init()
 {
     glGenVertexArrays(1, &gizmoVAO);
-    glBindVertexArray(this->gizmoVAO);
+    vtx::bindVertexArray(this->gizmoVAO);
 
     // Create a vertex buffer for gizmo
-    GLuint gizmoVBO;
-    glGenBuffers(1, &gizmoVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, gizmoVBO);
-    glBufferData(
+    this->gizmoVBO.create(
         GL_ARRAY_BUFFER, sizeof(gizmoVertices), gizmoVertices,
-        GL_STATIC_DRAW
+        GL_STATIC_DRAW, "gizmo"
     );
     // Enable vertex attribute and bind it to shader location
     glVertexAttribPointer(
@@ -149,63 +148,26 @@ void Gizmo::init()
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);                      // VAO
-    glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+    vtx::bindVertexArray(0);                      // VAO
+    vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+    vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
 
-    this->gizmoShader = vtx::createShaderProgram(
-        GIZMO_VERTEX_SHADER, GIZMO_FRAGMENT_SHADER
-    );
-}
-
-void Gizmo::updateProjectionMatrix(const glm::mat4 projectionMatrix) const
-{
-    glUseProgram(this->gizmoShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->gizmoShader, "u_projection"
-        ),                                // uniform location
-        1,                                // number of matrices
-        GL_FALSE,                         // transpose
-        glm::value_ptr(projectionMatrix)  // value
+    this->gizmoShader.create(
+        GIZMO_VERTEX_SHADER, GIZMO_FRAGMENT_SHADER, "gizmo"
     );
 }
 
 void Gizmo::updateTransformationMatrix(const glm::mat4 transformationMatrix) const
 {
-    glUseProgram(this->gizmoShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->gizmoShader, "u_modelToWorld"
-        ),                                    // uniform location
-        1,                                    // number of matrices
-        GL_FALSE,                             // transpose
-        glm::value_ptr(transformationMatrix)  // value
-    );
-}
-
-void Gizmo::updateViewMatrix(const glm::mat4 viewMatrix) const
-{
-    glUseProgram(this->gizmoShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->gizmoShader, "u_worldToView"
-        ),                          // uniform location
-        1,                          // number of matrices
-        GL_FALSE,                   // transpose
-        glm::value_ptr(viewMatrix)  // value
-    );
+    this->gizmoShader.set(this->modelToWorldUniform, transformationMatrix);
 }
 
 void Gizmo::draw() const
 {
-    glUseProgram(this->gizmoShader);
-    glBindVertexArray(this->gizmoVAO);
+    this->gizmoShader.use();
+    vtx::bindVertexArray(this->gizmoVAO);
 
-    glDrawArrays(
+    vtx::drawArrays(
         GL_TRIANGLES,            // Only this is supported in GLES
         0,                       // Start from
         sizeof(gizmoVertices) /  // Total size /
@@ -213,7 +175,7 @@ void Gizmo::draw() const
             )  // DIV size of element = one vertex size
     );
 
-    glBindVertexArray(0);
+    vtx::bindVertexArray(0);
 }
 
 struct MyVertex {
@@ -240,7 +202,10 @@ struct MyMesh {
     std::vector<MyVertex> vertices;
     std::vector<unsigned int> indices;
     GLuint modelVAO;
-    GLuint defaultShader;
+    vtx::GpuBuffer vertexBuffer, indexBuffer;
+    vtx::ShaderProgram defaultShader;
+    vtx::UniformHandle modelToWorldUniform       = "u_modelToWorld";
+    vtx::UniformHandle selectedJointIndexUniform = "u_selectedJointIndex";
     const aiScene* scene;
     const aiMesh* mesh;
 
@@ -252,9 +217,7 @@ struct MyMesh {
 
     void init();
     void loadModel(const char* path, const int meshIndex);
-    void updateProjectionMatrix(const glm::mat4 projectionMatrix) const;
     void updateTransformationMatrix(const glm::mat4 transformationMatrix) const;
-    void updateViewMatrix(const glm::mat4 viewMatrix) const;
     void updateSelectedJointIndex(GLuint selectedBoneIndex) const;
     void draw() const;
 };
@@ -265,6 +228,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
 	precision mediump float;
 
@@ -279,9 +243,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
     out vec3 v_normal;
     out vec3 v_lightPos;
 
-    uniform mat4 u_worldToView;
     uniform mat4 u_modelToWorld;
-    uniform mat4 u_projection;
 
     uniform uint u_selectedJointIndex;
 
@@ -328,7 +290,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
             v_color = calculateBoneHotnessColor(weight_4);
         }
 
-        gl_Position   = u_projection * u_worldToView * vec4(v_crntPos, 1.0f);
+        gl_Position   = u_viewProjection * vec4(v_crntPos, 1.0f);
 	}
 	)";
 
@@ -371,31 +333,25 @@ void MyMesh::init()
 {
     // Create VAO
     glGenVertexArrays(1, &modelVAO);
-    glBindVertexArray(modelVAO);
+    vtx::bindVertexArray(modelVAO);
 
     // Create VBO with vertices
-    GLuint VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(
+    this->vertexBuffer.create(
         GL_ARRAY_BUFFER,
         vertices.size() *
             sizeof(MyVertex),  // all vertices in bytes
-        vertices.data(), GL_STATIC_DRAW
+        vertices.data(), GL_STATIC_DRAW, "mesh"
     );
 
     // Create EBO with indexes
-    GLuint EBO;
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(
+    this->indexBuffer.create(
         GL_ELEMENT_ARRAY_BUFFER,  // This is used for EBO
         indices.size() * sizeof(unsigned int), indices.data(),
-        GL_STATIC_DRAW
+        GL_STATIC_DRAW, "mesh"
     );
 
     // Links VBO attributes such as coordinates and colors to VAO
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    vtx::bindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer.id);
 
     // clang-format off
     // These are the basic
@@ -415,23 +371,26 @@ void MyMesh::init()
     glEnableVertexAttribArray(4);
 
     // Unbind all to prevent accidentally modifying them
-    glBindVertexArray(0);                      // VAO
-    glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+    vtx::bindVertexArray(0);                      // VAO
+    vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+    vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
 
-    defaultShader = vtx::createShaderProgram(
-        MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER
+    defaultShader.create(
+        MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER, "model"
     );
 }
 
 void MyMesh::loadModel(const char* path, const int meshIndex)
 {
-    this->scene = importer.ReadFile(
-        path,  // path of the file
-        aiProcess_Triangulate | aiProcess_FlipUVs |
-            // aiProcess_GenNormals |
-            aiProcess_CalcTangentSpace
-    );
+    {
+        VTX_TRACE_SCOPE_DETAIL("Assimp::Importer::ReadFile", path);
+        this->scene = importer.ReadFile(
+            path,  // path of the file
+            aiProcess_Triangulate | aiProcess_FlipUVs |
+                // aiProcess_GenNormals |
+                aiProcess_CalcTangentSpace
+        );
+    }
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
         !scene->mRootNode) {
@@ -562,72 +521,33 @@ void MyMesh::loadModel(const char* path, const int meshIndex)
 }
 
 
-void MyMesh::updateProjectionMatrix(const glm::mat4 projectionMatrix) const
-{
-    glUseProgram(this->defaultShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->defaultShader, "u_projection"
-        ),                                // uniform location
-        1,                                // number of matrices
-        GL_FALSE,                         // transpose
-        glm::value_ptr(projectionMatrix)  // value
-    );
-}
-
 void MyMesh::updateTransformationMatrix(const glm::mat4 transformationMatrix
 ) const
 {
-    glUseProgram(this->defaultShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->defaultShader, "u_modelToWorld"
-        ),                                    // uniform location
-        1,                                    // number of matrices
-        GL_FALSE,                             // transpose
-        glm::value_ptr(transformationMatrix)  // value
-    );
-}
-
-void MyMesh::updateViewMatrix(const glm::mat4 viewMatrix) const
-{
-    glUseProgram(this->defaultShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->defaultShader, "u_worldToView"
-        ),                          // uniform location
-        1,                          // number of matrices
-        GL_FALSE,                   // transpose
-        glm::value_ptr(viewMatrix)  // value
-    );
+    this->defaultShader.set(this->modelToWorldUniform, transformationMatrix);
 }
 
 void MyMesh::updateSelectedJointIndex(GLuint selectedBoneIndex) const
 {
-    glUseProgram(this->defaultShader);
-    glUniform1ui(
-        glGetUniformLocation(
-            this->defaultShader, "u_selectedJointIndex"
-        ),                 // Loc
-        selectedBoneIndex  // value
+    this->defaultShader.set(
+        this->selectedJointIndexUniform, selectedBoneIndex
     );
 }
 
 void MyMesh::draw() const
 {
+    VTX_PROFILE_GPU_SCOPE("MyMesh::draw");
+
     // Draw using default shader
-    glUseProgram(this->defaultShader);
-    glBindVertexArray(this->modelVAO);
-    glDrawElements(
+    this->defaultShader.use();
+    vtx::bindVertexArray(this->modelVAO);
+    vtx::drawElements(
         GL_TRIANGLES,     // Mode
         indices.size(),   // Index count
         GL_UNSIGNED_INT,  // Data type of indices array
         (void*) (0 * sizeof(unsigned int))  // Indices pointer
     );
-    glBindVertexArray(0);
+    vtx::bindVertexArray(0);
 }
 
 struct MyImGui {
@@ -684,8 +604,12 @@ void MyImGui::newFrame() const
 
 void MyImGui::renderFrame() const
 {
+    VTX_PROFILE_GPU_SCOPE("MyImGui::renderFrame");
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    // ImGui sets its own GL state, so what we shadow is stale now
+    vtx::invalidateGLState();
 }
 
     void MyImGui::showMatrixEditor(glm::mat4* matrix, const char* title) const
@@ -838,6 +762,9 @@ struct UserContext {
     Gizmo gizmo;
     MyMesh human;
     MyImGui imgui;
+
+    // Only changes when the window does
+    glm::mat4 projection;
 };
 
 UserContext usr;
@@ -854,6 +781,15 @@ glm::mat4 cameraMatrix = glm::lookAt(
 
 glm::mat4 modelToWorld = glm::mat4(1.0f);  // Identity matrix
 
+glm::mat4 perspectiveFor(int screenWidth, int screenHeight)
+{
+    float fov       = glm::radians(45.0f);  // Field of view in radians
+    float nearPlane = 0.1f;    // Distance to the near clipping plane
+    float farPlane  = 100.0f;  // Distance to the far clipping plane
+    float aspectRatio = (float) screenWidth / (float) screenHeight;
+    return glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+}
+
 void vtx::init(vtx::VertexContext* ctx)
 {
     // GLB file contains normals, but Blender not
@@ -862,54 +798,55 @@ void vtx::init(vtx::VertexContext* ctx)
     usr.gizmo.init();
     usr.imgui.init(ctx);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_DEPTH_TEST);
-
-    // Figure projection matrix
-    float fov       = glm::radians(45.0f);  // Field of view in radians
-    float nearPlane = 0.1f;    // Distance to the near clipping plane
-    float farPlane  = 100.0f;  // Distance to the far clipping plane
-    // Actually, this needs to be recalculated in the loop,
-    // as window could be resized at any time by user
-    float aspectRatio = ctx->screenWidth / ctx->screenHeight;
-
-    // But, here is the initials perspective matrix
-    glm::mat4 projectionMatrix =
-        glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+    vtx::enable(GL_BLEND);
+    vtx::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    vtx::enable(GL_DEPTH_TEST);
 
-    usr.human.updateProjectionMatrix(projectionMatrix);
-    usr.gizmo.updateProjectionMatrix(projectionMatrix);
+    // Recalculated in the loop when the window is resized
+    usr.projection = perspectiveFor(ctx->screenWidth, ctx->screenHeight);
 }
 
 void vtx::loop(vtx::VertexContext* ctx)
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event) != 0) {
-        if (event.type == SDL_QUIT) {
-            vtx::exitVortex();
-            return;
-        }
-        if (event.type == SDL_KEYDOWN) {
-            if (event.key.keysym.sym == SDLK_ESCAPE) {
+    {
+        VTX_PROFILE_SCOPE("handleEvents");
+        for (SDL_Event& event : ctx->input.events) {
+            if (event.type == SDL_QUIT) {
                 vtx::exitVortex();
                 return;
             }
-        }
+            if (event.type == SDL_WINDOWEVENT &&
+                event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                ctx->screenWidth  = event.window.data1;
+                ctx->screenHeight = event.window.data2;
+                usr.projection =
+                    perspectiveFor(ctx->screenWidth, ctx->screenHeight);
+            }
+            if (event.type == SDL_KEYDOWN) {
+                if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    vtx::exitVortex();
+                    return;
+                }
+            }
 
-        usr.imgui.processEvent(&event);
+            usr.imgui.processEvent(&event);
+        }
     }
 
     glClearColor(0.1f, 0.4f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // Camera and projection for every shader at once
+    vtx::writeFrameConstants(
+        cameraMatrix, usr.projection, ctx->frameTime, ctx->deltaTime,
+        ctx->screenWidth, ctx->screenHeight
+    );
+
     usr.human.updateTransformationMatrix(modelToWorld);
-    usr.human.updateViewMatrix(cameraMatrix);
     usr.human.updateSelectedJointIndex(usr.imgui.selectedBoneIndex);
     usr.human.draw();
 
     usr.gizmo.updateTransformationMatrix(modelToWorld);
-    usr.gizmo.updateViewMatrix(cameraMatrix);
     usr.gizmo.draw();
 
     usr.imgui.newFrame();  // --------------------------
@@ -919,11 +856,13 @@ void vtx::loop(vtx::VertexContext* ctx)
     );
     usr.imgui.showMatrixEditor(&cameraMatrix, "Camera matrix");
     usr.imgui.renderBoneHierarchy(usr.human.scene, usr.human.mesh);
+    vtx::showProfilerPanel();
+    vtx::showGpuMemoryPanel();
 
     usr.imgui.renderFrame();  // ------------------------
 
     checkOpenGLError();
-    SDL_GL_SwapWindow(ctx->sdlWindow);
+    vtx::swapWindow(ctx);
 }
 
 int main(int argc, char* argv[]) { vtx::openVortex(); }
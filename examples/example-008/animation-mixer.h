@@ -10,6 +10,8 @@
 #include <map>
 #include <vector>
 
+#include "../../src/vtx/jobs.h"
+#include "../../src/vtx/profiler.h"
 #include "imgui.h"
 
 #define MAX_BONES (200)
@@ -32,9 +34,19 @@ struct AnimationMixer {
     std::map<std::string, uint> boneNameToIndex;
     std::vector<glm::mat4> boneOffsets;
 
+    // Node tree flattened in pre-order, so every parent comes before
+    // its children and the tree can be walked without recursion
+    std::vector<const aiNode*> nodes;
+    std::vector<int> nodeParents;  // -1 for the root
+    std::vector<int> nodeBones;    // -1 for nodes that are not bones
+    std::vector<glm::mat4> nodeTransforms;  // local, this frame
+    std::vector<glm::mat4> nodeCascades;    // to model space
+
     void initBones(const aiScene* scene, const aiMesh* mesh);
+    void flattenNodeTree(const aiNode* pNode, int parentIndex);
 
-    std::vector<glm::mat4> hydrateBoneTransforms(
+    void hydrateBoneTransforms(
+        vtx::JobSystem* jobs,
         std::vector<glm::mat4>& Transforms,
         float currentSecond,
         unsigned int animationIndex0,
@@ -61,18 +73,16 @@ struct AnimationMixer {
 
     const aiNodeAnim* findChannel(
         const aiAnimation& Animation,
-        const std::string& NodeName
+        const aiString& NodeName
     );
 
-    void applyBoneTransformsFromNodeTree(
+    glm::mat4 calcNodeTransform(
         const aiAnimation& Animation0,
         float currentTick0,
         const aiAnimation& Animation1,
         float currentTick1,
         float blendingFactor,
-        const aiNode* pNode,
-        const glm::mat4& parentTransform,
-        std::vector<glm::mat4>& Transforms
+        const aiNode* pNode
     );
 
     float calcAnimationTick(
@@ -139,9 +149,36 @@ void AnimationMixer::initBones(const aiScene* scene, const aiMesh* mesh)
             assimpToGlmMatrix(pBone->mOffsetMatrix)
         );
     }
+
+    this->nodes.clear();
+    this->nodeParents.clear();
+    this->nodeBones.clear();
+    flattenNodeTree(this->scene->mRootNode, -1);
+    this->nodeTransforms.resize(this->nodes.size());
+    this->nodeCascades.resize(this->nodes.size());
+}
+
+void AnimationMixer::flattenNodeTree(
+    const aiNode* pNode,
+    int parentIndex
+)
+{
+    int index = (int) this->nodes.size();
+    this->nodes.push_back(pNode);
+    this->nodeParents.push_back(parentIndex);
+
+    auto bone = this->boneNameToIndex.find(pNode->mName.data);
+    this->nodeBones.push_back(
+        bone != this->boneNameToIndex.end() ? (int) bone->second : -1
+    );
+
+    for (uint i = 0; i < pNode->mNumChildren; i++) {
+        flattenNodeTree(pNode->mChildren[i], index);
+    }
 }
 
-std::vector<glm::mat4> AnimationMixer::hydrateBoneTransforms(
+void AnimationMixer::hydrateBoneTransforms(
+    vtx::JobSystem* jobs,
     std::vector<glm::mat4>& Transforms,
     float currentSecond,
     unsigned int animationIndex0,
@@ -151,6 +188,8 @@ std::vector<glm::mat4> AnimationMixer::hydrateBoneTransforms(
     float blendingFactor
 )
 {
+    VTX_PROFILE_SCOPE("AnimationMixer::hydrateBoneTransforms");
+
     this->globalInverseTransform = glm::inverse(
         assimpToGlmMatrix(this->scene->mRootNode->mTransformation)
     );
@@ -177,16 +216,44 @@ std::vector<glm::mat4> AnimationMixer::hydrateBoneTransforms(
 
     Transforms.resize(this->mesh->mNumBones);
 
-    // Recurse starts here
-    glm::mat4 rootParentTransform(1.0f);
-    applyBoneTransformsFromNodeTree(
-        animation0, currentTick0, animation1, currentTick1,
-        blendingFactor, this->scene->mRootNode, rootParentTransform,
-        Transforms
+    // Sampling the channels is most of the work and every node does it
+    // on its own, so that part is spread over the job system
+    vtx::parallelFor(
+        jobs, (int) this->nodes.size(), 16,
+        [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                this->nodeTransforms[i] = calcNodeTransform(
+                    animation0, currentTick0, animation1, currentTick1,
+                    blendingFactor, this->nodes[i]
+                );
+            }
+        }
     );
 
-    std::vector<glm::mat4> pose;
-    return pose;
+    // Cascading is a few multiplications per node, but each one needs
+    // its parent done first, pre-order makes that a single pass
+    for (size_t i = 0; i < this->nodes.size(); i++) {
+        const glm::mat4& nodeTransform = this->nodeTransforms[i];
+        int parent                     = this->nodeParents[i];
+
+        glm::mat4 cascadeTransform =
+            parent < 0 ? nodeTransform
+                       : this->nodeCascades[parent] * nodeTransform;
+
+        int boneIndex = this->nodeBones[i];
+        if (boneIndex >= 0) {
+            Transforms[boneIndex] = glm::transpose(
+                this->globalInverseTransform * cascadeTransform *
+                boneOffsets[boneIndex]
+            );
+        } else {
+            // Because there are some nodes at the root of the mesh,
+            // that are not bones, but they have some transformations
+            // Therefore, here I apply them to the globalTransformation
+            cascadeTransform = cascadeTransform * nodeTransform;
+        }
+        this->nodeCascades[i] = cascadeTransform;
+    }
 }
 
 aiVector3D AnimationMixer::calcInterpolatedPosition(
@@ -308,25 +375,21 @@ aiVector3D AnimationMixer::calcInterpolatedScaling(
     return start + factor * (end - start);
 }
 
-void AnimationMixer::applyBoneTransformsFromNodeTree(
+glm::mat4 AnimationMixer::calcNodeTransform(
     const aiAnimation& animation0,
     float currentTick0,
     const aiAnimation& animation1,
     float currentTick1,
     float blendingFactor,
-    const aiNode* pNode,
-    const glm::mat4& parentTransform,
-    std::vector<glm::mat4>& resultsBuffer
+    const aiNode* pNode
 )
 {
-    std::string nodeName(pNode->mName.data);
-
     glm::mat4 nodeTransform(
         assimpToGlmMatrix(pNode->mTransformation)
     );
 
-    const aiNodeAnim* channel0 = findChannel(animation0, nodeName);
-    const aiNodeAnim* channel1 = findChannel(animation1, nodeName);
+    const aiNodeAnim* channel0 = findChannel(animation0, pNode->mName);
+    const aiNodeAnim* channel1 = findChannel(animation1, pNode->mName);
     if (channel0 && channel1) {
         // Get TRS components from animation
         aiVector3D aiPosition0 =
@@ -375,34 +438,7 @@ void AnimationMixer::applyBoneTransformsFromNodeTree(
         nodeTransform = positionMat * rotationMat * scaleMat;
     }
 
-    glm::mat4 cascadeTransform =
-        parentTransform * nodeTransform;
-
-    auto isBoneNode = this->boneNameToIndex.find(nodeName) !=
-                      this->boneNameToIndex.end();
-    if (isBoneNode) {
-        uint boneIndex = this->boneNameToIndex[nodeName];
-
-        resultsBuffer[boneIndex] = glm::transpose(
-            this->globalInverseTransform * cascadeTransform *
-            boneOffsets[boneIndex]
-        );
-    } else {
-        // Because there are some nodes at the root of the mesh,
-        // that are not bones, but they have some transformations
-        // Therefore, here I apply them to the globalTransformation
-        cascadeTransform =
-            cascadeTransform * nodeTransform;
-    }
-
-    for (uint i = 0; i < pNode->mNumChildren; i++) {
-        // Go deeper into recursion
-        applyBoneTransformsFromNodeTree(
-            animation0, currentTick0, animation1, currentTick1,
-            blendingFactor, pNode->mChildren[i], cascadeTransform,
-            resultsBuffer
-        );
-    }
+    return nodeTransform;
 }
 
 float AnimationMixer::calcAnimationTick(
@@ -424,13 +460,14 @@ float AnimationMixer::calcAnimationTick(
 
 const aiNodeAnim* AnimationMixer::findChannel(
     const aiAnimation& animation,
-    const std::string& nodeName
+    const aiString& nodeName
 )
 {
     for (uint i = 0; i < animation.mNumChannels; i++) {
         const aiNodeAnim* channel = animation.mChannels[i];
 
-        if (std::string(channel->mNodeName.data) == nodeName) {
+        // aiString compares length and bytes in place, no copies
+        if (channel->mNodeName == nodeName) {
             return channel;
         }
     }
@@ -9,12 +9,16 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iomanip>
 #include <iostream>
+#include <memory_resource>
 #include <sstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "../../src/vtx/ctx.h"
+#include "../../src/vtx/shader-program.h"
+#include "../../src/vtx/mesh-cache.h"
+#include "../../src/vtx/profiler-panel.h"
 #include "animation-mixer.h"
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
@@ -27,6 +31,7 @@ struct MyImGui;
 struct UserContext;
 void vtx::init(vtx::VertexContext* ctx);
 void vtx::loop(vtx::VertexContext* ctx);
+void simulate(vtx::VertexContext* ctx, double stepSeconds);
 int main(int argc, char* argv[]);
 
 struct Gizmo {
@@ -65,13 +70,13 @@ struct Gizmo {
     // clang-format on
 
     GLuint gizmoVAO;
-    GLuint gizmoShader;
+    vtx::GpuBuffer gizmoVBO;
+    vtx::ShaderProgram gizmoShader;
+    vtx::UniformHandle modelToWorldUniform = "u_modelToWorld";
 
     void init();
-    void updateProjectionMatrix(const glm::mat4 projectionMatrix) const;
     void updateTransformationMatrix(const glm::mat4 transformationMatrix
     ) const;
-    void updateViewMatrix(const glm::mat4 viewMatrix) const;
     void draw() const;
 };
 
@@ -81,6 +86,7 @@ const char* Gizmo::GIZMO_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
     precision mediump float;
 
@@ -90,8 +96,6 @@ const char* Gizmo::GIZMO_VERTEX_SHADER =
     out float v_direction;
 
     uniform mat4 u_modelToWorld;
-    uniform mat4 u_worldToView;  // World to View matrix
-    uniform mat4 u_projection;   // Projection matrix
 
     void main() {
         v_direction = a_direction;
@@ -99,7 +103,7 @@ const char* Gizmo::GIZMO_VERTEX_SHADER =
         // Transform the vertex position from world space to view space
         // and then to clip space
         vec3 crntPos = vec3(u_modelToWorld * vec4(a_position, 1.0f));
-        gl_Position  = u_projection * u_worldToView * vec4(crntPos, 1.0f);
+        gl_Position  = u_viewProjection * vec4(crntPos, 1.0f);
     }
     )";
 
@@ -130,15 +134,12 @@ const char* Gizmo::GIZMO_FRAGMENT_SHADER =
 void Gizmo::init()
 {
     glGenVertexArrays(1, &gizmoVAO);
-    glBindVertexArray(this->gizmoVAO);
+    vtx::bindVertexArray(this->gizmoVAO);
 
     // Create a vertex buffer for gizmo
-    GLuint gizmoVBO;
-    glGenBuffers(1, &gizmoVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, gizmoVBO);
-    glBufferData(
+    this->gizmoVBO.create(
         GL_ARRAY_BUFFER, sizeof(gizmoVertices), gizmoVertices,
-        GL_STATIC_DRAW
+        GL_STATIC_DRAW, "gizmo"
     );
     // Enable vertex attribute and bind it to shader location
     glVertexAttribPointer(
@@ -151,27 +152,12 @@ void Gizmo::init()
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);                      // VAO
-    glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+    vtx::bindVertexArray(0);                      // VAO
+    vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+    vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
 
-    this->gizmoShader = vtx::createShaderProgram(
-        GIZMO_VERTEX_SHADER, GIZMO_FRAGMENT_SHADER
-    );
-}
-
-void Gizmo::updateProjectionMatrix(const glm::mat4 projectionMatrix
-) const
-{
-    glUseProgram(this->gizmoShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->gizmoShader, "u_projection"
-        ),                                // uniform location
-        1,                                // number of matrices
-        GL_FALSE,                         // transpose
-        glm::value_ptr(projectionMatrix)  // value
+    this->gizmoShader.create(
+        GIZMO_VERTEX_SHADER, GIZMO_FRAGMENT_SHADER, "gizmo"
     );
 }
 
@@ -179,38 +165,15 @@ void Gizmo::updateTransformationMatrix(
     const glm::mat4 transformationMatrix
 ) const
 {
-    glUseProgram(this->gizmoShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->gizmoShader, "u_modelToWorld"
-        ),                                    // uniform location
-        1,                                    // number of matrices
-        GL_FALSE,                             // transpose
-        glm::value_ptr(transformationMatrix)  // value
-    );
-}
-
-void Gizmo::updateViewMatrix(const glm::mat4 viewMatrix) const
-{
-    glUseProgram(this->gizmoShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->gizmoShader, "u_worldToView"
-        ),                          // uniform location
-        1,                          // number of matrices
-        GL_FALSE,                   // transpose
-        glm::value_ptr(viewMatrix)  // value
-    );
+    this->gizmoShader.set(this->modelToWorldUniform, transformationMatrix);
 }
 
 void Gizmo::draw() const
 {
-    glUseProgram(this->gizmoShader);
-    glBindVertexArray(this->gizmoVAO);
+    this->gizmoShader.use();
+    vtx::bindVertexArray(this->gizmoVAO);
 
-    glDrawArrays(
+    vtx::drawArrays(
         GL_TRIANGLES,            // Only this is supported in GLES
         0,                       // Start from
         sizeof(gizmoVertices) /  // Total size /
@@ -218,7 +181,7 @@ void Gizmo::draw() const
             )  // DIV size of element = one vertex size
     );
 
-    glBindVertexArray(0);
+    vtx::bindVertexArray(0);
 }
 
 struct MyVertex {
@@ -245,7 +208,15 @@ struct MyMesh {
     std::vector<MyVertex> vertices;
     std::vector<unsigned int> indices;
     GLuint modelVAO;
-    GLuint defaultShader;
+    vtx::GpuBuffer vertexBuffer, indexBuffer;
+    // What init() uploads, mapped from the mesh cache or made by the
+    // import
+    vtx::CookedMesh cooked = {};
+    GLsizei indexCount     = 0;
+    vtx::ShaderProgram defaultShader;
+    vtx::UniformHandle modelToWorldUniform       = "u_modelToWorld";
+    vtx::UniformHandle selectedJointIndexUniform = "u_selectedJointIndex";
+    vtx::UniformHandle bonesUniform              = "u_bones";
     const aiScene* scene;
     const aiMesh* mesh;
     glm::mat4 boneTransforms[100];
@@ -260,10 +231,8 @@ struct MyMesh {
 
     void init();
     void loadMesh(const char* path);
-    void updateProjectionMatrix(const glm::mat4 projectionMatrix) const;
     void updateTransformationMatrix(const glm::mat4 transformationMatrix
     ) const;
-    void updateViewMatrix(const glm::mat4 viewMatrix) const;
     void updateSelectedJointIndex(GLuint selectedBoneIndex) const;
     // void updateBoneTransform(const glm::mat4& boneTransform) const;
     void updateBoneTransform(const glm::mat4* boneTransform, int count)
@@ -277,6 +246,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
 	precision mediump float;
 
@@ -293,19 +263,14 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
 
     const int MAX_BONES = 200;
 
-    // Converts world-space coordinates to view-space coordinates (camera space).
-    // Applied to all objects in the scene to align with the camera's position and orientation.
-    uniform mat4 u_worldToView;
+    // Camera matrices (u_worldToView, u_projection, u_viewProjection)
+    // come from the FrameConstants block shared by all shaders.
 
     // Converts model-space coordinates to world-space coordinates.
     // This matrix transforms an object's local vertices into the global scene.
     // Applied to each model to position, scale, and rotate it within the world.
     uniform mat4 u_modelToWorld;
 
-    // Projection matrix: transforms view-space coordinates to clip-space coordinates.
-    // Determines how objects are projected onto the screen (perspective or orthographic).
-    uniform mat4 u_projection;
-
     // Array of bone transformation matrices for skeletal animation.
     // Each matrix in u_bones adjusts the position and rotation 
     // of a specific bone in model space.
@@ -353,7 +318,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
 
         vec4 animatedPos = boneTransform * vec4(v_crntPos, 1.0f);
         animatedPos = u_modelToWorld * animatedPos;
-        gl_Position = u_projection * u_worldToView * animatedPos;
+        gl_Position = u_viewProjection * animatedPos;
 
         // TODO animate normals
         v_normal = mat3(transpose(inverse(u_modelToWorld * boneTransform))) * a_normal;
@@ -405,30 +370,28 @@ void MyMesh::init()
 {
     // Create VAO
     glGenVertexArrays(1, &modelVAO);
-    glBindVertexArray(modelVAO);
+    vtx::bindVertexArray(modelVAO);
 
-    // Create VBO with vertices
-    GLuint VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(
+    // Create VBO with vertices, on warm starts straight from the mapped
+    // cooked file
+    this->vertexBuffer.create(
         GL_ARRAY_BUFFER,
-        vertices.size() * sizeof(MyVertex),  // all vertices in bytes
-        vertices.data(), GL_STATIC_DRAW
+        (size_t) cooked.vertexCount *
+            cooked.vertexStride,  // all vertices in bytes
+        cooked.vertices, GL_STATIC_DRAW, "mesh"
     );
 
     // Create EBO with indexes
-    GLuint EBO;
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(
+    this->indexBuffer.create(
         GL_ELEMENT_ARRAY_BUFFER,  // This is used for EBO
-        indices.size() * sizeof(unsigned int), indices.data(),
-        GL_STATIC_DRAW
+        cooked.indexCount * sizeof(unsigned int), cooked.indices,
+        GL_STATIC_DRAW, "mesh"
     );
+    this->indexCount = (GLsizei) cooked.indexCount;
+    vtx::releaseCookedMesh(&cooked);
 
     // Links VBO attributes such as coordinates and colors to VAO
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    vtx::bindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer.id);
 
     // clang-format off
     // These are the basic
@@ -448,22 +411,24 @@ void MyMesh::init()
     glEnableVertexAttribArray(4);
 
     // Unbind all to prevent accidentally modifying them
-    glBindVertexArray(0);                      // VAO
-    glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+    vtx::bindVertexArray(0);                      // VAO
+    vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+    vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
 
-    defaultShader = vtx::createShaderProgram(
-        MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER
+    defaultShader.create(
+        MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER, "model"
     );
 }
 
 void MyMesh::loadMesh(const char* path)
 {
-    this->scene = importer.ReadFile(
-        path,  // path of the file
-        aiProcess_Triangulate | aiProcess_FlipUVs |
-            aiProcess_CalcTangentSpace
-    );
+    unsigned int importFlags = aiProcess_Triangulate |
+                               aiProcess_FlipUVs |
+                               aiProcess_CalcTangentSpace;
+    {
+        VTX_TRACE_SCOPE_DETAIL("Assimp::Importer::ReadFile", path);
+        this->scene = importer.ReadFile(path, importFlags);
+    }
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
         !scene->mRootNode) {
@@ -477,6 +442,13 @@ void MyMesh::loadMesh(const char* path)
 
     am.initBones(scene, mesh);
 
+    // The skeleton and the clips are read from the scene every frame,
+    // so only the vertex walk below can be skipped
+    uint64_t cacheKey = vtx::meshCacheKey(
+        path, mesh->mName.C_Str(), importFlags, sizeof(MyVertex)
+    );
+    if (vtx::loadCookedMesh(cacheKey, &this->cooked)) return;
+
     // Print the name of the mesh
     if (mesh->mName.length > 0) {
         std::cout << "Mesh Name: " << mesh->mName.C_Str() << std::endl;
@@ -591,61 +563,32 @@ void MyMesh::loadMesh(const char* path)
     }
     std::cerr << "vertices: " << vertices.size() << std::endl;
     std::cerr << "indices: " << indices.size() << std::endl;
-}
 
-void MyMesh::updateProjectionMatrix(const glm::mat4 projectionMatrix
-) const
-{
-    glUseProgram(this->defaultShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->defaultShader, "u_projection"
-        ),                                // uniform location
-        1,                                // number of matrices
-        GL_FALSE,                         // transpose
-        glm::value_ptr(projectionMatrix)  // value
+    // init() uploads from here, and the next start from the file
+    glm::mat4 identity(1.0f);
+    cooked.vertices     = vertices.data();
+    cooked.vertexStride = sizeof(MyVertex);
+    cooked.vertexCount  = (uint32_t) vertices.size();
+    cooked.indices      = indices.data();
+    cooked.indexCount   = (uint32_t) indices.size();
+    memcpy(
+        cooked.transform, glm::value_ptr(identity),
+        sizeof(cooked.transform)
     );
+    vtx::storeCookedMesh(cacheKey, &cooked);
 }
 
 void MyMesh::updateTransformationMatrix(
     const glm::mat4 transformationMatrix
 ) const
 {
-    glUseProgram(this->defaultShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->defaultShader, "u_modelToWorld"
-        ),                                    // uniform location
-        1,                                    // number of matrices
-        GL_FALSE,                             // transpose
-        glm::value_ptr(transformationMatrix)  // value
-    );
-}
-
-void MyMesh::updateViewMatrix(const glm::mat4 viewMatrix) const
-{
-    glUseProgram(this->defaultShader);
-
-    glUniformMatrix4fv(
-        glGetUniformLocation(
-            this->defaultShader, "u_worldToView"
-        ),                          // uniform location
-        1,                          // number of matrices
-        GL_FALSE,                   // transpose
-        glm::value_ptr(viewMatrix)  // value
-    );
+    this->defaultShader.set(this->modelToWorldUniform, transformationMatrix);
 }
 
 void MyMesh::updateSelectedJointIndex(GLuint selectedBoneIndex) const
 {
-    glUseProgram(this->defaultShader);
-    glUniform1ui(
-        glGetUniformLocation(
-            this->defaultShader, "u_selectedJointIndex"
-        ),                 // Loc
-        selectedBoneIndex  // value
+    this->defaultShader.set(
+        this->selectedJointIndexUniform, selectedBoneIndex
     );
 }
 
@@ -661,33 +604,28 @@ void MyMesh::updateBoneTransform(
         std::cerr << "Too many bones in file" << std::endl;
         exit(1);
     }
-    // TODO if index exceedds max bones then exit
-    glUseProgram(this->defaultShader);
-    glUniformMatrix4fv(
-        glGetUniformLocation(this->defaultShader, "u_bones"),  // Loc
-        count,                                                 // count
-        GL_TRUE,  // transpose
-        glm::value_ptr(boneTransform[0]
-        )  // put only one value in specific index
-    );
+    // Bone matrices have always been uploaded transposed
+    this->defaultShader.set(this->bonesUniform, boneTransform, count, true);
 }
 
 void MyMesh::draw() const
 {
+    VTX_PROFILE_GPU_SCOPE("MyMesh::draw");
+
     // Draw using default shader
-    glUseProgram(this->defaultShader);
-    glBindVertexArray(this->modelVAO);
-    glDrawElements(
+    this->defaultShader.use();
+    vtx::bindVertexArray(this->modelVAO);
+    vtx::drawElements(
         GL_TRIANGLES,     // Mode
-        indices.size(),   // Index count
+        indexCount,       // Index count
         GL_UNSIGNED_INT,  // Data type of indices array
         (void*) (0 * sizeof(unsigned int))  // Indices pointer
     );
-    glBindVertexArray(0);
+    vtx::bindVertexArray(0);
 }
 
 struct MyImGui {
-    std::unordered_map<std::string, bool> openBoneNodes;
+    std::unordered_map<const aiNode*, bool> openBoneNodes;
 
     GLuint selectedBoneIndex;
 
@@ -697,12 +635,12 @@ struct MyImGui {
     void renderFrame() const;
 
     void showMatrixEditor(glm::mat4* matrix, const char* title) const;
-    int FindBoneIndex(const aiMesh* mesh, const std::string& boneName);
+    int FindBoneIndex(const aiMesh* mesh, const aiString& boneName);
     void ShowOffsetMatrix(const aiMatrix4x4& offsetMatrix);
     void _showBoneHierarchy(
         const aiNode* node,
         const aiMesh* mesh,
-        std::unordered_map<std::string, bool>& openNodes,
+        std::unordered_map<const aiNode*, bool>& openNodes,
         int level
     );
     void renderBoneHierarchy(const aiScene* scene, const aiMesh* mesh);
@@ -738,8 +676,12 @@ void MyImGui::newFrame() const
 
 void MyImGui::renderFrame() const
 {
+    VTX_PROFILE_GPU_SCOPE("MyImGui::renderFrame");
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    // ImGui sets its own GL state, so what we shadow is stale now
+    vtx::invalidateGLState();
 }
 
 void MyImGui::showMatrixEditor(glm::mat4* matrix, const char* title)
@@ -777,11 +719,11 @@ void MyImGui::showMatrixEditor(glm::mat4* matrix, const char* title)
 // Helper function to find the bone index in the mesh
 int MyImGui::FindBoneIndex(
     const aiMesh* mesh,
-    const std::string& boneName
+    const aiString& boneName
 )
 {
     for (unsigned int i = 0; i < mesh->mNumBones; ++i) {
-        if (boneName == mesh->mBones[i]->mName.C_Str()) {
+        if (mesh->mBones[i]->mName == boneName) {
             return i;
         }
     }
@@ -806,22 +748,27 @@ void MyImGui::ShowOffsetMatrix(const aiMatrix4x4& offsetMatrix)
 void MyImGui::_showBoneHierarchy(
     const aiNode* node,
     const aiMesh* mesh,
-    std::unordered_map<std::string, bool>& openNodes,
+    std::unordered_map<const aiNode*, bool>& openNodes,
     int level = 0
 )
 {
-    std::string nodeName = node->mName.C_Str();
+    // Runs for every node every frame, so labels are formatted on the
+    // stack instead of building strings
+    const char* nodeName = node->mName.C_Str();
 
-    int boneIndex = FindBoneIndex(mesh, nodeName);
+    int boneIndex = FindBoneIndex(mesh, node->mName);
     bool isBone   = (boneIndex >= 0);
 
     ImGui::TableNextRow();
 
     ImGui::TableSetColumnIndex(0);
 
-    std::string buttonLabel =
-        "Select##" + std::to_string(boneIndex) + " " + nodeName;
-    if (ImGui::Button(buttonLabel.c_str())) {
+    char buttonLabel[sizeof(aiString::data) + 32];
+    snprintf(
+        buttonLabel, sizeof(buttonLabel), "Select##%d %s", boneIndex,
+        nodeName
+    );
+    if (ImGui::Button(buttonLabel)) {
         std::cout << "Bone selected: " << node->mName.C_Str()
                   << std::endl;
         selectedBoneIndex = boneIndex;
@@ -830,16 +777,20 @@ void MyImGui::_showBoneHierarchy(
     ImGui::TableSetColumnIndex(1);
 
     ImGui::Indent(level * 2);
-    bool isOpen = openNodes[nodeName];
-    if (ImGui::Selectable(nodeName.c_str(), isOpen)) {
-        openNodes[nodeName] = !isOpen;
+    bool isOpen = openNodes[node];
+    if (ImGui::Selectable(nodeName, isOpen)) {
+        openNodes[node] = !isOpen;
     }
     ImGui::Unindent(level * 2);
 
     if (isOpen && isBone) {
-        std::string littleWindowLabel = "Bone: " + nodeName;
+        char littleWindowLabel[sizeof(aiString::data) + 8];
+        snprintf(
+            littleWindowLabel, sizeof(littleWindowLabel), "Bone: %s",
+            nodeName
+        );
 
-        ImGui::Begin(littleWindowLabel.c_str());
+        ImGui::Begin(littleWindowLabel);
         ImGui::Text("Bone Index: %d", boneIndex);
         ShowOffsetMatrix(mesh->mBones[boneIndex]->mOffsetMatrix);
         ImGui::End();
@@ -897,6 +848,15 @@ struct UserContext {
     MyMesh human;
     MyImGui imgui;
     AnimationMixerControls amc;
+
+    // Only changes when the window does
+    glm::mat4 projection;
+
+    // Simulation state, advanced by simulate() in fixed steps
+    float previousAngle;
+    float currentAngle;
+    std::vector<glm::mat4> previousPose;
+    std::vector<glm::mat4> currentPose;
 };
 
 UserContext usr;
@@ -913,6 +873,15 @@ glm::mat4 cameraMatrix = glm::lookAt(
 
 glm::mat4 modelToWorld = glm::mat4(1.0f);  // Identity matrix
 
+glm::mat4 perspectiveFor(int screenWidth, int screenHeight)
+{
+    float fov       = glm::radians(45.0f);  // Field of view in radians
+    float nearPlane = 0.1f;    // Distance to the near clipping plane
+    float farPlane  = 100.0f;  // Distance to the far clipping plane
+    float aspectRatio = (float) screenWidth / (float) screenHeight;
+    return glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+}
+
 void vtx::init(vtx::VertexContext* ctx)
 {
     // GLB file contains normals, but Blender not
@@ -922,83 +891,98 @@ void vtx::init(vtx::VertexContext* ctx)
     usr.imgui.init(ctx);
     usr.amc.initAnimationMixerControls(usr.human.am);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_DEPTH_TEST);
+    vtx::enable(GL_BLEND);
+    vtx::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    vtx::enable(GL_DEPTH_TEST);
 
-    // Figure projection matrix
-    float fov       = glm::radians(45.0f);  // Field of view in radians
-    float nearPlane = 0.1f;    // Distance to the near clipping plane
-    float farPlane  = 100.0f;  // Distance to the far clipping plane
-    // Actually, this needs to be recalculated in the loop,
-    // as window could be resized at any time by user
-    float aspectRatio = ctx->screenWidth / ctx->screenHeight;
+    // Recalculated in the loop when the window is resized
+    usr.projection = perspectiveFor(ctx->screenWidth, ctx->screenHeight);
 
-    // But, here is the initials perspective matrix
-    glm::mat4 projectionMatrix =
-        glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+    // Fill both poses, so there is something to blend from the start
+    simulate(ctx, 0.0);
+    simulate(ctx, 0.0);
+    vtx::setFixedTimestep(ctx, 1.0 / 60.0, 5, simulate);
+}
+
+void simulate(vtx::VertexContext* ctx, double stepSeconds)
+{
+    float rotationSpeed =
+        glm::radians(45.0f);  // Rotation speed in radians per second
+
+    usr.previousAngle = usr.currentAngle;
+    usr.currentAngle += rotationSpeed * (float) stepSeconds;
 
-    usr.human.updateProjectionMatrix(projectionMatrix);
-    usr.gizmo.updateProjectionMatrix(projectionMatrix);
+    // Previous pose is kept for blending, the older one gets reused
+    std::swap(usr.previousPose, usr.currentPose);
+    usr.human.am.hydrateBoneTransforms(
+        ctx->jobs,
+        usr.currentPose,                       // buffer to be hydrated
+        (float) (ctx->simTime + stepSeconds),  // in seconds
+        usr.amc.selectedAnimation0, usr.amc.ticksPerSecond0,
+        usr.amc.selectedAnimation1, usr.amc.ticksPerSecond1,
+        usr.amc.blendingFactor
+    );  // Use amimation mixer animation
 }
 
 void vtx::loop(vtx::VertexContext* ctx)
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event) != 0) {
-        if (event.type == SDL_QUIT) {
-            vtx::exitVortex();
-            return;
-        }
-        if (event.type == SDL_KEYDOWN) {
-            if (event.key.keysym.sym == SDLK_ESCAPE) {
+    {
+        VTX_PROFILE_SCOPE("handleEvents");
+        for (SDL_Event& event : ctx->input.events) {
+            if (event.type == SDL_QUIT) {
                 vtx::exitVortex();
                 return;
             }
-        }
+            if (event.type == SDL_WINDOWEVENT &&
+                event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                ctx->screenWidth  = event.window.data1;
+                ctx->screenHeight = event.window.data2;
+                usr.projection =
+                    perspectiveFor(ctx->screenWidth, ctx->screenHeight);
+            }
+            if (event.type == SDL_KEYDOWN) {
+                if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    vtx::exitVortex();
+                    return;
+                }
+            }
 
-        usr.imgui.processEvent(&event);
+            usr.imgui.processEvent(&event);
+        }
     }
 
     glClearColor(0.1f, 0.4f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-static Uint32 lastTime = 0;
-Uint32 currentTime = SDL_GetTicks();
-float deltaTime = (currentTime - lastTime) / 1000.0f;
-lastTime = currentTime;
+    // Camera and projection for every shader at once
+    vtx::writeFrameConstants(
+        cameraMatrix, usr.projection, ctx->frameTime, ctx->deltaTime,
+        ctx->screenWidth, ctx->screenHeight
+    );
 
-float rotationSpeed = glm::radians(45.0f);  // Rotation speed in radians per second
-float angle = rotationSpeed * SDL_GetTicks() / 1000.0f;  // Total angle based on elapsed time
+    // Render in between of the last two simulation steps
+    float angle =
+        glm::mix(usr.previousAngle, usr.currentAngle, ctx->alpha);
 
-modelToWorld = glm::mat4(1.0f);  // Start with an identity matrix
-modelToWorld = glm::rotate(modelToWorld, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+    modelToWorld = glm::mat4(1.0f);  // Start with an identity matrix
+    modelToWorld =
+        glm::rotate(modelToWorld, angle, glm::vec3(0.0f, 1.0f, 0.0f));
 
     usr.human.updateTransformationMatrix(modelToWorld);
-    usr.human.updateViewMatrix(cameraMatrix);
     usr.human.updateSelectedJointIndex(usr.imgui.selectedBoneIndex);
-    glm::mat4 boneTransforms[100];
 
-    float elapsedTime = 1.0f * (float) SDL_GetTicks() / 1000;
-
-    int selectedAnimationIndex0 = usr.amc.selectedAnimation0;
-    int selectedAnimationIndex1 = usr.amc.selectedAnimation1;
-    float ticksPerSecond0       = usr.amc.ticksPerSecond0;
-    float ticksPerSecond1       = usr.amc.ticksPerSecond1;
-
-    std::vector<glm::mat4> T;
-    usr.human.am.hydrateBoneTransforms(
-        T,            // buffer to be hydrated
-        elapsedTime,  // in seconds
-        selectedAnimationIndex0, ticksPerSecond0,
-        selectedAnimationIndex1, ticksPerSecond1,
-        usr.amc.blendingFactor
-    );  // Use amimation mixer animation
+    // Only needed until it is uploaded, so it lives in the frame arena
+    std::pmr::vector<glm::mat4> T(
+        usr.currentPose.size(), &ctx->frameMemory
+    );
+    for (size_t i = 0; i < T.size(); i++) {
+        T[i] = usr.previousPose[i] * (1.0f - ctx->alpha) +
+               usr.currentPose[i] * ctx->alpha;
+    }
     usr.human.updateBoneTransform(T.data(), T.size());
     usr.human.draw();
 
     usr.gizmo.updateTransformationMatrix(modelToWorld);
-    usr.gizmo.updateViewMatrix(cameraMatrix);
     usr.gizmo.draw();
 
     usr.imgui.newFrame();  // --------------------------
@@ -1008,14 +992,15 @@ modelToWorld = glm::rotate(modelToWorld, angle, glm::vec3(0.0f, 1.0f, 0.0f));
     );
     usr.imgui.showMatrixEditor(&cameraMatrix, "Camera matrix");
     usr.imgui.renderBoneHierarchy(usr.human.scene, usr.human.mesh);
+    vtx::showProfilerPanel();
 
     // AMC must be within IMGUI frame!
-    usr.amc.renderAnimationControls(usr.human.am, elapsedTime);
+    usr.amc.renderAnimationControls(usr.human.am, ctx->simTime);
 
     usr.imgui.renderFrame();  // ------------------------
 
     checkOpenGLError();
-    SDL_GL_SwapWindow(ctx->sdlWindow);
+    vtx::swapWindow(ctx);
 }
 
 int main(int argc, char* argv[]) { vtx::openVortex(); }
@@ -14,7 +14,15 @@
 #include <vector>
 
 #include "../../src/vtx/ctx.h"
+#include "../../src/vtx/shader-program.h"
 #include "../../src/vtx/gizmo.h"
+#include "../../src/vtx/asset-loader.h"
+#include "../../src/vtx/frame-packet.h"
+#include "../../src/vtx/gpu-memory-panel.h"
+#include "../../src/vtx/mesh-cache.h"
+#include "../../src/vtx/profiler-panel.h"
+#include "../../src/vtx/render-queue.h"
+#include "../../src/vtx/scene-cache.h"
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
 #include "imgui_impl_sdl2.h"
@@ -34,6 +42,9 @@ typedef struct {
     } normal;
 } MyVertex;
 
+// Distance to the far clipping plane
+const float farPlane = 100.0f;
+
 struct MyMesh {
     static const char* MODEL_VERTEX_SHADER;
     static const char* MODEL_FRAGMENT_SHADER;
@@ -42,39 +53,111 @@ struct MyMesh {
     std::vector<MyVertex> vertices;
     std::vector<unsigned int> indices;
     GLuint modelVAO;
-    GLuint defaultShader;
-    uint diffuseTextureId;
+    vtx::GpuBuffer vertexBuffer, indexBuffer;
+    std::string name;  // names its GPU memory
+    vtx::ShaderProgram defaultShader;
+    vtx::UniformHandle modelToWorldUniform   = "u_modelToWorld";
+    vtx::UniformHandle diffuseTextureUniform = "u_diffuseTexture";
+    uint diffuseTextureId = 0;
+    vtx::GpuTexture diffuseTexture;
+    // What init() uploads, mapped from the mesh cache or made by the
+    // import
+    vtx::CookedMesh cooked = {};
+    vtx::ScenePin scenePin;  // the shared import, until uploaded
+    GLsizei indexCount = 0;
     glm::mat4 initialTransform;
 
+    // Loaded in the background, see startLoading()
+    vtx::Asset asset;
+    const char* path;
+    const char* meshName;
+
+    // Runs loadMesh() on a loader thread and init() on the thread that
+    // owns GL. Nothing of the mesh may be read until the asset is
+    // ready.
+    void startLoading(const char* path, const char* meshName)
+    {
+        this->path     = path;
+        this->meshName = meshName;
+        vtx::loadAsset(
+            &this->asset, meshName,
+            [](void* data) {
+                auto* mesh = (MyMesh*) data;
+                mesh->loadMesh(mesh->path, mesh->meshName);
+                if (mesh->cooked.vertexCount > 0) return true;
+                mesh->scenePin.release();
+                return false;
+            },
+            [](void* data) { ((MyMesh*) data)->init(); }, this
+        );
+    }
+
+    // A grey cube to draw while the real meshes load, made right away
+    // so it is there for the first frame
+    void loadPlaceholder()
+    {
+        static const unsigned char grey[4] = {128, 128, 128, 255};
+        this->name = "placeholder";
+        for (int face = 0; face < 6; face++) {
+            int axis = face / 2;
+            glm::vec3 normal(0.0f), across(0.0f), up(0.0f);
+            normal[axis]           = face % 2 == 0 ? 1.0f : -1.0f;
+            across[(axis + 1) % 3] = 0.5f;
+            up[(axis + 2) % 3]     = 0.5f;
+
+            unsigned int first = (unsigned int) vertices.size();
+            for (int corner = 0; corner < 4; corner++) {
+                float x            = corner & 1 ? 1.0f : -1.0f;
+                float y            = corner & 2 ? 1.0f : -1.0f;
+                glm::vec3 position = normal * 0.5f + across * x + up * y;
+                MyVertex vertex = {};
+                vertex.position = {position.x, position.y, position.z};
+                vertex.color    = {1.0f, 1.0f, 1.0f};
+                vertex.normal   = {normal.x, normal.y, normal.z};
+                vertices.push_back(vertex);
+            }
+            for (unsigned int corner : {0, 1, 3, 0, 3, 2}) {
+                indices.push_back(first + corner);
+            }
+        }
+        this->initialTransform = glm::mat4(1.0f);
+
+        cooked.vertices      = vertices.data();
+        cooked.vertexStride  = sizeof(MyVertex);
+        cooked.vertexCount   = (uint32_t) vertices.size();
+        cooked.indices       = indices.data();
+        cooked.indexCount    = (uint32_t) indices.size();
+        cooked.texels        = grey;
+        cooked.textureWidth  = 1;
+        cooked.textureHeight = 1;
+        cooked.textureFormat = GL_RGBA;
+    }
+
     void init()
     {
         // Create VAO
         glGenVertexArrays(1, &modelVAO);
-        glBindVertexArray(modelVAO);
+        vtx::bindVertexArray(modelVAO);
 
-        // Create VBO with vertices
-        GLuint VBO;
-        glGenBuffers(1, &VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(
+        // Create VBO with vertices, on warm starts straight from the
+        // mapped cooked file
+        this->vertexBuffer.create(
             GL_ARRAY_BUFFER,
-            vertices.size() *
-                sizeof(MyVertex),  // all vertices in bytes
-            vertices.data(), GL_STATIC_DRAW
+            (size_t) cooked.vertexCount *
+                cooked.vertexStride,  // all vertices in bytes
+            cooked.vertices, GL_STATIC_DRAW, this->name.c_str()
         );
 
         // Create EBO with indexes
-        GLuint EBO;
-        glGenBuffers(1, &EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(
+        this->indexBuffer.create(
             GL_ELEMENT_ARRAY_BUFFER,  // This is used for EBO
-            indices.size() * sizeof(unsigned int), indices.data(),
-            GL_STATIC_DRAW
+            cooked.indexCount * sizeof(unsigned int), cooked.indices,
+            GL_STATIC_DRAW, this->name.c_str()
         );
+        this->indexCount = (GLsizei) cooked.indexCount;
 
         // Links VBO attributes such as coordinates and colors to VAO
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        vtx::bindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer.id);
 
         // clang-format off
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MyVertex), (void*) offsetof(MyVertex, position));
@@ -89,124 +172,61 @@ struct MyMesh {
         glEnableVertexAttribArray(3);
 
         // Unbind all to prevent accidentally modifying them
-        glBindVertexArray(0);                      // VAO
-        glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+        vtx::bindVertexArray(0);                      // VAO
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+        vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
 
-        defaultShader = vtx::createShaderProgram(
-            MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER
+        if (cooked.texels != nullptr) createDiffuseTexture();
+
+        // Uploaded, neither the mapping nor the import is needed
+        vtx::releaseCookedMesh(&cooked);
+        this->scenePin.release();
+
+        defaultShader.create(
+            MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER, "model"
         );
+        // The texture is bound per draw by the render queue, always
+        // to unit 0
+        defaultShader.set(diffuseTextureUniform, 0);
     }
-    uint
-    createTextureFromAssimp(const aiScene* scene, aiMaterial* material)
+    // The embedded diffuse texture, decoded once for the whole file,
+    // init() uploads it
+    void takeSceneTexture(const vtx::SceneMesh& sceneMesh)
     {
-        aiString texturePath;
-
-        if (material->GetTexture(
-                aiTextureType_DIFFUSE, 0, &texturePath
-            ) == AI_SUCCESS) {
-            const aiTexture* texture =
-                scene->GetEmbeddedTexture(texturePath.C_Str());
-
-            if (texture) {
-                unsigned char* data = nullptr;
-
-                int width, height, channels;
-                unsigned char* imageData = stbi_load_from_memory(
-                    reinterpret_cast<unsigned char*>(texture->pcData),
-                    texture->mWidth,  // mWidth holds the length of the
-                                      // compressed data buffer
-                    &width, &height, &channels, 0
-                );
-
-                uint glChan;
-                if (channels == 3) {
-                    glChan = GL_RGB;
-                } else if (channels == 4) {
-                    glChan = GL_RGBA;
-                } else {
-                    return 0;
-                }
-
-                if (imageData) {
-                    // Successfully loaded image; you can now use
-                    // imageData, width, height, and channels For
-                    // example, generate an OpenGL texture:
-                    GLuint textureID;
-                    glGenTextures(1, &textureID);
-                    glBindTexture(GL_TEXTURE_2D, textureID);
-                    glTexImage2D(
-                        GL_TEXTURE_2D, 0, glChan, width, height, 0,
-                        glChan, GL_UNSIGNED_BYTE, imageData
-                    );
-
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST
-                    );
-                    glTexParameterf(
-                        GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT
-                    );
-
-                    glGenerateMipmap(GL_TEXTURE_2D);
-
-                    // Unbind to make suree something else does not
-                    // interfere
-                    glBindTexture(GL_TEXTURE_2D, 0);
-
-                    // Free stb_image data after generating texture
-                    stbi_image_free(imageData);
-                    return textureID;
-                } else {
-                }
-            }
-        }
-        return 0;
+        const vtx::SceneTexture* texture =
+            vtx::sceneDiffuseTexture(&this->scenePin, sceneMesh);
+        if (texture == nullptr) return;
+
+        cooked.texels        = texture->texels;
+        cooked.textureWidth  = texture->width;
+        cooked.textureHeight = texture->height;
+        cooked.textureFormat =
+            texture->channels == 4 ? GL_RGBA : GL_RGB;
     }
 
-    void updateDiffuseTexture(uint diffuseTexture)
+    void createDiffuseTexture()
     {
-        glUseProgram(this->defaultShader);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseTexture);
+        this->diffuseTexture.create2D(
+            cooked.textureWidth, cooked.textureHeight,
+            cooked.textureFormat, cooked.textureFormat,
+            GL_UNSIGNED_BYTE, cooked.texels, true, this->name.c_str()
+        );
 
-        glUniform1i(
-            glGetUniformLocation(
-                this->defaultShader, "u_diffuseTexture"
-            ),
-            0
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST
         );
-        checkOpenGLError();
-    }
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST
+        );
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    // Recursive function to find the node containing the mesh index
-    const aiNode* findNodeForMeshIndex(const aiNode* node, unsigned int meshIndex) {
-        // Check if this node references the mesh index
-        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-            if (node->mMeshes[i] == meshIndex) {
-                return node;  // Found the node
-            }
-        }
-        
-        // Recursively search child nodes
-        for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            const aiNode* foundNode = findNodeForMeshIndex(node->mChildren[i], meshIndex);
-            if (foundNode) {
-                return foundNode;
-            }
-        }
-        
-        return nullptr;  // Node not found
+        // Unbind to make suree something else does not interfere
+        vtx::bindTexture(GL_TEXTURE_2D, 0);
+        this->diffuseTextureId = this->diffuseTexture.id;
     }
+
 inline glm::mat4 assimpToGlmMatrix(aiMatrix4x4 mat)
 {
     glm::mat4 m;
@@ -219,46 +239,35 @@ inline glm::mat4 assimpToGlmMatrix(aiMatrix4x4 mat)
 }
     void loadMesh(const char* path, const char* meshName)
     {
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(
-            path,  // path of the file
-            aiProcess_Triangulate | aiProcess_FlipUVs |
-                // aiProcess_GenNormals |
-                aiProcess_CalcTangentSpace
+        this->name               = meshName;
+        unsigned int importFlags = aiProcess_Triangulate |
+                                   aiProcess_FlipUVs |
+                                   // aiProcess_GenNormals |
+                                   aiProcess_CalcTangentSpace;
+
+        // A cooked copy from an earlier start skips Assimp and
+        // stb_image altogether
+        uint64_t cacheKey = vtx::meshCacheKey(
+            path, meshName, importFlags, sizeof(MyVertex)
         );
-
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-            !scene->mRootNode) {
+        if (vtx::loadCookedMesh(cacheKey, &this->cooked)) {
+            this->initialTransform = glm::make_mat4(cooked.transform);
             return;
         }
 
-        aiMesh* mesh = nullptr;
-        unsigned int meshIndex = 0;
-        // Iterate through all the meshes in the scene
-        for (meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) {
-            mesh = scene->mMeshes[meshIndex];
-
-
-            // Print the name of the mesh
-            if (mesh->mName.length > 0) {
-                std::cout << "Mesh Name: " << mesh->mName.C_Str()
-                          << std::endl;
-                const char* currentMeshName = mesh->mName.C_Str();
-                if (strcmp(currentMeshName, meshName) == 0) {
-                    std::cout << "Found matching mesh: " << meshName
-                              << std::endl;
-                    break;  // Exit the loop
-                }
-            }
-        }
-        if (mesh == nullptr) {
-            std::cerr << "Error loading mesh: " << meshName
-                      << std::endl;  // Fallback name
-        }
+        // The meshes of one file share its import, pinned until
+        // init() has uploaded this one
+        this->scenePin.pin(path);
+        vtx::SceneMesh sceneMesh =
+            vtx::findSceneMesh(&this->scenePin, meshName, importFlags);
+        if (sceneMesh.mesh == nullptr) return;
+        const aiScene* scene   = sceneMesh.scene;
+        const aiMesh* mesh     = sceneMesh.mesh;
+        unsigned int meshIndex = sceneMesh.meshIndex;
 
 
         glm::mat4 globalTransform(1.0f);
-        const aiNode* node = this->findNodeForMeshIndex(scene->mRootNode, meshIndex);
+        const aiNode* node = sceneMesh.node;
         
         // Traverse up the node hierarchy
         while (node != nullptr) {
@@ -330,64 +339,46 @@ inline glm::mat4 assimpToGlmMatrix(aiMatrix4x4 mat)
             }
         }
 
-        this->diffuseTextureId =
-            this->createTextureFromAssimp(scene, material);
-    }
-
-    void updateProjectionMatrix(const glm::mat4 projectionMatrix) const
-    {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_projection"
-            ),                                // uniform location
-            1,                                // number of matrices
-            GL_FALSE,                         // transpose
-            glm::value_ptr(projectionMatrix)  // value
+        this->takeSceneTexture(sceneMesh);
+
+        // init() uploads from here, and the next start from the file
+        cooked.vertices     = vertices.data();
+        cooked.vertexStride = sizeof(MyVertex);
+        cooked.vertexCount  = (uint32_t) vertices.size();
+        cooked.indices      = indices.data();
+        cooked.indexCount   = (uint32_t) indices.size();
+        memcpy(
+            cooked.transform, glm::value_ptr(this->initialTransform),
+            sizeof(cooked.transform)
         );
+        vtx::storeCookedMesh(cacheKey, &cooked);
     }
 
-    void updateTransformationMatrix(const glm::mat4 transformationMatrix
+    // Queues the mesh instead of drawing it, the queue decides the
+    // order. worldToView only places the mesh in depth.
+    void submit(
+        vtx::RenderQueue* queue,
+        vtx::RenderPass pass,
+        const glm::mat4& modelToWorld,
+        const glm::mat4& worldToView
     ) const
     {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_modelToWorld"
-            ),                                    // uniform location
-            1,                                    // number of matrices
-            GL_FALSE,                             // transpose
-            glm::value_ptr(transformationMatrix)  // value
+        glm::vec4 center = worldToView * modelToWorld *
+                           glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        uint64_t key = vtx::makeRenderKey(
+            pass, this->defaultShader.id, this->diffuseTextureId,
+            this->modelVAO, -center.z / farPlane
         );
-    }
 
-    void updateViewMatrix(const glm::mat4 viewMatrix) const
-    {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_worldToView"
-            ),                          // uniform location
-            1,                          // number of matrices
-            GL_FALSE,                   // transpose
-            glm::value_ptr(viewMatrix)  // value
-        );
-    }
-    void draw() const
-    {
-        // Draw using default shader
-        glUseProgram(this->defaultShader);
-        glBindVertexArray(this->modelVAO);
-        glDrawElements(
+        queue->drawElements(
+            key, &this->defaultShader, this->modelVAO,
+            this->diffuseTextureId,
             GL_TRIANGLES,     // Mode
-            indices.size(),   // Index count
+            indexCount,       // Index count
             GL_UNSIGNED_INT,  // Data type of indices array
             (void*) (0 * sizeof(unsigned int))  // Indices pointer
         );
-        glBindVertexArray(0);
+        queue->set(this->modelToWorldUniform, modelToWorld);
     }
 };
 // == MyModel impl ==
@@ -397,6 +388,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
 	precision mediump float;
 
@@ -411,9 +403,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
     out vec3 v_normal;
     out vec3 v_lightPos;
 
-    uniform mat4 u_worldToView;
     uniform mat4 u_modelToWorld;
-    uniform mat4 u_projection;
 
 	void main() {
         // Invert the model-to-world matrix to transform
@@ -429,7 +419,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
         v_crntPos     = vec3(u_modelToWorld * vec4(a_pos, 1.0f));
         v_lightPos    = vec3(u_worldToModel *  vec4(hardcodedLightPos, 1.0f));
 
-        gl_Position   = u_projection * u_worldToView * vec4(v_crntPos, 1.0f);
+        gl_Position   = u_viewProjection * vec4(v_crntPos, 1.0f);
 	}
 	)";
 
@@ -472,6 +462,14 @@ const char* MyMesh::MODEL_FRAGMENT_SHADER =
     }
     )";
 
+// == Frame packet ==
+// What loop() hands to render(), ImGui is drawn from copies of its
+// draw lists since the next ImGui frame is built while this one draws
+struct MyFramePacket : vtx::FramePacket {
+    ImDrawData imguiDrawData;
+    ImVector<ImDrawList*> imguiDrawLists;  // owned copies
+};
+
 // == ImGui object ==
 struct MyImGui {
     // Initialize ImGui
@@ -491,6 +489,9 @@ struct MyImGui {
 #else
         ImGui_ImplOpenGL3_Init("#version 330");
 #endif
+        // Builds the font texture while this thread still has GL,
+        // ImGui::NewFrame() on the main thread needs it
+        ImGui_ImplOpenGL3_NewFrame();
     }
 
     void processEvent(const SDL_Event* event)
@@ -500,15 +501,44 @@ struct MyImGui {
 
     void newFrame()
     {
-        ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplSDL2_NewFrame();
         ImGui::NewFrame();
     }
 
-    void renderFrame()
+    // Ends the ImGui frame and copies what it drew into the packet
+    void captureFrame(MyFramePacket* packet)
     {
+        VTX_PROFILE_SCOPE("MyImGui::captureFrame");
+
         ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        ImDrawData* drawData = ImGui::GetDrawData();
+
+        for (ImDrawList* drawList : packet->imguiDrawLists) {
+            IM_DELETE(drawList);
+        }
+        packet->imguiDrawLists.resize(0);
+        packet->imguiDrawData.Clear();
+
+        for (int i = 0; i < drawData->CmdListsCount; i++) {
+            ImDrawList* copy = drawData->CmdLists[i]->CloneOutput();
+            packet->imguiDrawLists.push_back(copy);
+            packet->imguiDrawData.AddDrawList(copy);
+        }
+        packet->imguiDrawData.Valid            = true;
+        packet->imguiDrawData.DisplayPos       = drawData->DisplayPos;
+        packet->imguiDrawData.DisplaySize      = drawData->DisplaySize;
+        packet->imguiDrawData.FramebufferScale = drawData->FramebufferScale;
+#if IMGUI_VERSION_NUM >= 19200
+        packet->imguiDrawData.Textures = drawData->Textures;
+#endif
+    }
+
+    void renderFrame(MyFramePacket* packet)
+    {
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplOpenGL3_RenderDrawData(&packet->imguiDrawData);
+        // ImGui sets its own GL state, so what we shadow is stale now
+        vtx::invalidateGLState();
     }
 
     void showMatrixEditor(glm::mat4* matrix, const char* title) const
@@ -554,7 +584,17 @@ typedef struct {
     MyMesh plant;
     MyMesh cubeTop;
     MyMesh cubeBody;
+    MyMesh placeholder;  // drawn for meshes still loading
     MyImGui imgui;
+    MyFramePacket framePackets[VTX_FRAME_PACKET_SLOTS];
+    vtx::ScenePin textureTest;  // until all its meshes are loaded
+
+    // Dragging with the right mouse button turns the scene around
+    float cameraYaw;
+    bool dragging;
+    int dragStartX;
+    // Only changes when the window does
+    glm::mat4 projection;
 } UserContext;
 
 UserContext usr;
@@ -571,97 +611,212 @@ glm::mat4 cameraMatrix = glm::lookAt(
 
 glm::mat4 modelToWorld = glm::mat4(1.0f);  // Identity matrix
 
+static void render(vtx::VertexContext* ctx, vtx::FramePacket* framePacket);
+static void lateLatch(
+    vtx::VertexContext* ctx,
+    vtx::FramePacket* framePacket
+);
+
+// A mesh still loading is stood in for by the placeholder
+static void submitMesh(
+    const MyMesh& mesh,
+    vtx::RenderQueue* queue,
+    vtx::RenderPass pass,
+    const glm::mat4& modelToWorld,
+    const glm::mat4& worldToView
+)
+{
+    if (vtx::isAssetReady(&mesh.asset)) {
+        mesh.submit(
+            queue, pass, mesh.initialTransform * modelToWorld,
+            worldToView
+        );
+    } else if (!vtx::hasAssetFailed(&mesh.asset)) {
+        usr.placeholder.submit(
+            queue, vtx::RENDER_PASS_OPAQUE, modelToWorld, worldToView
+        );
+    }
+}
+
+static glm::mat4 orbitCamera(int mouseX)
+{
+    float yaw = usr.cameraYaw;
+    if (usr.dragging) yaw += (float) (mouseX - usr.dragStartX) * 0.01f;
+    return cameraMatrix * glm::rotate(glm::mat4(1.0f), yaw, upDirection);
+}
+
+glm::mat4 perspectiveFor(int screenWidth, int screenHeight)
+{
+    float fov       = glm::radians(45.0f);  // Field of view in radians
+    float nearPlane = 0.1f;  // Distance to the near clipping plane
+    float aspectRatio = (float) screenWidth / (float) screenHeight;
+    return glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+}
+
 void vtx::init(vtx::VertexContext* ctx)
 {
-    // GLB file contains normals, but Blender not
-    usr.plant.loadMesh("./assets/texture-test.glb", "pine-mesh");
-    usr.plant.init();
+    usr.placeholder.loadPlaceholder();
+    usr.placeholder.init();
 
-    usr.cubeTop.loadMesh("./assets/texture-test.glb", "big-cube-mesh-0");
-    usr.cubeTop.init();
+    // The meshes load in the background while the first frames show
+    // the placeholder. They share one import of the file, freed once
+    // the last of them is loaded.
+    usr.textureTest.pin("./assets/texture-test.glb");
 
-    usr.cubeBody.loadMesh("./assets/texture-test.glb", "big-cube-mesh-1");
-    usr.cubeBody.init();
+    // GLB file contains normals, but Blender not
+    usr.plant.startLoading("./assets/texture-test.glb", "pine-mesh");
+    usr.cubeTop.startLoading(
+        "./assets/texture-test.glb", "big-cube-mesh-0"
+    );
+    usr.cubeBody.startLoading(
+        "./assets/texture-test.glb", "big-cube-mesh-1"
+    );
 
     usr.imgui.init(ctx);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_DEPTH_TEST);
+    vtx::enable(GL_BLEND);
+    vtx::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    vtx::enable(GL_DEPTH_TEST);
 
-    // Figure projection matrix
-    float fov       = glm::radians(45.0f);  // Field of view in radians
-    float nearPlane = 0.1f;    // Distance to the near clipping plane
-    float farPlane  = 100.0f;  // Distance to the far clipping plane
-    // Actually, this needs to be recalculated in the loop,
-    // as window could be resized at any time by user
-    float aspectRatio =   (float) ctx->screenWidth / (float) ctx->screenHeight;
-
-    // But, here is the initials perspective matrix
-    glm::mat4 projectionMatrix =
-        glm::perspective(fov, aspectRatio, nearPlane, farPlane);
-
-    usr.plant.updateProjectionMatrix(projectionMatrix);
-    usr.cubeTop.updateProjectionMatrix(projectionMatrix);
-    usr.cubeBody.updateProjectionMatrix(projectionMatrix);
+    // Recalculated in the loop when the window is resized
+    usr.projection = perspectiveFor(ctx->screenWidth, ctx->screenHeight);
+
+    // From here on loop() makes no GL calls, render() does them all
+    vtx::FramePacket* packets[VTX_FRAME_PACKET_SLOTS];
+    for (int i = 0; i < VTX_FRAME_PACKET_SLOTS; i++) {
+        packets[i] = &usr.framePackets[i];
+    }
+    vtx::setRenderThread(ctx, packets, render);
+    vtx::setLateLatch(ctx, lateLatch);
 }
 
 void vtx::loop(vtx::VertexContext* ctx)
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event) != 0) {
-        if (event.type == SDL_QUIT) {
-            vtx::exitVortex();
-            return;
-        }
-        if (event.type == SDL_KEYDOWN) {
-            if (event.key.keysym.sym == SDLK_ESCAPE) {
+    {
+        VTX_PROFILE_SCOPE("handleEvents");
+        for (SDL_Event& event : ctx->input.events) {
+            if (event.type == SDL_QUIT) {
                 vtx::exitVortex();
                 return;
             }
-        }
+            if (event.type == SDL_WINDOWEVENT &&
+                event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                ctx->screenWidth  = event.window.data1;
+                ctx->screenHeight = event.window.data2;
+                usr.projection =
+                    perspectiveFor(ctx->screenWidth, ctx->screenHeight);
+            }
+            if (event.type == SDL_KEYDOWN) {
+                if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    vtx::exitVortex();
+                    return;
+                }
+            }
 
-        usr.imgui.processEvent(&event);
-    }
+            usr.imgui.processEvent(&event);
 
-    glClearColor(0.1f, 0.4f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (event.type == SDL_MOUSEBUTTONDOWN &&
+                event.button.button == SDL_BUTTON_RIGHT &&
+                !ImGui::GetIO().WantCaptureMouse) {
+                usr.dragging   = true;
+                usr.dragStartX = event.button.x;
+            }
+            if (event.type == SDL_MOUSEBUTTONUP &&
+                event.button.button == SDL_BUTTON_RIGHT &&
+                usr.dragging) {
+                int dragged = event.button.x - usr.dragStartX;
+                usr.cameraYaw += (float) dragged * 0.01f;
+                usr.dragging = false;
+            }
+        }
+    }
 
-static Uint32 lastTime = 0;
-Uint32 currentTime = SDL_GetTicks();
-float deltaTime = (currentTime - lastTime) / 1000.0f;
-lastTime = currentTime;
+    MyFramePacket* packet = vtx::beginFramePacket<MyFramePacket>(ctx);
 
 float rotationSpeed = glm::radians(45.0f);  // Rotation speed in radians per second
-float angle = rotationSpeed * SDL_GetTicks() / 1000.0f;  // Total angle based on elapsed time
+float angle = rotationSpeed * ctx->frameTime;  // Total angle based on elapsed time
 
 modelToWorld = glm::mat4(1.0f);  // Start with an identity matrix
 modelToWorld = glm::rotate(modelToWorld, angle, glm::vec3(0.0f, 1.0f, 0.0f));
 
-    usr.plant.updateTransformationMatrix(usr.plant.initialTransform);
-    usr.plant.updateViewMatrix(cameraMatrix);
-    usr.plant.updateDiffuseTexture(usr.plant.diffuseTextureId);
-    usr.plant.draw();
-
-    usr.cubeTop.updateTransformationMatrix(usr.cubeTop.initialTransform * modelToWorld);
-    usr.cubeTop.updateViewMatrix(cameraMatrix);
-    usr.cubeTop.updateDiffuseTexture(usr.cubeTop.diffuseTextureId);
-    usr.cubeTop.draw();
+    // lateLatch() turns this once more right before render() gets it
+    glm::mat4 worldToView = orbitCamera(ctx->input.mouseX);
+    packet->worldToView   = worldToView;
+    packet->projection    = usr.projection;
 
-    usr.cubeBody.updateTransformationMatrix(usr.cubeBody.initialTransform * modelToWorld);
-    usr.cubeBody.updateViewMatrix(cameraMatrix);
-    usr.cubeBody.updateDiffuseTexture(usr.cubeBody.diffuseTextureId); // ok it is time to exract shader
-    usr.cubeBody.draw();
+    // The pine has see-through leaves, so it is blended after the cubes
+    submitMesh(
+        usr.plant, &packet->drawList, vtx::RENDER_PASS_TRANSPARENT,
+        glm::mat4(1.0f), worldToView
+    );
+    submitMesh(
+        usr.cubeTop, &packet->drawList, vtx::RENDER_PASS_OPAQUE,
+        modelToWorld, worldToView
+    );
+    submitMesh(
+        usr.cubeBody, &packet->drawList, vtx::RENDER_PASS_OPAQUE,
+        modelToWorld, worldToView
+    );
+    // Every mesh of the file is in, its import is not needed any more
+    if (usr.textureTest.cached != nullptr &&
+        vtx::pendingAssetCount() == 0) {
+        usr.textureTest.release();
+    }
 
     usr.imgui.newFrame();
     usr.imgui.showMatrixEditor(
         &modelToWorld, "Model-to-World for mesh"
     );
     usr.imgui.showMatrixEditor(&cameraMatrix, "Camera matrix");
-    usr.imgui.renderFrame();
+    vtx::showProfilerPanel();
+    vtx::showGpuMemoryPanel();
+
+    ImGui::Begin("Input");
+    ImGui::Text(
+        "Input to swap: %.2f ms",
+        ctx->inputLatency.load(std::memory_order_relaxed)
+    );
+    ImGui::Text("Merged motion events: %d", ctx->input.coalesced);
+    ImGui::Text("Assets loading: %d", vtx::pendingAssetCount());
+    ImGui::Text(
+        "Frame interval: %.2f ms, deviation %.2f ms",
+        ctx->pacer.intervalMean, ctx->pacer.intervalStdDev
+    );
+    ImGui::Text(
+        "Slept %.2f ms, spun %.2f ms", ctx->pacer.sleptMs,
+        ctx->pacer.spunMs
+    );
+    ImGui::End();
+
+    usr.imgui.captureFrame(packet);
+}
+
+// The mouse moved on while loop() ran, the camera follows it to where
+// it is now. Depth sorting keeps the slightly older camera, which does
+// not matter for a few pixels of motion.
+static void lateLatch(vtx::VertexContext* ctx, vtx::FramePacket* packet)
+{
+    packet->worldToView = orbitCamera(ctx->input.mouseX);
+}
+
+// Runs on the render thread while loop() builds the next packet
+static void render(vtx::VertexContext* ctx, vtx::FramePacket* framePacket)
+{
+    MyFramePacket* packet = static_cast<MyFramePacket*>(framePacket);
+
+    glClearColor(0.1f, 0.4f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    vtx::writeFrameConstants(
+        packet->worldToView, packet->projection, packet->frameTime,
+        packet->deltaTime, packet->screenWidth, packet->screenHeight
+    );
+    packet->drawList.flush();
+
+    usr.imgui.renderFrame(packet);
 
     checkOpenGLError();
-    SDL_GL_SwapWindow(ctx->sdlWindow);
+    vtx::swapWindow(ctx);
 }
 
 int main(int argc, char* argv[]) { vtx::openVortex(); }
@@ -15,7 +15,14 @@
 #include <vector>
 
 #include "../../src/vtx/ctx.h"
+#include "../../src/vtx/cooked-texture.h"
+#include "../../src/vtx/shader-program.h"
 #include "../../src/vtx/gizmo.h"
+#include "../../src/vtx/gpu-memory-panel.h"
+#include "../../src/vtx/mesh-cache.h"
+#include "../../src/vtx/profiler-panel.h"
+#include "../../src/vtx/scene-cache.h"
+#include "../../src/vtx/texture-batch.h"
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
 #include "imgui_impl_sdl2.h"
@@ -34,12 +41,16 @@ struct Text {
     const int ATLAS_HEIGHT = 512;
     const float FONT_SIZE  = 32.0f;
 
-    GLuint fontTexture;
+    vtx::GpuTexture fontTexture;
     Character characters[128];
-    GLuint textShaderId;
+    vtx::ShaderProgram textShaderId;
+    vtx::UniformHandle textColorUniform   = "textColor";
+    vtx::UniformHandle projectionUniform  = "projection";
+    vtx::UniformHandle fontTextureUniform = "fontTexture";
 
     void loadFont(const char* fontPath)
     {
+        VTX_TRACE_SCOPE_DETAIL("Text::loadFont", fontPath);
         // Load font file
         std::ifstream fontFile(
             fontPath, std::ios::binary | std::ios::ate
@@ -118,11 +129,9 @@ struct Text {
         }
 
         // Create OpenGL texture for the font atlas
-        glGenTextures(1, &fontTexture);
-        glBindTexture(GL_TEXTURE_2D, fontTexture);
-        glTexImage2D(
-            GL_TEXTURE_2D, 0, GL_RED, ATLAS_WIDTH, ATLAS_HEIGHT, 0,
-            GL_RED, GL_UNSIGNED_BYTE, atlas
+        fontTexture.create2D(
+            ATLAS_WIDTH, ATLAS_HEIGHT, GL_RED, GL_RED, GL_UNSIGNED_BYTE,
+            atlas, false, "font atlas"
         );
         glTexParameteri(
             GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR
@@ -131,22 +140,22 @@ struct Text {
             GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR
         );
     }
-    GLuint VAO, VBO;
+    GLuint VAO;
+    // Quads of the whole string go into the stream buffer of the
+    // frame and are drawn at once
+    vtx::StreamBuffer* stream;
+    std::vector<float> vertices;  // kept to reuse its capacity
 
-    void setupTextRendering()
+    void setupTextRendering(vtx::StreamBuffer* stream)
     {
+        this->stream = stream;
         glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
 
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        vtx::bindVertexArray(VAO);
+        vtx::bindBuffer(GL_ARRAY_BUFFER, stream->buffer);
 
         // Each character quad requires 6 vertices with 4 attributes
         // (position and tex coords)
-        glBufferData(
-            GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL,
-            GL_DYNAMIC_DRAW
-        );
 
         // Vertex positions (layout location 0)
         glEnableVertexAttribArray(0);
@@ -161,10 +170,10 @@ struct Text {
             (void*) (2 * sizeof(float))
         );
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-        this->textShaderId = vtx::createShaderProgram(
-            TEXT_VERTEX_SHADER, TEXT_FRAGMENT_SHADER
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0);
+        vtx::bindVertexArray(0);
+        this->textShaderId.create(
+            TEXT_VERTEX_SHADER, TEXT_FRAGMENT_SHADER, "text"
         );
     }
 
@@ -174,28 +183,23 @@ struct Text {
         float y,
         float scale,
         glm::vec3 color,
-        GLuint shader,
+        const vtx::ShaderProgram& shader,
         const glm::mat4& projection
     )
     {
-        // Activate shader and set uniforms
-        glUseProgram(shader);
-        glUniform3f(
-            glGetUniformLocation(shader, "textColor"), color.x, color.y,
-            color.z
-        );
-        glUniformMatrix4fv(
-            glGetUniformLocation(shader, "projection"), 1, GL_FALSE,
-            &projection[0][0]
-        );
-        glUniform1i(glGetUniformLocation(shader, "fontTexture"), 0);
+        VTX_PROFILE_GPU_SCOPE("Text::renderText");
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, fontTexture);
+        // Set uniforms and activate shader
+        shader.set(this->textColorUniform, color);
+        shader.set(this->projectionUniform, projection);
+        shader.set(this->fontTextureUniform, 0);
+        shader.use();
 
-        glBindVertexArray(VAO);
+        vtx::activeTexture(GL_TEXTURE0);
+        vtx::bindTexture(GL_TEXTURE_2D, fontTexture.id);
 
         // Iterate through each character in the string
+        vertices.clear();
         for (char c : text) {
             Character ch = characters[c];
 
@@ -206,33 +210,42 @@ struct Text {
             float w = (ch.x1 - ch.x0) * ATLAS_WIDTH * scale;
             float h = (ch.y1 - ch.y0) * ATLAS_HEIGHT * scale;
 
-            // Update VBO for the character quad
-            float vertices[6][4] = {
-                {xpos,     ypos + h, ch.x0, ch.y1},
-                {xpos,     ypos,     ch.x0, ch.y0},
-                {xpos + w, ypos,     ch.x1, ch.y0},
-
-                {xpos,     ypos + h, ch.x0, ch.y1},
-                {xpos + w, ypos,     ch.x1, ch.y0},
-                {xpos + w, ypos + h, ch.x1, ch.y1}
-            };
-
-            // Update VBO memory
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferSubData(
-                GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices
+            // Vertices of the character quad
+            vertices.insert(
+                vertices.end(),
+                {
+                    xpos,     ypos + h, ch.x0, ch.y1,
+                    xpos,     ypos,     ch.x0, ch.y0,
+                    xpos + w, ypos,     ch.x1, ch.y0,
+
+                    xpos,     ypos + h, ch.x0, ch.y1,
+                    xpos + w, ypos,     ch.x1, ch.y0,
+                    xpos + w, ypos + h, ch.x1, ch.y1
+                }
             );
 
-            // Render the character quad
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-
             // Advance the cursor to the start position of the next
             // character
             x += ch.advance * scale;
         }
+        if (vertices.empty()) return;
+
+        // One write and one draw for all the quads. The attributes
+        // start at the beginning of the buffer, so the offset is
+        // turned into the first vertex.
+        const size_t stride = 4 * sizeof(float);
+        size_t offset       = vtx::streamWrite(
+            stream, vertices.data(), vertices.size() * sizeof(float),
+            stride
+        );
+        vtx::bindVertexArray(VAO);
+        vtx::drawArrays(
+            GL_TRIANGLES, (GLint) (offset / stride),
+            (GLsizei) (vertices.size() / 4)
+        );
 
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        vtx::bindVertexArray(0);
+        vtx::bindTexture(GL_TEXTURE_2D, 0);
     }
     // Calculates the width in pixels of a given string based on
     // character advances
@@ -296,7 +309,11 @@ struct Hud {
     static const char* HUD_FRAGMENT_SHADER;
 
     GLuint hudVAO;
-    GLuint hudShaderId;
+    vtx::GpuBuffer hudVBO;
+    vtx::ShaderProgram hudShaderId;
+    vtx::UniformHandle projectionUniform = "u_projection";
+    vtx::UniformHandle modelUniform      = "u_model";
+    vtx::UniformHandle hudTextureUniform = "u_hudTexture";
     GLuint hudTextureId;
 
     void initHud()
@@ -316,15 +333,12 @@ struct Hud {
         // clang-format on
 
         glGenVertexArrays(1, &this->hudVAO);
-        glBindVertexArray(this->hudVAO);
+        vtx::bindVertexArray(this->hudVAO);
 
         // Create a vertex buffer for gizmo
-        GLuint hudVBO;
-        glGenBuffers(1, &hudVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, hudVBO);
-        glBufferData(
+        this->hudVBO.create(
             GL_ARRAY_BUFFER, sizeof(hudVertices), hudVertices,
-            GL_STATIC_DRAW
+            GL_STATIC_DRAW, "hud"
         );
         // Enable vertex attribute and bind it to shader location
         // clang-format off
@@ -334,12 +348,12 @@ struct Hud {
         glEnableVertexAttribArray(0);
         glEnableVertexAttribArray(1);
 
-        glBindVertexArray(0);                      // VAO
-        glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+        vtx::bindVertexArray(0);                      // VAO
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+        vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
 
-        this->hudShaderId = vtx::createShaderProgram(
-            HUD_VERTEX_SHADER, HUD_FRAGMENT_SHADER
+        this->hudShaderId.create(
+            HUD_VERTEX_SHADER, HUD_FRAGMENT_SHADER, "hud"
         );
     }
 
@@ -360,11 +374,7 @@ struct Hud {
             model, glm::vec3(hudSize, 1.0f)
         );  // Scale to desired size
 
-        glUseProgram(this->hudShaderId);
-        glUniformMatrix4fv(
-            glGetUniformLocation(this->hudShaderId, "u_projection"), 1,
-            GL_FALSE, glm::value_ptr(model)
-        );
+        this->hudShaderId.set(this->projectionUniform, model);
     }
 
     void drawHud()
@@ -385,68 +395,60 @@ struct Hud {
         );  // Scale to desired size
 
         // Send the model and projection matrices to the shader
-        glUseProgram(this->hudShaderId);
-        glUniformMatrix4fv(
-            glGetUniformLocation(this->hudShaderId, "u_model"), 1,
-            GL_FALSE, glm::value_ptr(model)
-        );
+        this->hudShaderId.set(this->modelUniform, model);
+        this->hudShaderId.use();
 
         // Bind VAO and draw the HUD element
-        glBindVertexArray(this->hudVAO);
-        glDrawArrays(
+        vtx::bindVertexArray(this->hudVAO);
+        vtx::drawArrays(
             GL_TRIANGLES, 0, 6
         );  // Draw quad for the HUD element
-        glBindVertexArray(0);
+        vtx::bindVertexArray(0);
     }
 
     void updateHudTexture(GLuint textureId)
     {
-        glUseProgram(this->hudShaderId);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureId);
-        glUniform1i(
-            glGetUniformLocation(this->hudShaderId, "u_hudTexture"), 0
-        );  // Texture unit 0
+        vtx::activeTexture(GL_TEXTURE0);
+        vtx::bindTexture(GL_TEXTURE_2D, textureId);
+        this->hudShaderId.set(this->hudTextureUniform, 0);  // unit 0
     }
 };
 
-GLuint createTexture(const char* texturePath)
+// Flipped with a setting of its own, stb_image's global one stays as
+// it was
+void createTexture(
+    vtx::JobSystem* jobs,
+    vtx::GpuTexture* hudTexture,
+    const char* texturePath,
+    const char* cookedPath
+)
 {
-    GLuint hudTexture;
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(1);  // Enable vertical flip
-    unsigned char* data =
-        stbi_load(texturePath, &width, &height, &nrChannels, 0);
-    stbi_set_flip_vertically_on_load(0
-    );  // Reset to default after loading
-
-    std::cerr << "stbi loaded " << texturePath << " " << width << "x"
-              << height << std::endl;
-    glGenTextures(1, &hudTexture);
-    glBindTexture(GL_TEXTURE_2D, hudTexture);
-
-    // Set texture parameters for wrapping and filtering
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Upload texture data
-    if (data) {
-        std::cerr << "dataexists " << std::endl;
-        GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
-        glTexImage2D(
-            GL_TEXTURE_2D, 0, format, width, height, 0, format,
-            GL_UNSIGNED_BYTE, data
+    // Written by make cook with every mip level, ETC2 where it can
+    if (vtx::loadCookedTexture(cookedPath, hudTexture)) {
+        GLenum target = GL_TEXTURE_2D;
+        glTexParameteri(
+            target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR
         );
-        glGenerateMipmap(GL_TEXTURE_2D);
-        stbi_image_free(data);  // Free image data after loading to GPU
-    } else {
-        std::cerr << "Failed to load texture" << std::endl;
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        vtx::bindTexture(GL_TEXTURE_2D, 0);
+        return;
     }
 
-    return hudTexture;
-    std::cerr << "nr channels " << nrChannels << std::endl;
+    // Sampled the same way as the cooked one, the mips are generated
+    vtx::TextureDecode decode = {};
+    decode.path               = texturePath;
+    decode.flipVertically     = true;
+    decode.wrap               = GL_CLAMP_TO_EDGE;
+    decode.minFilter          = GL_LINEAR_MIPMAP_LINEAR;
+    decode.magFilter          = GL_LINEAR;
+    vtx::decodeTextures(jobs, &decode, 1);
+    if (decode.texels == nullptr) return;
+
+    std::cerr << "stbi loaded " << texturePath << " " << decode.width
+              << "x" << decode.height << std::endl;
+    vtx::uploadTextures(&decode, hudTexture, 1);
 }
 
 const char* Hud::HUD_VERTEX_SHADER =
@@ -515,39 +517,45 @@ struct MyMesh {
     std::vector<MyVertex> vertices;
     std::vector<unsigned int> indices;
     GLuint modelVAO;
-    GLuint defaultShader;
-    uint diffuseTextureId;
+    vtx::GpuBuffer vertexBuffer, indexBuffer;
+    std::string name;  // names its GPU memory
+    vtx::ShaderProgram defaultShader;
+    vtx::UniformHandle modelToWorldUniform   = "u_modelToWorld";
+    vtx::UniformHandle diffuseTextureUniform = "u_diffuseTexture";
+    uint diffuseTextureId = 0;
+    vtx::GpuTexture diffuseTexture;
+    // What init() uploads, mapped from the mesh cache or made by the
+    // import
+    vtx::CookedMesh cooked = {};
+    vtx::ScenePin scenePin;  // the shared import, until uploaded
+    GLsizei indexCount = 0;
     glm::mat4 initialTransform;
 
     void init()
     {
         // Create VAO
         glGenVertexArrays(1, &modelVAO);
-        glBindVertexArray(modelVAO);
+        vtx::bindVertexArray(modelVAO);
 
-        // Create VBO with vertices
-        GLuint VBO;
-        glGenBuffers(1, &VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(
+        // Create VBO with vertices, on warm starts straight from the
+        // mapped cooked file
+        this->vertexBuffer.create(
             GL_ARRAY_BUFFER,
-            vertices.size() *
-                sizeof(MyVertex),  // all vertices in bytes
-            vertices.data(), GL_STATIC_DRAW
+            (size_t) cooked.vertexCount *
+                cooked.vertexStride,  // all vertices in bytes
+            cooked.vertices, GL_STATIC_DRAW, this->name.c_str()
         );
 
         // Create EBO with indexes
-        GLuint EBO;
-        glGenBuffers(1, &EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(
+        this->indexBuffer.create(
             GL_ELEMENT_ARRAY_BUFFER,  // This is used for EBO
-            indices.size() * sizeof(unsigned int), indices.data(),
-            GL_STATIC_DRAW
+            cooked.indexCount * sizeof(unsigned int), cooked.indices,
+            GL_STATIC_DRAW, this->name.c_str()
         );
+        this->indexCount = (GLsizei) cooked.indexCount;
 
         // Links VBO attributes such as coordinates and colors to VAO
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        vtx::bindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer.id);
 
         // clang-format off
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MyVertex), (void*) offsetof(MyVertex, position));
@@ -562,127 +570,67 @@ struct MyMesh {
         glEnableVertexAttribArray(3);
 
         // Unbind all to prevent accidentally modifying them
-        glBindVertexArray(0);                      // VAO
-        glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+        vtx::bindVertexArray(0);                      // VAO
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+        vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+
+        if (cooked.texels != nullptr) createDiffuseTexture();
+
+        // Uploaded, neither the mapping nor the import is needed
+        vtx::releaseCookedMesh(&cooked);
+        this->scenePin.release();
 
-        defaultShader = vtx::createShaderProgram(
-            MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER
+        defaultShader.create(
+            MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER, "model"
         );
     }
-    uint
-    createTextureFromAssimp(const aiScene* scene, aiMaterial* material)
+    // The embedded diffuse texture, decoded once for the whole file,
+    // init() uploads it
+    void takeSceneTexture(const vtx::SceneMesh& sceneMesh)
     {
-        aiString texturePath;
-
-        if (material->GetTexture(
-                aiTextureType_DIFFUSE, 0, &texturePath
-            ) == AI_SUCCESS) {
-            const aiTexture* texture =
-                scene->GetEmbeddedTexture(texturePath.C_Str());
-
-            if (texture) {
-                unsigned char* data = nullptr;
-
-                int width, height, channels;
-                unsigned char* imageData = stbi_load_from_memory(
-                    reinterpret_cast<unsigned char*>(texture->pcData),
-                    texture->mWidth,  // mWidth holds the length of the
-                                      // compressed data buffer
-                    &width, &height, &channels, 0
-                );
-
-                uint glChan;
-                if (channels == 3) {
-                    glChan = GL_RGB;
-                } else if (channels == 4) {
-                    glChan = GL_RGBA;
-                } else {
-                    return 0;
-                }
-
-                if (imageData) {
-                    // Successfully loaded image; you can now use
-                    // imageData, width, height, and channels For
-                    // example, generate an OpenGL texture:
-                    GLuint textureID;
-                    glGenTextures(1, &textureID);
-                    glBindTexture(GL_TEXTURE_2D, textureID);
-                    glTexImage2D(
-                        GL_TEXTURE_2D, 0, glChan, width, height, 0,
-                        glChan, GL_UNSIGNED_BYTE, imageData
-                    );
-
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST
-                    );
-                    glTexParameterf(
-                        GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT
-                    );
-
-                    glGenerateMipmap(GL_TEXTURE_2D);
-
-                    // Unbind to make suree something else does not
-                    // interfere
-                    glBindTexture(GL_TEXTURE_2D, 0);
-
-                    // Free stb_image data after generating texture
-                    stbi_image_free(imageData);
-                    return textureID;
-                } else {
-                }
-            }
-        }
-        return 0;
+        const vtx::SceneTexture* texture =
+            vtx::sceneDiffuseTexture(&this->scenePin, sceneMesh);
+        if (texture == nullptr) return;
+
+        cooked.texels        = texture->texels;
+        cooked.textureWidth  = texture->width;
+        cooked.textureHeight = texture->height;
+        cooked.textureFormat =
+            texture->channels == 4 ? GL_RGBA : GL_RGB;
     }
 
-    void updateDiffuseTexture(uint diffuseTexture)
+    void createDiffuseTexture()
     {
-        glUseProgram(this->defaultShader);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseTexture);
+        this->diffuseTexture.create2D(
+            cooked.textureWidth, cooked.textureHeight,
+            cooked.textureFormat, cooked.textureFormat,
+            GL_UNSIGNED_BYTE, cooked.texels, true, this->name.c_str()
+        );
 
-        glUniform1i(
-            glGetUniformLocation(
-                this->defaultShader, "u_diffuseTexture"
-            ),
-            0
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST
         );
-        checkOpenGLError();
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST
+        );
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        // Unbind to make suree something else does not interfere
+        vtx::bindTexture(GL_TEXTURE_2D, 0);
+        this->diffuseTextureId = this->diffuseTexture.id;
     }
 
-    // Recursive function to find the node containing the mesh index
-    const aiNode*
-    findNodeForMeshIndex(const aiNode* node, unsigned int meshIndex)
+    void updateDiffuseTexture(uint diffuseTexture)
     {
-        // Check if this node references the mesh index
-        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-            if (node->mMeshes[i] == meshIndex) {
-                return node;  // Found the node
-            }
-        }
+        vtx::activeTexture(GL_TEXTURE0);
+        vtx::bindTexture(GL_TEXTURE_2D, diffuseTexture);
 
-        // Recursively search child nodes
-        for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            const aiNode* foundNode =
-                findNodeForMeshIndex(node->mChildren[i], meshIndex);
-            if (foundNode) {
-                return foundNode;
-            }
-        }
-
-        return nullptr;  // Node not found
+        this->defaultShader.set(this->diffuseTextureUniform, 0);
+        checkOpenGLError();
     }
+
     inline glm::mat4 assimpToGlmMatrix(aiMatrix4x4 mat)
     {
         glm::mat4 m;
@@ -695,46 +643,34 @@ struct MyMesh {
     }
     void loadMesh(const char* path, const char* meshName)
     {
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(
-            path,  // path of the file
-            aiProcess_Triangulate | aiProcess_FlipUVs |
-                // aiProcess_GenNormals |
-                aiProcess_CalcTangentSpace
+        this->name               = meshName;
+        unsigned int importFlags = aiProcess_Triangulate |
+                                   aiProcess_FlipUVs |
+                                   // aiProcess_GenNormals |
+                                   aiProcess_CalcTangentSpace;
+
+        // A cooked copy from an earlier start skips Assimp and
+        // stb_image altogether
+        uint64_t cacheKey = vtx::meshCacheKey(
+            path, meshName, importFlags, sizeof(MyVertex)
         );
-
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-            !scene->mRootNode) {
+        if (vtx::loadCookedMesh(cacheKey, &this->cooked)) {
+            this->initialTransform = glm::make_mat4(cooked.transform);
             return;
         }
 
-        aiMesh* mesh           = nullptr;
-        unsigned int meshIndex = 0;
-        // Iterate through all the meshes in the scene
-        for (meshIndex = 0; meshIndex < scene->mNumMeshes;
-             meshIndex++) {
-            mesh = scene->mMeshes[meshIndex];
-
-            // Print the name of the mesh
-            if (mesh->mName.length > 0) {
-                std::cout << "Mesh Name: " << mesh->mName.C_Str()
-                          << std::endl;
-                const char* currentMeshName = mesh->mName.C_Str();
-                if (strcmp(currentMeshName, meshName) == 0) {
-                    std::cout << "Found matching mesh: " << meshName
-                              << std::endl;
-                    break;  // Exit the loop
-                }
-            }
-        }
-        if (mesh == nullptr) {
-            std::cerr << "Error loading mesh: " << meshName
-                      << std::endl;  // Fallback name
-        }
+        // The meshes of one file share its import, pinned until
+        // init() has uploaded this one
+        this->scenePin.pin(path);
+        vtx::SceneMesh sceneMesh =
+            vtx::findSceneMesh(&this->scenePin, meshName, importFlags);
+        if (sceneMesh.mesh == nullptr) return;
+        const aiScene* scene   = sceneMesh.scene;
+        const aiMesh* mesh     = sceneMesh.mesh;
+        unsigned int meshIndex = sceneMesh.meshIndex;
 
         glm::mat4 globalTransform(1.0f);
-        const aiNode* node =
-            this->findNodeForMeshIndex(scene->mRootNode, meshIndex);
+        const aiNode* node = sceneMesh.node;
 
         // Traverse up the node hierarchy
         while (node != nullptr) {
@@ -807,64 +743,41 @@ struct MyMesh {
             }
         }
 
-        this->diffuseTextureId =
-            this->createTextureFromAssimp(scene, material);
-    }
-
-    void updateProjectionMatrix(const glm::mat4 projectionMatrix) const
-    {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_projection"
-            ),                                // uniform location
-            1,                                // number of matrices
-            GL_FALSE,                         // transpose
-            glm::value_ptr(projectionMatrix)  // value
+        this->takeSceneTexture(sceneMesh);
+
+        // init() uploads from here, and the next start from the file
+        cooked.vertices     = vertices.data();
+        cooked.vertexStride = sizeof(MyVertex);
+        cooked.vertexCount  = (uint32_t) vertices.size();
+        cooked.indices      = indices.data();
+        cooked.indexCount   = (uint32_t) indices.size();
+        memcpy(
+            cooked.transform, glm::value_ptr(this->initialTransform),
+            sizeof(cooked.transform)
         );
+        vtx::storeCookedMesh(cacheKey, &cooked);
     }
 
     void updateTransformationMatrix(const glm::mat4 transformationMatrix
     ) const
     {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_modelToWorld"
-            ),                                    // uniform location
-            1,                                    // number of matrices
-            GL_FALSE,                             // transpose
-            glm::value_ptr(transformationMatrix)  // value
-        );
+        this->defaultShader.set(this->modelToWorldUniform, transformationMatrix);
     }
 
-    void updateViewMatrix(const glm::mat4 viewMatrix) const
-    {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_worldToView"
-            ),                          // uniform location
-            1,                          // number of matrices
-            GL_FALSE,                   // transpose
-            glm::value_ptr(viewMatrix)  // value
-        );
-    }
     void draw() const
     {
+        VTX_PROFILE_GPU_SCOPE("MyMesh::draw");
+
         // Draw using default shader
-        glUseProgram(this->defaultShader);
-        glBindVertexArray(this->modelVAO);
-        glDrawElements(
+        this->defaultShader.use();
+        vtx::bindVertexArray(this->modelVAO);
+        vtx::drawElements(
             GL_TRIANGLES,     // Mode
-            indices.size(),   // Index count
+            indexCount,       // Index count
             GL_UNSIGNED_INT,  // Data type of indices array
             (void*) (0 * sizeof(unsigned int))  // Indices pointer
         );
-        glBindVertexArray(0);
+        vtx::bindVertexArray(0);
     }
 };
 // == MyModel impl ==
@@ -874,6 +787,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
 	precision mediump float;
 
@@ -888,9 +802,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
     out vec3 v_normal;
     out vec3 v_lightPos;
 
-    uniform mat4 u_worldToView;
     uniform mat4 u_modelToWorld;
-    uniform mat4 u_projection;
 
 	void main() {
         // Invert the model-to-world matrix to transform
@@ -906,7 +818,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
         v_crntPos     = vec3(u_modelToWorld * vec4(a_pos, 1.0f));
         v_lightPos    = vec3(u_worldToModel *  vec4(hardcodedLightPos, 1.0f));
 
-        gl_Position   = u_projection * u_worldToView * vec4(v_crntPos, 1.0f);
+        gl_Position   = u_viewProjection * vec4(v_crntPos, 1.0f);
 	}
 	)";
 
@@ -984,8 +896,12 @@ struct MyImGui {
 
     void renderFrame()
     {
+        VTX_PROFILE_GPU_SCOPE("MyImGui::renderFrame");
+
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        // ImGui sets its own GL state, so what we shadow is stale now
+        vtx::invalidateGLState();
     }
 
     void showMatrixEditor(glm::mat4* matrix, const char* title) const
@@ -1033,7 +949,10 @@ typedef struct {
     MyMesh cubeBody;
     MyImGui imgui;
     Hud hud;
+    vtx::GpuTexture heartTexture;
     Text text;
+    // Only changes when the window does
+    glm::mat4 projection;
 } UserContext;
 
 UserContext usr;
@@ -1050,8 +969,22 @@ glm::mat4 cameraMatrix = glm::lookAt(
 
 glm::mat4 modelToWorld = glm::mat4(1.0f);  // Identity matrix
 
+glm::mat4 perspectiveFor(int screenWidth, int screenHeight)
+{
+    float fov       = glm::radians(45.0f);  // Field of view in radians
+    float nearPlane = 0.1f;    // Distance to the near clipping plane
+    float farPlane  = 100.0f;  // Distance to the far clipping plane
+    float aspectRatio = (float) screenWidth / (float) screenHeight;
+    return glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+}
+
 void vtx::init(vtx::VertexContext* ctx)
 {
+    // The meshes share one import of the file, freed once the last
+    // of them is uploaded
+    vtx::ScenePin textureTest;
+    textureTest.pin("./assets/texture-test.glb");
+
     usr.cubeTop.loadMesh(
         "./assets/texture-test.glb", "big-cube-mesh-0"
     );
@@ -1061,72 +994,70 @@ void vtx::init(vtx::VertexContext* ctx)
         "./assets/texture-test.glb", "big-cube-mesh-1"
     );
     usr.cubeBody.init();
+    textureTest.release();
 
     usr.imgui.init(ctx);
 
     usr.text.loadFont("./assets/04b03.ttf");
-    usr.text.setupTextRendering();
+    usr.text.setupTextRendering(ctx->vertexStream);
 
-    GLuint heartTextureId = createTexture("./assets/heart.png");
-    usr.hud.hudTextureId  = heartTextureId;
+    createTexture(
+        ctx->jobs, &usr.heartTexture, "./assets/heart.png",
+        "./assets/heart.vtxt"
+    );
+    usr.hud.hudTextureId = usr.heartTexture.id;
     usr.hud.initHud();
     usr.hud.resizeHud(0, 0, ctx->screenWidth, ctx->screenHeight);
-    usr.hud.updateHudTexture(heartTextureId);
+    usr.hud.updateHudTexture(usr.heartTexture.id);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_DEPTH_TEST);
+    vtx::enable(GL_BLEND);
+    vtx::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    vtx::enable(GL_DEPTH_TEST);
 
-    // Figure projection matrix
-    float fov       = glm::radians(45.0f);  // Field of view in radians
-    float nearPlane = 0.1f;    // Distance to the near clipping plane
-    float farPlane  = 100.0f;  // Distance to the far clipping plane
-    // Actually, this needs to be recalculated in the loop,
-    // as window could be resized at any time by user
-    float aspectRatio =
-        (float) ctx->screenWidth / (float) ctx->screenHeight;
-
-    // But, here is the initials perspective matrix
-    glm::mat4 projectionMatrix =
-        glm::perspective(fov, aspectRatio, nearPlane, farPlane);
-
-    usr.cubeTop.updateProjectionMatrix(projectionMatrix);
-    usr.cubeBody.updateProjectionMatrix(projectionMatrix);
+    // Recalculated in the loop when the window is resized
+    usr.projection = perspectiveFor(ctx->screenWidth, ctx->screenHeight);
 }
 
 void vtx::loop(vtx::VertexContext* ctx)
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event) != 0) {
-        if (event.type == SDL_QUIT) {
-            vtx::exitVortex();
-            return;
-        }
-        if (event.type == SDL_WINDOWEVENT &&
-            event.window.event == SDL_WINDOWEVENT_RESIZED) {
-        }
-        if (event.type == SDL_KEYDOWN) {
-            if (event.key.keysym.sym == SDLK_ESCAPE) {
+    {
+        VTX_PROFILE_SCOPE("handleEvents");
+        for (SDL_Event& event : ctx->input.events) {
+            if (event.type == SDL_QUIT) {
                 vtx::exitVortex();
                 return;
             }
-        }
+            if (event.type == SDL_WINDOWEVENT &&
+                event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                ctx->screenWidth  = event.window.data1;
+                ctx->screenHeight = event.window.data2;
+                usr.projection =
+                    perspectiveFor(ctx->screenWidth, ctx->screenHeight);
+            }
+            if (event.type == SDL_KEYDOWN) {
+                if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    vtx::exitVortex();
+                    return;
+                }
+            }
 
-        usr.imgui.processEvent(&event);
+            usr.imgui.processEvent(&event);
+        }
     }
 
     glClearColor(0.1f, 0.4f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    static Uint32 lastTime = 0;
-    Uint32 currentTime     = SDL_GetTicks();
-    float deltaTime        = (currentTime - lastTime) / 1000.0f;
-    lastTime               = currentTime;
+    // Camera and projection for every shader at once
+    vtx::writeFrameConstants(
+        cameraMatrix, usr.projection, ctx->frameTime, ctx->deltaTime,
+        ctx->screenWidth, ctx->screenHeight
+    );
 
     float rotationSpeed =
         glm::radians(45.0f);  // Rotation speed in radians per second
-    float angle = rotationSpeed * SDL_GetTicks() /
-                  1000.0f;  // Total angle based on elapsed time
+    float angle =
+        rotationSpeed * ctx->frameTime;  // Total angle based on elapsed time
 
     modelToWorld = glm::mat4(1.0f);  // Start with an identity matrix
     modelToWorld =
@@ -1135,14 +1066,12 @@ void vtx::loop(vtx::VertexContext* ctx)
     usr.cubeTop.updateTransformationMatrix(
         usr.cubeTop.initialTransform * modelToWorld
     );
-    usr.cubeTop.updateViewMatrix(cameraMatrix);
     usr.cubeTop.updateDiffuseTexture(usr.cubeTop.diffuseTextureId);
     usr.cubeTop.draw();
 
     usr.cubeBody.updateTransformationMatrix(
         usr.cubeBody.initialTransform * modelToWorld
     );
-    usr.cubeBody.updateViewMatrix(cameraMatrix);
     usr.cubeBody.updateDiffuseTexture(usr.cubeBody.diffuseTextureId
     );  // ok it is time to exract shader
     usr.cubeBody.draw();
@@ -1177,10 +1106,12 @@ void vtx::loop(vtx::VertexContext* ctx)
         &modelToWorld, "Model-to-World for mesh"
     );
     usr.imgui.showMatrixEditor(&cameraMatrix, "Camera matrix");
+    vtx::showProfilerPanel();
+    vtx::showGpuMemoryPanel();
     usr.imgui.renderFrame();
 
     checkOpenGLError();
-    SDL_GL_SwapWindow(ctx->sdlWindow);
+    vtx::swapWindow(ctx);
 }
 
 int main(int argc, char* argv[]) { vtx::openVortex(); }
@@ -15,7 +15,12 @@
 #include <vector>
 
 #include "../../src/vtx/ctx.h"
+#include "../../src/vtx/shader-program.h"
 #include "../../src/vtx/gizmo.h"
+#include "../../src/vtx/gpu-memory-panel.h"
+#include "../../src/vtx/mesh-cache.h"
+#include "../../src/vtx/profiler-panel.h"
+#include "../../src/vtx/scene-cache.h"
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
 #include "imgui_impl_sdl2.h"
@@ -136,7 +141,10 @@ struct Line {
     static const char* LINE_FRAGMENT_SHADER;
 
     GLuint lineVAO;
-    GLuint lineShaderId;
+    vtx::GpuBuffer lineVBO;
+    vtx::ShaderProgram lineShaderId;
+    vtx::UniformHandle modelUniform = "uModel";
+    vtx::UniformHandle colorUniform = "uColor";
 
     void initLine() {
         float lineVertices[] = {
@@ -148,42 +156,39 @@ struct Line {
             0.0f, -0.0f, 0.0f,
             // Add more lines as needed
         };
-        GLuint VAO, VBO;
+        GLuint VAO;
         glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
 
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(lineVertices), lineVertices, GL_STATIC_DRAW);
+        vtx::bindVertexArray(VAO);
+        this->lineVBO.create(GL_ARRAY_BUFFER, sizeof(lineVertices), lineVertices, GL_STATIC_DRAW, "lines");
 
         // Enable the vertex attribute
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0); 
-        glBindVertexArray(0);
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0); 
+        vtx::bindVertexArray(0);
         this->lineVAO = VAO;
-        this->lineShaderId = vtx::createShaderProgram(
-            LINE_VERTEX_SHADER, LINE_FRAGMENT_SHADER
+        this->lineShaderId.create(
+            LINE_VERTEX_SHADER, LINE_FRAGMENT_SHADER, "line"
         );
         // glLineWidth(5.0f);
     }
 
-    void renderTheLines(const glm::mat4 view, const glm::mat4 projection, const glm::mat4 model) {
-        glUseProgram(this->lineShaderId); // Use your shader program
-
-        // Set your transformation uniforms
-        glUniformMatrix4fv(glGetUniformLocation(this->lineShaderId, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(this->lineShaderId, "uView"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(this->lineShaderId, "uModel"), 1, GL_FALSE, glm::value_ptr(model));
+    void renderTheLines(const glm::mat4 model) {
+        // Set your transformation uniforms, the camera comes from
+        // the frame constants
+        this->lineShaderId.set(this->modelUniform, model);
 
         // Set line colour
-        glUniform4f(glGetUniformLocation(this->lineShaderId, "uColor"), 1.0f, 0.0f, 0.0f, 1.0f); // Red
+        this->lineShaderId.set(this->colorUniform, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f)); // Red
+
+        this->lineShaderId.use(); // Use your shader program
 
-        glBindVertexArray(this->lineVAO);
+        vtx::bindVertexArray(this->lineVAO);
 
-        glDrawArrays(GL_LINES, 0, 4); // Number of vertices in your lines
-        glBindVertexArray(0);
+        vtx::drawArrays(GL_LINES, 0, 4); // Number of vertices in your lines
+        vtx::bindVertexArray(0);
     }
 };
 
@@ -193,16 +198,15 @@ const char* Line::LINE_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
     precision mediump float;
 
     layout(location = 0) in vec3 aPos; // Vertex position
-    uniform mat4 uProjection;
-    uniform mat4 uView;
     uniform mat4 uModel;
 
     void main() {
-        gl_Position = uProjection * uView * uModel * vec4(aPos, 1.0);
+        gl_Position = u_viewProjection * uModel * vec4(aPos, 1.0);
     }
     )";
 
@@ -247,39 +251,45 @@ struct MyMesh {
     std::vector<MyVertex> vertices;
     std::vector<unsigned int> indices;
     GLuint modelVAO;
-    GLuint defaultShader;
-    uint diffuseTextureId;
+    vtx::GpuBuffer vertexBuffer, indexBuffer;
+    std::string name;  // names its GPU memory
+    vtx::ShaderProgram defaultShader;
+    vtx::UniformHandle modelToWorldUniform   = "u_modelToWorld";
+    vtx::UniformHandle diffuseTextureUniform = "u_diffuseTexture";
+    uint diffuseTextureId = 0;
+    vtx::GpuTexture diffuseTexture;
+    // What init() uploads, mapped from the mesh cache or made by the
+    // import
+    vtx::CookedMesh cooked = {};
+    vtx::ScenePin scenePin;  // the shared import, until uploaded
+    GLsizei indexCount = 0;
     glm::mat4 initialTransform;
 
     void init()
     {
         // Create VAO
         glGenVertexArrays(1, &modelVAO);
-        glBindVertexArray(modelVAO);
+        vtx::bindVertexArray(modelVAO);
 
-        // Create VBO with vertices
-        GLuint VBO;
-        glGenBuffers(1, &VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(
+        // Create VBO with vertices, on warm starts straight from the
+        // mapped cooked file
+        this->vertexBuffer.create(
             GL_ARRAY_BUFFER,
-            vertices.size() *
-                sizeof(MyVertex),  // all vertices in bytes
-            vertices.data(), GL_STATIC_DRAW
+            (size_t) cooked.vertexCount *
+                cooked.vertexStride,  // all vertices in bytes
+            cooked.vertices, GL_STATIC_DRAW, this->name.c_str()
         );
 
         // Create EBO with indexes
-        GLuint EBO;
-        glGenBuffers(1, &EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(
+        this->indexBuffer.create(
             GL_ELEMENT_ARRAY_BUFFER,  // This is used for EBO
-            indices.size() * sizeof(unsigned int), indices.data(),
-            GL_STATIC_DRAW
+            cooked.indexCount * sizeof(unsigned int), cooked.indices,
+            GL_STATIC_DRAW, this->name.c_str()
         );
+        this->indexCount = (GLsizei) cooked.indexCount;
 
         // Links VBO attributes such as coordinates and colors to VAO
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        vtx::bindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer.id);
 
         // clang-format off
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MyVertex), (void*) offsetof(MyVertex, position));
@@ -294,127 +304,67 @@ struct MyMesh {
         glEnableVertexAttribArray(3);
 
         // Unbind all to prevent accidentally modifying them
-        glBindVertexArray(0);                      // VAO
-        glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+        vtx::bindVertexArray(0);                      // VAO
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+        vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+
+        if (cooked.texels != nullptr) createDiffuseTexture();
+
+        // Uploaded, neither the mapping nor the import is needed
+        vtx::releaseCookedMesh(&cooked);
+        this->scenePin.release();
 
-        defaultShader = vtx::createShaderProgram(
-            MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER
+        defaultShader.create(
+            MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER, "model"
         );
     }
-    uint
-    createTextureFromAssimp(const aiScene* scene, aiMaterial* material)
+    // The embedded diffuse texture, decoded once for the whole file,
+    // init() uploads it
+    void takeSceneTexture(const vtx::SceneMesh& sceneMesh)
     {
-        aiString texturePath;
-
-        if (material->GetTexture(
-                aiTextureType_DIFFUSE, 0, &texturePath
-            ) == AI_SUCCESS) {
-            const aiTexture* texture =
-                scene->GetEmbeddedTexture(texturePath.C_Str());
-
-            if (texture) {
-                unsigned char* data = nullptr;
-
-                int width, height, channels;
-                unsigned char* imageData = stbi_load_from_memory(
-                    reinterpret_cast<unsigned char*>(texture->pcData),
-                    texture->mWidth,  // mWidth holds the length of the
-                                      // compressed data buffer
-                    &width, &height, &channels, 0
-                );
-
-                uint glChan;
-                if (channels == 3) {
-                    glChan = GL_RGB;
-                } else if (channels == 4) {
-                    glChan = GL_RGBA;
-                } else {
-                    return 0;
-                }
-
-                if (imageData) {
-                    // Successfully loaded image; you can now use
-                    // imageData, width, height, and channels For
-                    // example, generate an OpenGL texture:
-                    GLuint textureID;
-                    glGenTextures(1, &textureID);
-                    glBindTexture(GL_TEXTURE_2D, textureID);
-                    glTexImage2D(
-                        GL_TEXTURE_2D, 0, glChan, width, height, 0,
-                        glChan, GL_UNSIGNED_BYTE, imageData
-                    );
-
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST
-                    );
-                    glTexParameterf(
-                        GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT
-                    );
-
-                    glGenerateMipmap(GL_TEXTURE_2D);
-
-                    // Unbind to make suree something else does not
-                    // interfere
-                    glBindTexture(GL_TEXTURE_2D, 0);
-
-                    // Free stb_image data after generating texture
-                    stbi_image_free(imageData);
-                    return textureID;
-                } else {
-                }
-            }
-        }
-        return 0;
+        const vtx::SceneTexture* texture =
+            vtx::sceneDiffuseTexture(&this->scenePin, sceneMesh);
+        if (texture == nullptr) return;
+
+        cooked.texels        = texture->texels;
+        cooked.textureWidth  = texture->width;
+        cooked.textureHeight = texture->height;
+        cooked.textureFormat =
+            texture->channels == 4 ? GL_RGBA : GL_RGB;
     }
 
-    void updateDiffuseTexture(uint diffuseTexture)
+    void createDiffuseTexture()
     {
-        glUseProgram(this->defaultShader);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseTexture);
+        this->diffuseTexture.create2D(
+            cooked.textureWidth, cooked.textureHeight,
+            cooked.textureFormat, cooked.textureFormat,
+            GL_UNSIGNED_BYTE, cooked.texels, true, this->name.c_str()
+        );
 
-        glUniform1i(
-            glGetUniformLocation(
-                this->defaultShader, "u_diffuseTexture"
-            ),
-            0
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST
         );
-        checkOpenGLError();
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST
+        );
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        // Unbind to make suree something else does not interfere
+        vtx::bindTexture(GL_TEXTURE_2D, 0);
+        this->diffuseTextureId = this->diffuseTexture.id;
     }
 
-    // Recursive function to find the node containing the mesh index
-    const aiNode*
-    findNodeForMeshIndex(const aiNode* node, unsigned int meshIndex)
+    void updateDiffuseTexture(uint diffuseTexture)
     {
-        // Check if this node references the mesh index
-        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-            if (node->mMeshes[i] == meshIndex) {
-                return node;  // Found the node
-            }
-        }
-
-        // Recursively search child nodes
-        for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            const aiNode* foundNode =
-                findNodeForMeshIndex(node->mChildren[i], meshIndex);
-            if (foundNode) {
-                return foundNode;
-            }
-        }
+        vtx::activeTexture(GL_TEXTURE0);
+        vtx::bindTexture(GL_TEXTURE_2D, diffuseTexture);
 
-        return nullptr;  // Node not found
+        this->defaultShader.set(this->diffuseTextureUniform, 0);
+        checkOpenGLError();
     }
+
     inline glm::mat4 assimpToGlmMatrix(aiMatrix4x4 mat)
     {
         glm::mat4 m;
@@ -427,46 +377,34 @@ struct MyMesh {
     }
     void loadMesh(const char* path, const char* meshName)
     {
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(
-            path,  // path of the file
-            aiProcess_Triangulate | aiProcess_FlipUVs |
-                // aiProcess_GenNormals |
-                aiProcess_CalcTangentSpace
+        this->name               = meshName;
+        unsigned int importFlags = aiProcess_Triangulate |
+                                   aiProcess_FlipUVs |
+                                   // aiProcess_GenNormals |
+                                   aiProcess_CalcTangentSpace;
+
+        // A cooked copy from an earlier start skips Assimp and
+        // stb_image altogether
+        uint64_t cacheKey = vtx::meshCacheKey(
+            path, meshName, importFlags, sizeof(MyVertex)
         );
-
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-            !scene->mRootNode) {
+        if (vtx::loadCookedMesh(cacheKey, &this->cooked)) {
+            this->initialTransform = glm::make_mat4(cooked.transform);
             return;
         }
 
-        aiMesh* mesh           = nullptr;
-        unsigned int meshIndex = 0;
-        // Iterate through all the meshes in the scene
-        for (meshIndex = 0; meshIndex < scene->mNumMeshes;
-             meshIndex++) {
-            mesh = scene->mMeshes[meshIndex];
-
-            // Print the name of the mesh
-            if (mesh->mName.length > 0) {
-                std::cout << "Mesh Name: " << mesh->mName.C_Str()
-                          << std::endl;
-                const char* currentMeshName = mesh->mName.C_Str();
-                if (strcmp(currentMeshName, meshName) == 0) {
-                    std::cout << "Found matching mesh: " << meshName
-                              << std::endl;
-                    break;  // Exit the loop
-                }
-            }
-        }
-        if (mesh == nullptr) {
-            std::cerr << "Error loading mesh: " << meshName
-                      << std::endl;  // Fallback name
-        }
+        // The meshes of one file share its import, pinned until
+        // init() has uploaded this one
+        this->scenePin.pin(path);
+        vtx::SceneMesh sceneMesh =
+            vtx::findSceneMesh(&this->scenePin, meshName, importFlags);
+        if (sceneMesh.mesh == nullptr) return;
+        const aiScene* scene   = sceneMesh.scene;
+        const aiMesh* mesh     = sceneMesh.mesh;
+        unsigned int meshIndex = sceneMesh.meshIndex;
 
         glm::mat4 globalTransform(1.0f);
-        const aiNode* node =
-            this->findNodeForMeshIndex(scene->mRootNode, meshIndex);
+        const aiNode* node = sceneMesh.node;
 
         // Traverse up the node hierarchy
         while (node != nullptr) {
@@ -539,64 +477,41 @@ struct MyMesh {
             }
         }
 
-        this->diffuseTextureId =
-            this->createTextureFromAssimp(scene, material);
-    }
-
-    void updateProjectionMatrix(const glm::mat4 projectionMatrix) const
-    {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_projection"
-            ),                                // uniform location
-            1,                                // number of matrices
-            GL_FALSE,                         // transpose
-            glm::value_ptr(projectionMatrix)  // value
+        this->takeSceneTexture(sceneMesh);
+
+        // init() uploads from here, and the next start from the file
+        cooked.vertices     = vertices.data();
+        cooked.vertexStride = sizeof(MyVertex);
+        cooked.vertexCount  = (uint32_t) vertices.size();
+        cooked.indices      = indices.data();
+        cooked.indexCount   = (uint32_t) indices.size();
+        memcpy(
+            cooked.transform, glm::value_ptr(this->initialTransform),
+            sizeof(cooked.transform)
         );
+        vtx::storeCookedMesh(cacheKey, &cooked);
     }
 
     void updateTransformationMatrix(const glm::mat4 transformationMatrix
     ) const
     {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_modelToWorld"
-            ),                                    // uniform location
-            1,                                    // number of matrices
-            GL_FALSE,                             // transpose
-            glm::value_ptr(transformationMatrix)  // value
-        );
+        this->defaultShader.set(this->modelToWorldUniform, transformationMatrix);
     }
 
-    void updateViewMatrix(const glm::mat4 viewMatrix) const
-    {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_worldToView"
-            ),                          // uniform location
-            1,                          // number of matrices
-            GL_FALSE,                   // transpose
-            glm::value_ptr(viewMatrix)  // value
-        );
-    }
     void draw() const
     {
+        VTX_PROFILE_GPU_SCOPE("MyMesh::draw");
+
         // Draw using default shader
-        glUseProgram(this->defaultShader);
-        glBindVertexArray(this->modelVAO);
-        glDrawElements(
+        this->defaultShader.use();
+        vtx::bindVertexArray(this->modelVAO);
+        vtx::drawElements(
             GL_TRIANGLES,     // Mode
-            indices.size(),   // Index count
+            indexCount,       // Index count
             GL_UNSIGNED_INT,  // Data type of indices array
             (void*) (0 * sizeof(unsigned int))  // Indices pointer
         );
-        glBindVertexArray(0);
+        vtx::bindVertexArray(0);
     }
 };
 // == MyModel impl ==
@@ -606,6 +521,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
 	precision mediump float;
 
@@ -620,9 +536,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
     out vec3 v_normal;
     out vec3 v_lightPos;
 
-    uniform mat4 u_worldToView;
     uniform mat4 u_modelToWorld;
-    uniform mat4 u_projection;
 
 	void main() {
         // Invert the model-to-world matrix to transform
@@ -638,7 +552,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
         v_crntPos     = vec3(u_modelToWorld * vec4(a_pos, 1.0f));
         v_lightPos    = vec3(u_worldToModel *  vec4(hardcodedLightPos, 1.0f));
 
-        gl_Position   = u_projection * u_worldToView * vec4(v_crntPos, 1.0f);
+        gl_Position   = u_viewProjection * vec4(v_crntPos, 1.0f);
 	}
 	)";
 
@@ -716,8 +630,12 @@ struct MyImGui {
 
     void renderFrame()
     {
+        VTX_PROFILE_GPU_SCOPE("MyImGui::renderFrame");
+
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        // ImGui sets its own GL state, so what we shadow is stale now
+        vtx::invalidateGLState();
     }
 
     void showMatrixEditor(glm::mat4* matrix, const char* title) const
@@ -767,6 +685,8 @@ typedef struct {
     Line redLine;
     Path spiralPath;
     Gizmo gizmo;
+    // Only changes when the window does
+    glm::mat4 projection;
 } UserContext;
 
 UserContext usr;
@@ -783,8 +703,22 @@ glm::mat4 cameraMatrix = glm::lookAt(
 
 glm::mat4 modelToWorld = glm::mat4(1.0f);  // Identity matrix
 
+glm::mat4 perspectiveFor(int screenWidth, int screenHeight)
+{
+    float fov       = glm::radians(45.0f);  // Field of view in radians
+    float nearPlane = 0.1f;    // Distance to the near clipping plane
+    float farPlane  = 100.0f;  // Distance to the far clipping plane
+    float aspectRatio = (float) screenWidth / (float) screenHeight;
+    return glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+}
+
 void vtx::init(vtx::VertexContext* ctx)
 {
+    // The meshes share one import of the file, freed once the last
+    // of them is uploaded
+    vtx::ScenePin textureTest;
+    textureTest.pin("./assets/texture-test.glb");
+
     usr.cubeTop.loadMesh(
         "./assets/texture-test.glb", "big-cube-mesh-0"
     );
@@ -794,28 +728,16 @@ void vtx::init(vtx::VertexContext* ctx)
         "./assets/texture-test.glb", "big-cube-mesh-1"
     );
     usr.cubeBody.init();
+    textureTest.release();
 
     usr.imgui.init(ctx);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_DEPTH_TEST);
-
-    // Figure projection matrix
-    float fov       = glm::radians(45.0f);  // Field of view in radians
-    float nearPlane = 0.1f;    // Distance to the near clipping plane
-    float farPlane  = 100.0f;  // Distance to the far clipping plane
-    // Actually, this needs to be recalculated in the loop,
-    // as window could be resized at any time by user
-    float aspectRatio =
-        (float) ctx->screenWidth / (float) ctx->screenHeight;
-
-    // But, here is the initials perspective matrix
-    glm::mat4 projectionMatrix =
-        glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+    vtx::enable(GL_BLEND);
+    vtx::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    vtx::enable(GL_DEPTH_TEST);
 
-    usr.cubeTop.updateProjectionMatrix(projectionMatrix);
-    usr.cubeBody.updateProjectionMatrix(projectionMatrix);
+    // Recalculated in the loop when the window is resized
+    usr.projection = perspectiveFor(ctx->screenWidth, ctx->screenHeight);
 
     usr.redLine.initLine();
 
@@ -837,42 +759,48 @@ void vtx::init(vtx::VertexContext* ctx)
     }
 
     usr.gizmo.init();
-    usr.gizmo.updateProjectionMatrix(projectionMatrix);
 }
 
 void vtx::loop(vtx::VertexContext* ctx)
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event) != 0) {
-        if (event.type == SDL_QUIT) {
-            vtx::exitVortex();
-            return;
-        }
-        if (event.type == SDL_WINDOWEVENT &&
-            event.window.event == SDL_WINDOWEVENT_RESIZED) {
-        }
-        if (event.type == SDL_KEYDOWN) {
-            if (event.key.keysym.sym == SDLK_ESCAPE) {
+    {
+        VTX_PROFILE_SCOPE("handleEvents");
+        for (SDL_Event& event : ctx->input.events) {
+            if (event.type == SDL_QUIT) {
                 vtx::exitVortex();
                 return;
             }
-        }
+            if (event.type == SDL_WINDOWEVENT &&
+                event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                ctx->screenWidth  = event.window.data1;
+                ctx->screenHeight = event.window.data2;
+                usr.projection =
+                    perspectiveFor(ctx->screenWidth, ctx->screenHeight);
+            }
+            if (event.type == SDL_KEYDOWN) {
+                if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    vtx::exitVortex();
+                    return;
+                }
+            }
 
-        usr.imgui.processEvent(&event);
+            usr.imgui.processEvent(&event);
+        }
     }
 
     glClearColor(0.1f, 0.4f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    static Uint32 lastTime = 0;
-    Uint32 currentTime     = SDL_GetTicks();
-    float deltaTime        = (currentTime - lastTime) / 1000.0f;
-    lastTime               = currentTime;
+    // Camera and projection for every shader at once
+    vtx::writeFrameConstants(
+        cameraMatrix, usr.projection, ctx->frameTime, ctx->deltaTime,
+        ctx->screenWidth, ctx->screenHeight
+    );
 
     float rotationSpeed =
         glm::radians(45.0f);  // Rotation speed in radians per second
-    float angle = rotationSpeed * SDL_GetTicks() /
-                  1000.0f;  // Total angle based on elapsed time
+    float angle =
+        rotationSpeed * ctx->frameTime;  // Total angle based on elapsed time
 
     modelToWorld = glm::mat4(1.0f);  // Start with an identity matrix
     modelToWorld =
@@ -881,20 +809,16 @@ void vtx::loop(vtx::VertexContext* ctx)
     usr.cubeTop.updateTransformationMatrix(
         usr.cubeTop.initialTransform * modelToWorld
     );
-    usr.cubeTop.updateViewMatrix(cameraMatrix);
     usr.cubeTop.updateDiffuseTexture(usr.cubeTop.diffuseTextureId);
     usr.cubeTop.draw();
 
     usr.cubeBody.updateTransformationMatrix(
         usr.cubeBody.initialTransform * modelToWorld
     );
-    usr.cubeBody.updateViewMatrix(cameraMatrix);
     usr.cubeBody.updateDiffuseTexture(usr.cubeBody.diffuseTextureId
     );  // ok it is time to exract shader
     usr.cubeBody.draw();
 
-    usr.gizmo.updateViewMatrix(cameraMatrix);
-    
     // THIS IS ALSO IMPORTANT FOR THIS EXAMPLE
     // TODO make it run too, but it kind of dublicates the visual impact of the next 
     // code block
@@ -918,32 +842,18 @@ void vtx::loop(vtx::VertexContext* ctx)
             usr.gizmo.draw();
     }
 
-    // Figure projection matrix
-    float fov       = glm::radians(45.0f);  // Field of view in radians
-    float nearPlane = 0.1f;    // Distance to the near clipping plane
-    float farPlane  = 100.0f;  // Distance to the far clipping plane
-    // Actually, this needs to be recalculated in the loop,
-    // as window could be resized at any time by user
-    float aspectRatio =
-        (float) ctx->screenWidth / (float) ctx->screenHeight;
-
-    // But, here is the initials perspective matrix
-    glm::mat4 projectionMatrix =
-        glm::perspective(fov, aspectRatio, nearPlane, farPlane);
-    usr.redLine.renderTheLines(
-        cameraMatrix,
-        projectionMatrix,
-        glm::mat4(1.0f)
-    );
+    usr.redLine.renderTheLines(glm::mat4(1.0f));
     usr.imgui.newFrame();
     usr.imgui.showMatrixEditor(
         &modelToWorld, "Model-to-World for mesh"
     );
     usr.imgui.showMatrixEditor(&cameraMatrix, "Camera matrix");
+    vtx::showProfilerPanel();
+    vtx::showGpuMemoryPanel();
     usr.imgui.renderFrame();
 
     checkOpenGLError();
-    SDL_GL_SwapWindow(ctx->sdlWindow);
+    vtx::swapWindow(ctx);
 }
 
 int main(int argc, char* argv[]) { vtx::openVortex(); }
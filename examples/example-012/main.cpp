@@ -17,7 +17,12 @@
 #include <vector>
 
 #include "../../src/vtx/ctx.h"
+#include "../../src/vtx/shader-program.h"
 #include "../../src/vtx/gizmo.h"
+#include "../../src/vtx/gpu-memory-panel.h"
+#include "../../src/vtx/mesh-cache.h"
+#include "../../src/vtx/profiler-panel.h"
+#include "../../src/vtx/scene-cache.h"
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
 #include "imgui_impl_sdl2.h"
@@ -36,11 +41,13 @@ struct Confetti {
 
     static const int NUM_PARTICLES = 200;
 
-    GLuint confettiShaderId;
+    vtx::ShaderProgram confettiShaderId;
+    vtx::UniformHandle modelToWorldUniform = "u_modelToWorld";
+    vtx::UniformHandle timeUniform         = "u_time";
     std::vector<ConfettiParticle> particleVertices;
     float time;
     GLuint confettiVAO;
-    GLuint confettiVBO;
+    vtx::GpuBuffer confettiVBO;
 
     private: void regenerateParticleVertices() {
         this->particleVertices.clear();
@@ -95,27 +102,25 @@ struct Confetti {
         // Set time to a point where it needs to regenerate
         this->time = 3.0f;
 
-        this->confettiShaderId = vtx::createShaderProgram(
-            CONFETTI_VERTEX_SHADER, CONFETTI_FRAGMENT_SHADER
+        this->confettiShaderId.create(
+            CONFETTI_VERTEX_SHADER, CONFETTI_FRAGMENT_SHADER, "confetti"
         );
 
         // Create and bind the VBO
         glGenVertexArrays(1, &this->confettiVAO);
-        glBindVertexArray(this->confettiVAO);
+        vtx::bindVertexArray(this->confettiVAO);
 
-        // GLuint confettiVBO;
-        glGenBuffers(1, &confettiVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, confettiVBO);
         // glBufferData(
         //     GL_ARRAY_BUFFER,
         //     sizeof(ConfettiParticle) * particleVertices.size(),
         //     particleVertices.data(), GL_STATIC_DRAW
         // );
-        glBufferData(
+        this->confettiVBO.create(
             GL_ARRAY_BUFFER,
             sizeof(ConfettiParticle) * particleVertices.size(),
             nullptr,
-            GL_DYNAMIC_DRAW // Could be also static, and regeneration will not happen on every frame
+            GL_DYNAMIC_DRAW, // Could be also static, and regeneration will not happen on every frame
+            "confetti"
         );
         // TODO figure what is the difference between these static and
         // dynamic and how to use the dynamic
@@ -134,9 +139,9 @@ struct Confetti {
         glEnableVertexAttribArray(3);
 
         // Unbind
-        glBindVertexArray(0);                      // VAO
-        glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+        vtx::bindVertexArray(0);                      // VAO
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+        vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
     }
     void resetParticles() {
         std::cerr << "Resetting particles" << std::endl;
@@ -144,72 +149,50 @@ struct Confetti {
         this->regenerateParticleVertices();
 
         // Bind the VAO and VBO
-        glBindVertexArray(this->confettiVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, confettiVBO);
+        vtx::bindVertexArray(this->confettiVAO);
+        vtx::bindBuffer(GL_ARRAY_BUFFER, confettiVBO.id);
 
-        // Update the buffer with new particle data
-        glBufferSubData(
+        // Update the buffer with new particle data. The particles are
+        // drawn again every frame, so they cannot go into the stream
+        // buffer, but a new store (orphaning) spares waiting for the
+        // frames still drawing the old ones.
+        glBufferData(
             GL_ARRAY_BUFFER,
-            0,  // Start at the beginning of the buffer
             sizeof(ConfettiParticle) * particleVertices.size(),
-            particleVertices.data()  // Pointer to the new data
+            particleVertices.data(),  // Pointer to the new data
+            GL_DYNAMIC_DRAW
         );
 
         // Unbind the buffer after updating
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0);
+        vtx::bindVertexArray(0);
     }
 
+    // Particles are moved by time only, so simulation is a clock tick
+    void advance(float deltaTime) { this->time += deltaTime; }
+
     void drawParticles(
-        float deltaTime,
-        const glm::mat4 viewMatrix,
-        const glm::mat4 projectionMatrix,
+        float renderTime,
         const glm::mat4 transformationMatrix
     )
     {
-        glUseProgram(this->confettiShaderId);
-        glBindVertexArray(this->confettiVAO);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->confettiShaderId, "u_worldToView"
-            ),                          // uniform location
-            1,                          // number of matrices
-            GL_FALSE,                   // transpose
-            glm::value_ptr(viewMatrix)  // value
-        );
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->confettiShaderId, "u_projection"
-            ),                                // uniform location
-            1,                                // number of matrices
-            GL_FALSE,                         // transpose
-            glm::value_ptr(projectionMatrix)  // value
-        );
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->confettiShaderId, "u_modelToWorld"
-            ),                                    // uniform location
-            1,                                    // number of matrices
-            GL_FALSE,                             // transpose
-            glm::value_ptr(transformationMatrix)  // value
+        this->confettiShaderId.set(
+            this->modelToWorldUniform, transformationMatrix
         );
 
-        this->time += deltaTime;
         // Load uniform time variable
-        glUniform1f(
-            glGetUniformLocation(this->confettiShaderId, "u_time"),
-            this->time
-        );
+        this->confettiShaderId.set(this->timeUniform, renderTime);
+
+        this->confettiShaderId.use();
+        vtx::bindVertexArray(this->confettiVAO);
 
-        glDrawArrays(
+        vtx::drawArrays(
             GL_TRIANGLES,  // Mode
             0,             // Start from
             this->particleVertices.size()
         );
 
-        glBindVertexArray(0);
+        vtx::bindVertexArray(0);
     }
 };
 
@@ -219,13 +202,12 @@ const char* Confetti::CONFETTI_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
     precision mediump float;
 
     uniform float u_time;
     uniform mat4 u_modelToWorld;
-    uniform mat4 u_worldToView;  // World to View matrix
-    uniform mat4 u_projection;   // Projection matrix
 
     layout(location = 0) in vec3  a_position;
     layout(location = 1) in vec3  a_velocity;          
@@ -241,7 +223,7 @@ const char* Confetti::CONFETTI_VERTEX_SHADER =
         
         v_color = a_color;
         vec3 crntPos = vec3(u_modelToWorld * vec4(movedPos, 1.0f));
-        gl_Position  = u_projection * u_worldToView * vec4(crntPos, 1.0f);
+        gl_Position  = u_viewProjection * vec4(crntPos, 1.0f);
 
     }
     )";
@@ -287,39 +269,45 @@ struct MyMesh {
     std::vector<MyVertex> vertices;
     std::vector<unsigned int> indices;
     GLuint modelVAO;
-    GLuint defaultShader;
-    uint diffuseTextureId;
+    vtx::GpuBuffer vertexBuffer, indexBuffer;
+    std::string name;  // names its GPU memory
+    vtx::ShaderProgram defaultShader;
+    vtx::UniformHandle modelToWorldUniform   = "u_modelToWorld";
+    vtx::UniformHandle diffuseTextureUniform = "u_diffuseTexture";
+    uint diffuseTextureId = 0;
+    vtx::GpuTexture diffuseTexture;
+    // What init() uploads, mapped from the mesh cache or made by the
+    // import
+    vtx::CookedMesh cooked = {};
+    vtx::ScenePin scenePin;  // the shared import, until uploaded
+    GLsizei indexCount = 0;
     glm::mat4 initialTransform;
 
     void init()
     {
         // Create VAO
         glGenVertexArrays(1, &modelVAO);
-        glBindVertexArray(modelVAO);
+        vtx::bindVertexArray(modelVAO);
 
-        // Create VBO with vertices
-        GLuint VBO;
-        glGenBuffers(1, &VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(
+        // Create VBO with vertices, on warm starts straight from the
+        // mapped cooked file
+        this->vertexBuffer.create(
             GL_ARRAY_BUFFER,
-            vertices.size() *
-                sizeof(MyVertex),  // all vertices in bytes
-            vertices.data(), GL_STATIC_DRAW
+            (size_t) cooked.vertexCount *
+                cooked.vertexStride,  // all vertices in bytes
+            cooked.vertices, GL_STATIC_DRAW, this->name.c_str()
         );
 
         // Create EBO with indexes
-        GLuint EBO;
-        glGenBuffers(1, &EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(
+        this->indexBuffer.create(
             GL_ELEMENT_ARRAY_BUFFER,  // This is used for EBO
-            indices.size() * sizeof(unsigned int), indices.data(),
-            GL_STATIC_DRAW
+            cooked.indexCount * sizeof(unsigned int), cooked.indices,
+            GL_STATIC_DRAW, this->name.c_str()
         );
+        this->indexCount = (GLsizei) cooked.indexCount;
 
         // Links VBO attributes such as coordinates and colors to VAO
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        vtx::bindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer.id);
 
         // clang-format off
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MyVertex), (void*) offsetof(MyVertex, position));
@@ -334,127 +322,67 @@ struct MyMesh {
         glEnableVertexAttribArray(3);
 
         // Unbind all to prevent accidentally modifying them
-        glBindVertexArray(0);                      // VAO
-        glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+        vtx::bindVertexArray(0);                      // VAO
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+        vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+
+        if (cooked.texels != nullptr) createDiffuseTexture();
 
-        defaultShader = vtx::createShaderProgram(
-            MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER
+        // Uploaded, neither the mapping nor the import is needed
+        vtx::releaseCookedMesh(&cooked);
+        this->scenePin.release();
+
+        defaultShader.create(
+            MODEL_VERTEX_SHADER, MODEL_FRAGMENT_SHADER, "model"
         );
     }
-    uint
-    createTextureFromAssimp(const aiScene* scene, aiMaterial* material)
+    // The embedded diffuse texture, decoded once for the whole file,
+    // init() uploads it
+    void takeSceneTexture(const vtx::SceneMesh& sceneMesh)
     {
-        aiString texturePath;
-
-        if (material->GetTexture(
-                aiTextureType_DIFFUSE, 0, &texturePath
-            ) == AI_SUCCESS) {
-            const aiTexture* texture =
-                scene->GetEmbeddedTexture(texturePath.C_Str());
-
-            if (texture) {
-                unsigned char* data = nullptr;
-
-                int width, height, channels;
-                unsigned char* imageData = stbi_load_from_memory(
-                    reinterpret_cast<unsigned char*>(texture->pcData),
-                    texture->mWidth,  // mWidth holds the length of the
-                                      // compressed data buffer
-                    &width, &height, &channels, 0
-                );
-
-                uint glChan;
-                if (channels == 3) {
-                    glChan = GL_RGB;
-                } else if (channels == 4) {
-                    glChan = GL_RGBA;
-                } else {
-                    return 0;
-                }
-
-                if (imageData) {
-                    // Successfully loaded image; you can now use
-                    // imageData, width, height, and channels For
-                    // example, generate an OpenGL texture:
-                    GLuint textureID;
-                    glGenTextures(1, &textureID);
-                    glBindTexture(GL_TEXTURE_2D, textureID);
-                    glTexImage2D(
-                        GL_TEXTURE_2D, 0, glChan, width, height, 0,
-                        glChan, GL_UNSIGNED_BYTE, imageData
-                    );
-
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST
-                    );
-                    glTexParameterf(
-                        GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT
-                    );
-                    glTexParameteri(
-                        GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT
-                    );
-
-                    glGenerateMipmap(GL_TEXTURE_2D);
-
-                    // Unbind to make suree something else does not
-                    // interfere
-                    glBindTexture(GL_TEXTURE_2D, 0);
-
-                    // Free stb_image data after generating texture
-                    stbi_image_free(imageData);
-                    return textureID;
-                } else {
-                }
-            }
-        }
-        return 0;
+        const vtx::SceneTexture* texture =
+            vtx::sceneDiffuseTexture(&this->scenePin, sceneMesh);
+        if (texture == nullptr) return;
+
+        cooked.texels        = texture->texels;
+        cooked.textureWidth  = texture->width;
+        cooked.textureHeight = texture->height;
+        cooked.textureFormat =
+            texture->channels == 4 ? GL_RGBA : GL_RGB;
     }
 
-    void updateDiffuseTexture(uint diffuseTexture)
+    void createDiffuseTexture()
     {
-        glUseProgram(this->defaultShader);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseTexture);
+        this->diffuseTexture.create2D(
+            cooked.textureWidth, cooked.textureHeight,
+            cooked.textureFormat, cooked.textureFormat,
+            GL_UNSIGNED_BYTE, cooked.texels, true, this->name.c_str()
+        );
 
-        glUniform1i(
-            glGetUniformLocation(
-                this->defaultShader, "u_diffuseTexture"
-            ),
-            0
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST
         );
-        checkOpenGLError();
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST
+        );
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        // Unbind to make suree something else does not interfere
+        vtx::bindTexture(GL_TEXTURE_2D, 0);
+        this->diffuseTextureId = this->diffuseTexture.id;
     }
 
-    // Recursive function to find the node containing the mesh index
-    const aiNode*
-    findNodeForMeshIndex(const aiNode* node, unsigned int meshIndex)
+    void updateDiffuseTexture(uint diffuseTexture)
     {
-        // Check if this node references the mesh index
-        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-            if (node->mMeshes[i] == meshIndex) {
-                return node;  // Found the node
-            }
-        }
+        vtx::activeTexture(GL_TEXTURE0);
+        vtx::bindTexture(GL_TEXTURE_2D, diffuseTexture);
 
-        // Recursively search child nodes
-        for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            const aiNode* foundNode =
-                findNodeForMeshIndex(node->mChildren[i], meshIndex);
-            if (foundNode) {
-                return foundNode;
-            }
-        }
-
-        return nullptr;  // Node not found
+        this->defaultShader.set(this->diffuseTextureUniform, 0);
+        checkOpenGLError();
     }
+
     inline glm::mat4 assimpToGlmMatrix(aiMatrix4x4 mat)
     {
         glm::mat4 m;
@@ -467,46 +395,34 @@ struct MyMesh {
     }
     void loadMesh(const char* path, const char* meshName)
     {
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(
-            path,  // path of the file
-            aiProcess_Triangulate | aiProcess_FlipUVs |
-                // aiProcess_GenNormals |
-                aiProcess_CalcTangentSpace
+        this->name               = meshName;
+        unsigned int importFlags = aiProcess_Triangulate |
+                                   aiProcess_FlipUVs |
+                                   // aiProcess_GenNormals |
+                                   aiProcess_CalcTangentSpace;
+
+        // A cooked copy from an earlier start skips Assimp and
+        // stb_image altogether
+        uint64_t cacheKey = vtx::meshCacheKey(
+            path, meshName, importFlags, sizeof(MyVertex)
         );
-
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-            !scene->mRootNode) {
+        if (vtx::loadCookedMesh(cacheKey, &this->cooked)) {
+            this->initialTransform = glm::make_mat4(cooked.transform);
             return;
         }
 
-        aiMesh* mesh           = nullptr;
-        unsigned int meshIndex = 0;
-        // Iterate through all the meshes in the scene
-        for (meshIndex = 0; meshIndex < scene->mNumMeshes;
-             meshIndex++) {
-            mesh = scene->mMeshes[meshIndex];
-
-            // Print the name of the mesh
-            if (mesh->mName.length > 0) {
-                std::cout << "Mesh Name: " << mesh->mName.C_Str()
-                          << std::endl;
-                const char* currentMeshName = mesh->mName.C_Str();
-                if (strcmp(currentMeshName, meshName) == 0) {
-                    std::cout << "Found matching mesh: " << meshName
-                              << std::endl;
-                    break;  // Exit the loop
-                }
-            }
-        }
-        if (mesh == nullptr) {
-            std::cerr << "Error loading mesh: " << meshName
-                      << std::endl;  // Fallback name
-        }
+        // The meshes of one file share its import, pinned until
+        // init() has uploaded this one
+        this->scenePin.pin(path);
+        vtx::SceneMesh sceneMesh =
+            vtx::findSceneMesh(&this->scenePin, meshName, importFlags);
+        if (sceneMesh.mesh == nullptr) return;
+        const aiScene* scene   = sceneMesh.scene;
+        const aiMesh* mesh     = sceneMesh.mesh;
+        unsigned int meshIndex = sceneMesh.meshIndex;
 
         glm::mat4 globalTransform(1.0f);
-        const aiNode* node =
-            this->findNodeForMeshIndex(scene->mRootNode, meshIndex);
+        const aiNode* node = sceneMesh.node;
 
         // Traverse up the node hierarchy
         while (node != nullptr) {
@@ -579,64 +495,41 @@ struct MyMesh {
             }
         }
 
-        this->diffuseTextureId =
-            this->createTextureFromAssimp(scene, material);
-    }
-
-    void updateProjectionMatrix(const glm::mat4 projectionMatrix) const
-    {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_projection"
-            ),                                // uniform location
-            1,                                // number of matrices
-            GL_FALSE,                         // transpose
-            glm::value_ptr(projectionMatrix)  // value
+        this->takeSceneTexture(sceneMesh);
+
+        // init() uploads from here, and the next start from the file
+        cooked.vertices     = vertices.data();
+        cooked.vertexStride = sizeof(MyVertex);
+        cooked.vertexCount  = (uint32_t) vertices.size();
+        cooked.indices      = indices.data();
+        cooked.indexCount   = (uint32_t) indices.size();
+        memcpy(
+            cooked.transform, glm::value_ptr(this->initialTransform),
+            sizeof(cooked.transform)
         );
+        vtx::storeCookedMesh(cacheKey, &cooked);
     }
 
     void updateTransformationMatrix(const glm::mat4 transformationMatrix
     ) const
     {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_modelToWorld"
-            ),                                    // uniform location
-            1,                                    // number of matrices
-            GL_FALSE,                             // transpose
-            glm::value_ptr(transformationMatrix)  // value
-        );
+        this->defaultShader.set(this->modelToWorldUniform, transformationMatrix);
     }
 
-    void updateViewMatrix(const glm::mat4 viewMatrix) const
-    {
-        glUseProgram(this->defaultShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->defaultShader, "u_worldToView"
-            ),                          // uniform location
-            1,                          // number of matrices
-            GL_FALSE,                   // transpose
-            glm::value_ptr(viewMatrix)  // value
-        );
-    }
     void draw() const
     {
+        VTX_PROFILE_GPU_SCOPE("MyMesh::draw");
+
         // Draw using default shader
-        glUseProgram(this->defaultShader);
-        glBindVertexArray(this->modelVAO);
-        glDrawElements(
+        this->defaultShader.use();
+        vtx::bindVertexArray(this->modelVAO);
+        vtx::drawElements(
             GL_TRIANGLES,     // Mode
-            indices.size(),   // Index count
+            indexCount,       // Index count
             GL_UNSIGNED_INT,  // Data type of indices array
             (void*) (0 * sizeof(unsigned int))  // Indices pointer
         );
-        glBindVertexArray(0);
+        vtx::bindVertexArray(0);
     }
 };
 // == MyModel impl ==
@@ -646,6 +539,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
 	precision mediump float;
 
@@ -660,9 +554,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
     out vec3 v_normal;
     out vec3 v_lightPos;
 
-    uniform mat4 u_worldToView;
     uniform mat4 u_modelToWorld;
-    uniform mat4 u_projection;
 
 	void main() {
         // Invert the model-to-world matrix to transform
@@ -678,7 +570,7 @@ const char* MyMesh::MODEL_VERTEX_SHADER =
         v_crntPos     = vec3(u_modelToWorld * vec4(a_pos, 1.0f));
         v_lightPos    = vec3(u_worldToModel *  vec4(hardcodedLightPos, 1.0f));
 
-        gl_Position   = u_projection * u_worldToView * vec4(v_crntPos, 1.0f);
+        gl_Position   = u_viewProjection * vec4(v_crntPos, 1.0f);
 	}
 	)";
 
@@ -756,8 +648,12 @@ struct MyImGui {
 
     void renderFrame()
     {
+        VTX_PROFILE_GPU_SCOPE("MyImGui::renderFrame");
+
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        // ImGui sets its own GL state, so what we shadow is stale now
+        vtx::invalidateGLState();
     }
 
     void showMatrixEditor(glm::mat4* matrix, const char* title) const
@@ -819,6 +715,13 @@ typedef struct {
     MyImGui imgui;
     Gizmo gizmo;
     Confetti confetti;
+
+    // Only changes when the window does
+    glm::mat4 projection;
+
+    // Simulation state, advanced by simulate() in fixed steps
+    float previousAngle;
+    float currentAngle;
 } UserContext;
 
 UserContext usr;
@@ -835,8 +738,24 @@ glm::mat4 cameraMatrix = glm::lookAt(
 
 glm::mat4 modelToWorld = glm::mat4(1.0f);  // Identity matrix
 
+void simulate(vtx::VertexContext* ctx, double stepSeconds);
+
+glm::mat4 perspectiveFor(int screenWidth, int screenHeight)
+{
+    float fov       = glm::radians(45.0f);  // Field of view in radians
+    float nearPlane = 0.1f;    // Distance to the near clipping plane
+    float farPlane  = 100.0f;  // Distance to the far clipping plane
+    float aspectRatio = (float) screenWidth / (float) screenHeight;
+    return glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+}
+
 void vtx::init(vtx::VertexContext* ctx)
 {
+    // The meshes share one import of the file, freed once the last
+    // of them is uploaded
+    vtx::ScenePin textureTest;
+    textureTest.pin("./assets/texture-test.glb");
+
     usr.cubeTop.loadMesh(
         "./assets/texture-test.glb", "big-cube-mesh-0"
     );
@@ -846,67 +765,73 @@ void vtx::init(vtx::VertexContext* ctx)
         "./assets/texture-test.glb", "big-cube-mesh-1"
     );
     usr.cubeBody.init();
+    textureTest.release();
 
     usr.imgui.init(ctx);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_DEPTH_TEST);
-
-    // Figure projection matrix
-    float fov       = glm::radians(45.0f);  // Field of view in radians
-    float nearPlane = 0.1f;    // Distance to the near clipping plane
-    float farPlane  = 100.0f;  // Distance to the far clipping plane
-    // Actually, this needs to be recalculated in the loop,
-    // as window could be resized at any time by user
-    float aspectRatio =
-        (float) ctx->screenWidth / (float) ctx->screenHeight;
-
-    // But, here is the initials perspective matrix
-    glm::mat4 projectionMatrix =
-        glm::perspective(fov, aspectRatio, nearPlane, farPlane);
+    vtx::enable(GL_BLEND);
+    vtx::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    vtx::enable(GL_DEPTH_TEST);
 
-    usr.cubeTop.updateProjectionMatrix(projectionMatrix);
-    usr.cubeBody.updateProjectionMatrix(projectionMatrix);
+    // Recalculated in the loop when the window is resized
+    usr.projection = perspectiveFor(ctx->screenWidth, ctx->screenHeight);
 
     usr.gizmo.init();
-    usr.gizmo.updateProjectionMatrix(projectionMatrix);
     usr.confetti.initConfetti();
+
+    vtx::setFixedTimestep(ctx, 1.0 / 60.0, 5, simulate);
+}
+
+void simulate(vtx::VertexContext* ctx, double stepSeconds)
+{
+    float rotationSpeed =
+        glm::radians(45.0f);  // Rotation speed in radians per second
+
+    usr.previousAngle = usr.currentAngle;
+    usr.currentAngle += rotationSpeed * (float) stepSeconds;
+
+    usr.confetti.advance((float) stepSeconds);
 }
 
 void vtx::loop(vtx::VertexContext* ctx)
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event) != 0) {
-        if (event.type == SDL_QUIT) {
-            vtx::exitVortex();
-            return;
-        }
-        if (event.type == SDL_WINDOWEVENT &&
-            event.window.event == SDL_WINDOWEVENT_RESIZED) {
-        }
-        if (event.type == SDL_KEYDOWN) {
-            if (event.key.keysym.sym == SDLK_ESCAPE) {
+    {
+        VTX_PROFILE_SCOPE("handleEvents");
+        for (SDL_Event& event : ctx->input.events) {
+            if (event.type == SDL_QUIT) {
                 vtx::exitVortex();
                 return;
             }
-        }
+            if (event.type == SDL_WINDOWEVENT &&
+                event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                ctx->screenWidth  = event.window.data1;
+                ctx->screenHeight = event.window.data2;
+                usr.projection =
+                    perspectiveFor(ctx->screenWidth, ctx->screenHeight);
+            }
+            if (event.type == SDL_KEYDOWN) {
+                if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    vtx::exitVortex();
+                    return;
+                }
+            }
 
-        usr.imgui.processEvent(&event);
+            usr.imgui.processEvent(&event);
+        }
     }
 
     glClearColor(0.1f, 0.4f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    static Uint32 lastTime = 0;
-    Uint32 currentTime     = SDL_GetTicks();
-    float deltaTime        = (currentTime - lastTime) / 1000.0f;
-    lastTime               = currentTime;
+    // Camera and projection for every shader at once
+    vtx::writeFrameConstants(
+        cameraMatrix, usr.projection, ctx->frameTime, ctx->deltaTime,
+        ctx->screenWidth, ctx->screenHeight
+    );
 
-    float rotationSpeed =
-        glm::radians(45.0f);  // Rotation speed in radians per second
-    float angle = rotationSpeed * SDL_GetTicks() /
-                  1000.0f;  // Total angle based on elapsed time
+    // Render in between of the last two simulation steps
+    float angle =
+        glm::mix(usr.previousAngle, usr.currentAngle, ctx->alpha);
 
     modelToWorld = glm::mat4(1.0f);  // Start with an identity matrix
     modelToWorld =
@@ -915,46 +840,34 @@ void vtx::loop(vtx::VertexContext* ctx)
     usr.cubeTop.updateTransformationMatrix(
         usr.cubeTop.initialTransform * modelToWorld
     );
-    usr.cubeTop.updateViewMatrix(cameraMatrix);
     usr.cubeTop.updateDiffuseTexture(usr.cubeTop.diffuseTextureId);
     usr.cubeTop.draw();
 
     usr.cubeBody.updateTransformationMatrix(
         usr.cubeBody.initialTransform * modelToWorld
     );
-    usr.cubeBody.updateViewMatrix(cameraMatrix);
     usr.cubeBody.updateDiffuseTexture(usr.cubeBody.diffuseTextureId
     );  // ok it is time to exract shader
     usr.cubeBody.draw();
 
-    usr.gizmo.updateViewMatrix(cameraMatrix);
-    float fov       = glm::radians(45.0f);  // Field of view in radians
-    float nearPlane = 0.1f;    // Distance to the near clipping plane
-    float farPlane  = 100.0f;  // Distance to the far clipping plane
-    // Actually, this needs to be recalculated in the loop,
-    // as window could be resized at any time by user
-    float aspectRatio =
-        (float) ctx->screenWidth / (float) ctx->screenHeight;
-
-    // But, here is the initials perspective matrix
-    glm::mat4 projectionMatrix =
-        glm::perspective(fov, aspectRatio, nearPlane, farPlane);
-
-    usr.confetti.drawParticles(
-        deltaTime, cameraMatrix, projectionMatrix, glm::mat4(1.0)
-    );
+    // Confetti time is one step ahead of what should be on screen
+    float confettiTime =
+        usr.confetti.time - (1.0f - ctx->alpha) * (float) ctx->fixedStep;
+    usr.confetti.drawParticles(confettiTime, glm::mat4(1.0));
 
     usr.imgui.newFrame();
     usr.imgui.showMatrixEditor(
         &modelToWorld, "Model-to-World for mesh"
     );
     usr.imgui.showMatrixEditor(&cameraMatrix, "Camera matrix");
+    vtx::showProfilerPanel();
+    vtx::showGpuMemoryPanel();
     usr.imgui.showParticleControls(usr.confetti);
 
     usr.imgui.renderFrame();
 
     checkOpenGLError();
-    SDL_GL_SwapWindow(ctx->sdlWindow);
+    vtx::swapWindow(ctx);
 }
 
 int main(int argc, char* argv[]) { vtx::openVortex(); }
@@ -0,0 +1,139 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../../src/vtx/jobs.h"
+
+#define EMPTY_JOBS (1000000)
+#define EMPTY_JOB_BATCH (1024)  // stays well below VTX_JOB_DEQUE_SIZE
+#define ROUND_TRIPS (100000)
+#define ELEMENTS (1 << 20)
+#define REPEATS (20)
+
+static double nowMs()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(
+               steady_clock::now().time_since_epoch()
+    )
+        .count();
+}
+
+static void emptyJob(void* data, int begin, int end)
+{
+    (void) data, (void) begin, (void) end;
+}
+
+// Enough work per element that the loop is not just memory bandwidth
+static void work(float* values, int begin, int end)
+{
+    for (int i = begin; i < end; i++) {
+        float v = values[i];
+        for (int k = 0; k < 16; k++) v = sqrtf(v * v + 1.0f);
+        values[i] = v;
+    }
+}
+
+static void measureEmptyJobs()
+{
+    double start = nowMs();
+    for (int queued = 0; queued < EMPTY_JOBS;
+         queued += EMPTY_JOB_BATCH) {
+        vtx::JobCounter counter;
+        for (int i = 0; i < EMPTY_JOB_BATCH; i++) {
+            vtx::runJob(&jobSystem, &counter, emptyJob, nullptr);
+        }
+        vtx::waitForCounter(&jobSystem, &counter);
+    }
+    double ms = nowMs() - start;
+    printf("empty job:      %8.1f ns each\n", ms * 1e6 / EMPTY_JOBS);
+}
+
+static void measureRoundTrip()
+{
+    double start = nowMs();
+    for (int i = 0; i < ROUND_TRIPS; i++) {
+        vtx::JobCounter counter;
+        vtx::runJob(&jobSystem, &counter, emptyJob, nullptr);
+        vtx::waitForCounter(&jobSystem, &counter);
+    }
+    double ms = nowMs() - start;
+    printf("round trip:     %8.1f ns each\n", ms * 1e6 / ROUND_TRIPS);
+}
+
+static void measureParallelFor()
+{
+    std::vector<float> values(ELEMENTS, 1.0f);
+
+    double start = nowMs();
+    for (int r = 0; r < REPEATS; r++) work(values.data(), 0, ELEMENTS);
+    double serialMs = (nowMs() - start) / REPEATS;
+    printf("serial loop:    %8.3f ms\n", serialMs);
+
+    const int grains[] = {64, 1024, 16384, 262144};
+    for (int grain : grains) {
+        start = nowMs();
+        for (int r = 0; r < REPEATS; r++) {
+            vtx::parallelFor(
+                &jobSystem, ELEMENTS, grain,
+                [&](int begin, int end) {
+                    work(values.data(), begin, end);
+                }
+            );
+        }
+        double ms = (nowMs() - start) / REPEATS;
+        printf(
+            "grain %6d:   %8.3f ms, %.2fx\n", grain, ms, serialMs / ms
+        );
+    }
+}
+
+// Elements not visited exactly once. More chunks than the deque holds
+// take the inline fallback, which must not lose nor repeat any.
+static int countWrongElements(int count, int grain)
+{
+    std::vector<std::atomic<int>> visits(count);
+    vtx::parallelFor(&jobSystem, count, grain, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) visits[i]++;
+    });
+
+    int wrong = 0;
+    for (int i = 0; i < count; i++) wrong += visits[i] != 1;
+    return wrong;
+}
+
+static bool checkParallelFor()
+{
+    const int cases[][2] = {
+        {5000, 1}, {ELEMENTS, 64}, {ELEMENTS, 1024}, {ELEMENTS, 262144}
+    };
+    bool correct = true;
+    for (const auto& [count, grain] : cases) {
+        int wrong = countWrongElements(count, grain);
+        if (wrong > 0) {
+            printf(
+                "parallelFor %d by %d: %d elements wrong\n", count,
+                grain, wrong
+            );
+            correct = false;
+        }
+    }
+    return correct;
+}
+
+int main()
+{
+    int workers = vtx::defaultJobWorkerCount();
+    vtx::startJobSystem(&jobSystem, workers);
+    printf("%d workers and the main thread\n", workers);
+
+    bool correct = checkParallelFor();
+    measureEmptyJobs();
+    measureRoundTrip();
+    measureParallelFor();
+
+    vtx::stopJobSystem(&jobSystem);
+    return correct ? 0 : 1;
+}
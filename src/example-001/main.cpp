@@ -77,8 +77,7 @@ void vtx::init(vtx::VertexContext* ctx)
 void vtx::loop(vtx::VertexContext* ctx)
 {
 #ifdef __USE_SDL
-    SDL_Event event;
-    while (SDL_PollEvent(&event) != 0) {
+    for (SDL_Event& event : ctx->input.events) {
         if (event.type == SDL_QUIT) {
             exitVortex();
             return;
@@ -111,15 +110,7 @@ void vtx::loop(vtx::VertexContext* ctx)
 
     checkOpenGLError();
 
-#ifdef __USE_GLFW
-    glfwPollEvents();
-#endif
-
-#ifdef __USE_SDL
-    SDL_GL_SwapWindow(ctx->sdlWindow);
-#elif defined(__USE_GLFW)
-    glfwSwapBuffers(ctx->glfwWindow);
-#endif
+    vtx::swapWindow(ctx);
 }
 
 int main(int argc, char* argv[]) { vtx::openVortex(); }
\ No newline at end of file
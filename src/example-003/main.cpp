@@ -197,8 +197,7 @@ void vtx::init(vtx::VertexContext* ctx)
 
 void vtx::loop(vtx::VertexContext* ctx)
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event) != 0) {
+    for (SDL_Event& event : ctx->input.events) {
         if (event.type == SDL_QUIT) {
             vtx::exitVortex();
             return;
@@ -255,7 +254,7 @@ void vtx::loop(vtx::VertexContext* ctx)
 
     checkOpenGLError();
 
-    SDL_GL_SwapWindow(ctx->sdlWindow);
+    vtx::swapWindow(ctx);
 }
 
 int main(int argc, char* argv[]) { vtx::openVortex(); }
@@ -557,8 +557,7 @@ void vtx::init(vtx::VertexContext* ctx)
 
 void vtx::loop(vtx::VertexContext* ctx)
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event) != 0) {
+    for (SDL_Event& event : ctx->input.events) {
         if (event.type == SDL_QUIT) {
             vtx::exitVortex();
             return;
@@ -593,7 +592,7 @@ void vtx::loop(vtx::VertexContext* ctx)
     usr.gizmo.draw();
 
     checkOpenGLError();
-    SDL_GL_SwapWindow(ctx->sdlWindow);
+    vtx::swapWindow(ctx);
 }
 
 int main(int argc, char* argv[]) { vtx::openVortex(); }
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory_resource>
+
+// Bytes the frame arena starts with, it grows to what frames need
+#define VTX_FRAME_ARENA_SIZE (1 << 20)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// Bump allocator: allocating moves an offset forward, nothing is freed
+// one by one, resetting frees everything at once. When the block runs
+// out, allocations spill into extra heap blocks, and the next reset
+// replaces the block with one as big as the peak, so a steady state
+// frame touches the heap no more.
+struct LinearArena {
+    unsigned char* base;
+    size_t capacity;
+    size_t offset;
+    size_t peak;       // most bytes in use since the arena was made
+    size_t lastUsed;   // bytes in use when it was last reset
+    void* spills;      // extra blocks, each starts with the next one
+    size_t spilled;    // bytes in them
+    int spillCount;    // blocks spilled since the arena was made
+};
+
+void createArena(vtx::LinearArena* arena, size_t capacity);
+void destroyArena(vtx::LinearArena* arena);
+
+// Alignment is a power of two, no more than malloc() gives
+void* arenaAllocate(
+    vtx::LinearArena* arena,
+    size_t size,
+    size_t alignment = alignof(std::max_align_t)
+);
+
+// Frees everything allocated since the previous reset
+void resetArena(vtx::LinearArena* arena);
+
+// Uninitialized room for count objects of T
+template <typename T>
+T* arenaAllocateArray(vtx::LinearArena* arena, size_t count);
+
+// Lets std::pmr containers allocate from an arena, deallocating does
+// nothing. Containers must not outlive the next reset.
+class ArenaResource : public std::pmr::memory_resource {
+   public:
+    vtx::LinearArena* arena = nullptr;
+
+   protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment)
+        override;
+    bool do_is_equal(const std::pmr::memory_resource& other
+    ) const noexcept override;
+};
+}  // namespace vtx
+
+static size_t alignArenaOffset(size_t offset, size_t alignment);
+static void freeArenaSpills(vtx::LinearArena* arena);
+
+// ***************
+//  Linear arenas
+// ***************
+
+static size_t alignArenaOffset(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+static void freeArenaSpills(vtx::LinearArena* arena)
+{
+    while (arena->spills != nullptr) {
+        void* next = *(void**) arena->spills;
+        free(arena->spills);
+        arena->spills = next;
+    }
+    arena->spilled = 0;
+}
+
+void vtx::createArena(vtx::LinearArena* arena, size_t capacity)
+{
+    *arena          = {};
+    arena->base     = (unsigned char*) malloc(capacity);
+    arena->capacity = capacity;
+}
+
+void vtx::destroyArena(vtx::LinearArena* arena)
+{
+    freeArenaSpills(arena);
+    free(arena->base);
+    *arena = {};
+}
+
+void* vtx::arenaAllocate(
+    vtx::LinearArena* arena,
+    size_t size,
+    size_t alignment
+)
+{
+    size_t start = alignArenaOffset(arena->offset, alignment);
+    if (start + size <= arena->capacity) {
+        arena->offset = start + size;
+        arena->peak =
+            std::max(arena->peak, arena->offset + arena->spilled);
+        return arena->base + start;
+    }
+
+    // Out of room for this frame, the heap takes over until the reset.
+    // The header keeps the alignment of what follows it.
+    size_t header = alignArenaOffset(sizeof(void*), alignment);
+    auto* block   = (unsigned char*) malloc(header + size);
+    if (block == nullptr) {
+        std::cerr << "Out of memory for " << size << " bytes"
+                  << std::endl;
+        exit(1);
+    }
+    *(void**) block = arena->spills;
+    arena->spills   = block;
+    arena->spilled += size;
+    arena->spillCount++;
+    arena->peak = std::max(arena->peak, arena->offset + arena->spilled);
+    return block + header;
+}
+
+void vtx::resetArena(vtx::LinearArena* arena)
+{
+    arena->lastUsed = arena->offset + arena->spilled;
+
+    if (arena->spills != nullptr) {
+        freeArenaSpills(arena);
+        // Some spare room, so a frame slightly bigger than the biggest
+        // one so far does not spill again
+        arena->capacity = arena->peak + arena->peak / 4;
+        free(arena->base);
+        arena->base = (unsigned char*) malloc(arena->capacity);
+    }
+
+    arena->offset = 0;
+}
+
+template <typename T>
+T* vtx::arenaAllocateArray(vtx::LinearArena* arena, size_t count)
+{
+    return (T*) arenaAllocate(arena, sizeof(T) * count, alignof(T));
+}
+
+void* vtx::ArenaResource::do_allocate(size_t bytes, size_t alignment)
+{
+    return vtx::arenaAllocate(this->arena, bytes, alignment);
+}
+
+// Nothing to do, resetting the arena frees everything at once
+void vtx::ArenaResource::do_deallocate(void*, size_t, size_t) {}
+
+bool vtx::ArenaResource::do_is_equal(
+    const std::pmr::memory_resource& other
+) const noexcept
+{
+    return this == &other;
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "./trace.h"
+
+// Like the job system, web builds only get loader threads with
+// -pthread. Without them the uploading thread runs one load a frame.
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define VTX_ASSET_THREADS
+#endif
+
+// Loader threads unless VTX_ASSET_LOADERS says, loads mostly wait for
+// the disk and for Assimp, so a few are plenty
+#define VTX_ASSET_LOADERS (2)
+// Milliseconds of uploads per frame unless VTX_UPLOAD_BUDGET_MS says
+#define VTX_UPLOAD_BUDGET_MS (2.0f)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+enum AssetState {
+    ASSET_QUEUED,
+    ASSET_LOADING,  // on a loader thread
+    ASSET_LOADED,   // waiting for its upload
+    ASSET_READY,    // uploaded, may be drawn
+    ASSET_FAILED,
+};
+
+// Runs on a loader thread and must not touch GL: file I/O, imports,
+// decoding. False when the asset could not be loaded.
+typedef bool (*AssetLoadFunction)(void* data);
+// Runs on the thread that owns the GL context, between frames
+typedef void (*AssetUploadFunction)(void* data);
+
+// Owned by the caller and must stay where it is until the asset is
+// ready or failed
+struct Asset {
+    const char* name;  // shown in the trace
+    AssetLoadFunction load;
+    AssetUploadFunction upload;
+    void* data;
+    std::atomic<int> state{ASSET_QUEUED};
+    vtx::Asset* next;  // in the loaded stack, see AssetLoader
+};
+
+struct AssetLoader {
+    std::vector<std::thread> threads;
+    bool started = false;
+
+    // Requests, taken by the loader threads
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<vtx::Asset*> requests;
+    bool stopping = false;
+
+    // Loaded assets are pushed here by the loader threads without a
+    // lock. The uploading thread takes the whole stack at once and
+    // keeps it, oldest first, in uploads.
+    std::atomic<vtx::Asset*> loaded{nullptr};
+    std::deque<vtx::Asset*> uploads;
+
+    std::atomic<int> pending{0};  // requested, not ready nor failed
+    float budgetMs = -1.0f;       // below 0 until first looked at
+};
+
+// Queues the asset. load() runs on a loader thread, upload() later on
+// the thread that owns the GL context. Draw something else until
+// vtx::isAssetReady() is true.
+void loadAsset(
+    vtx::Asset* asset,
+    const char* name,
+    vtx::AssetLoadFunction load,
+    vtx::AssetUploadFunction upload,
+    void* data
+);
+
+// True once upload() has returned, everything it wrote is then visible
+bool isAssetReady(const vtx::Asset* asset);
+bool hasAssetFailed(const vtx::Asset* asset);
+
+// Assets requested and not yet ready nor failed
+int pendingAssetCount();
+
+// Uploads loaded assets until the budget of the frame is spent, at
+// least one each call. ctx.h calls it before every frame on the thread
+// that owns the GL context.
+void uploadLoadedAssets();
+void setUploadBudget(float milliseconds);
+
+// Joins the loader threads, requests not yet started are dropped
+void stopAssetLoader();
+}  // namespace vtx
+
+static void startAssetLoader();
+static void runAssetLoader(int index);
+static void loadOneAsset(vtx::Asset* asset);
+static void takeLoadedAssets();
+
+// **********************
+//  Global state context
+// **********************
+
+static vtx::AssetLoader assetLoader;
+
+// *********
+//  Loading
+// *********
+
+static void startAssetLoader()
+{
+    assetLoader.started  = true;
+    assetLoader.stopping = false;
+    if (assetLoader.budgetMs < 0.0f) {
+        const char* budget   = getenv("VTX_UPLOAD_BUDGET_MS");
+        assetLoader.budgetMs = budget != nullptr ? (float) atof(budget)
+                                                 : VTX_UPLOAD_BUDGET_MS;
+    }
+#ifdef VTX_ASSET_THREADS
+    int count           = VTX_ASSET_LOADERS;
+    const char* setting = getenv("VTX_ASSET_LOADERS");
+    if (setting != nullptr && setting[0] != '\0') {
+        count = std::max(atoi(setting), 1);
+    }
+    for (int i = 0; i < count; i++) {
+        assetLoader.threads.emplace_back(runAssetLoader, i + 1);
+    }
+#endif
+}
+
+void vtx::loadAsset(
+    vtx::Asset* asset,
+    const char* name,
+    vtx::AssetLoadFunction load,
+    vtx::AssetUploadFunction upload,
+    void* data
+)
+{
+    asset->name   = name;
+    asset->load   = load;
+    asset->upload = upload;
+    asset->data   = data;
+    asset->next   = nullptr;
+    asset->state.store(vtx::ASSET_QUEUED, std::memory_order_relaxed);
+    assetLoader.pending.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> guard(assetLoader.lock);
+        if (!assetLoader.started) startAssetLoader();
+        assetLoader.requests.push_back(asset);
+    }
+    assetLoader.wake.notify_one();
+}
+
+static void runAssetLoader(int index)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "loader %d", index);
+    vtx::setTraceThreadName(name);
+
+    for (;;) {
+        vtx::Asset* asset;
+        {
+            std::unique_lock<std::mutex> guard(assetLoader.lock);
+            assetLoader.wake.wait(guard, [] {
+                return assetLoader.stopping ||
+                       !assetLoader.requests.empty();
+            });
+            if (assetLoader.stopping) return;
+            asset = assetLoader.requests.front();
+            assetLoader.requests.pop_front();
+        }
+        loadOneAsset(asset);
+    }
+}
+
+static void loadOneAsset(vtx::Asset* asset)
+{
+    asset->state.store(vtx::ASSET_LOADING, std::memory_order_relaxed);
+    bool loaded;
+    {
+        VTX_TRACE_SCOPE_DETAIL("loadAsset", asset->name);
+        loaded = asset->load(asset->data);
+    }
+    if (!loaded) {
+        std::cerr << "Could not load " << asset->name << std::endl;
+        asset->state.store(
+            vtx::ASSET_FAILED, std::memory_order_release
+        );
+        assetLoader.pending.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+
+    asset->state.store(vtx::ASSET_LOADED, std::memory_order_relaxed);
+    // Release, so whatever load() wrote is seen by upload()
+    vtx::Asset* head =
+        assetLoader.loaded.load(std::memory_order_relaxed);
+    do {
+        asset->next = head;
+    } while (!assetLoader.loaded.compare_exchange_weak(
+        head, asset, std::memory_order_release,
+        std::memory_order_relaxed
+    ));
+}
+
+bool vtx::isAssetReady(const vtx::Asset* asset)
+{
+    return asset->state.load(std::memory_order_acquire) ==
+           vtx::ASSET_READY;
+}
+
+bool vtx::hasAssetFailed(const vtx::Asset* asset)
+{
+    return asset->state.load(std::memory_order_acquire) ==
+           vtx::ASSET_FAILED;
+}
+
+int vtx::pendingAssetCount()
+{
+    return assetLoader.pending.load(std::memory_order_relaxed);
+}
+
+// ***********
+//  Uploading
+// ***********
+
+void vtx::setUploadBudget(float milliseconds)
+{
+    assetLoader.budgetMs = milliseconds;
+}
+
+// The stack has the newest on top, uploads go oldest first
+static void takeLoadedAssets()
+{
+    vtx::Asset* taken =
+        assetLoader.loaded.exchange(nullptr, std::memory_order_acquire);
+    size_t end = assetLoader.uploads.size();
+    for (; taken != nullptr; taken = taken->next) {
+        assetLoader.uploads.insert(
+            assetLoader.uploads.begin() + end, taken
+        );
+    }
+}
+
+void vtx::uploadLoadedAssets()
+{
+    if (vtx::pendingAssetCount() == 0) return;
+
+#ifndef VTX_ASSET_THREADS
+    // No loader threads, so one load per frame happens right here
+    vtx::Asset* request = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(assetLoader.lock);
+        if (!assetLoader.requests.empty()) {
+            request = assetLoader.requests.front();
+            assetLoader.requests.pop_front();
+        }
+    }
+    if (request != nullptr) loadOneAsset(request);
+#endif
+
+    takeLoadedAssets();
+    auto start = std::chrono::steady_clock::now();
+    while (!assetLoader.uploads.empty()) {
+        vtx::Asset* asset = assetLoader.uploads.front();
+        assetLoader.uploads.pop_front();
+        {
+            VTX_TRACE_SCOPE_DETAIL("uploadAsset", asset->name);
+            asset->upload(asset->data);
+        }
+        asset->state.store(vtx::ASSET_READY, std::memory_order_release);
+        assetLoader.pending.fetch_sub(1, std::memory_order_relaxed);
+
+        std::chrono::duration<float, std::milli> spent =
+            std::chrono::steady_clock::now() - start;
+        if (spent.count() >= assetLoader.budgetMs) break;
+    }
+}
+
+void vtx::stopAssetLoader()
+{
+    {
+        std::lock_guard<std::mutex> guard(assetLoader.lock);
+        if (!assetLoader.started) return;
+        assetLoader.stopping = true;
+        assetLoader.requests.clear();
+    }
+    assetLoader.wake.notify_all();
+    // A load that already started is waited for
+    for (std::thread& thread : assetLoader.threads) thread.join();
+    assetLoader.threads.clear();
+    assetLoader.uploads.clear();
+    assetLoader.loaded.store(nullptr);
+    assetLoader.started = false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#ifndef __EMSCRIPTEN__
+#include <sys/stat.h>
+#endif
+
+// Makes no GL call, the texture cooker writes its files with it too
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// Where cached files go, VTX_CACHE_DIR or ./.vtx-cache by default
+const char* cacheDirectory();
+
+// Fine if it already exists
+void createCacheDirectory();
+
+// Calls write(file) on a file next to path and renames it over path
+// when write returns true, so a crash or a second process never leaves
+// a half written file behind. False when nothing was written.
+template <typename Write>
+bool writeFileAtomically(const std::string& path, const Write& write);
+}  // namespace vtx
+
+// ****************
+//  Cache location
+// ****************
+
+const char* vtx::cacheDirectory()
+{
+    const char* directory = getenv("VTX_CACHE_DIR");
+    if (directory == nullptr || directory[0] == '\0') {
+        directory = "./.vtx-cache";
+    }
+    return directory;
+}
+
+void vtx::createCacheDirectory()
+{
+#ifndef __EMSCRIPTEN__
+    mkdir(vtx::cacheDirectory(), 0755);
+#endif
+}
+
+// **************
+//  Cache writes
+// **************
+
+template <typename Write>
+bool vtx::writeFileAtomically(
+    const std::string& path,
+    const Write& write
+)
+{
+    std::string tmpPath = path + ".tmp";
+    FILE* file          = fopen(tmpPath.c_str(), "wb");
+    if (file == nullptr) return false;
+
+    bool written = write(file);
+    if (fclose(file) != 0) written = false;
+
+    if (written && rename(tmpPath.c_str(), path.c_str()) == 0) {
+        return true;
+    }
+    remove(tmpPath.c_str());
+    return false;
+}
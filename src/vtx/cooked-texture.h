@@ -0,0 +1,213 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#ifdef __EMSCRIPTEN__
+#include <emscripten/html5.h>
+#endif
+
+#include "./gpu-memory.h"
+#include "./texture-cooker.h"
+#include "./trace.h"
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// One chain read from a cooked file, ready for the GL calls as it is
+struct CookedTexture {
+    int width, height;
+    int levelCount;
+    GLenum internalFormat;  // an ETC2 format or GL_RGBA8
+    std::vector<unsigned char> data;
+    size_t levelOffsets[VTX_COOKED_TEXTURE_LEVELS];  // into data
+    size_t levelBytes[VTX_COOKED_TEXTURE_LEVELS];
+};
+
+// True when ETC2 textures are used. Ask on the thread that owns the GL
+// context the first time, the answer is then kept for all. Only on the
+// web by default, VTX_TEXTURE_ETC2=1 opts in on the desktop and
+// VTX_TEXTURE_ETC2=0 opts out everywhere.
+bool supportsEtc2();
+
+// Reads the ETC2 chain when etc2 is set and the file has one, the
+// RGBA8 chain otherwise. False when the file is missing or was cooked
+// by another version. Any thread may call it.
+bool readCookedTexture(
+    const char* path,
+    bool etc2,
+    vtx::CookedTexture* cooked
+);
+
+// Uploads every level as read, nothing is generated or converted.
+// Leaves the texture bound, like vtx::GpuTexture::create2D().
+void uploadCookedTexture(
+    const vtx::CookedTexture* cooked,
+    vtx::GpuTexture* texture,
+    const char* owner
+);
+
+// Both of the above on the thread that owns the GL context. False when
+// there is no cooked file, so the caller can decode the source image.
+bool loadCookedTexture(const char* path, vtx::GpuTexture* texture);
+}  // namespace vtx
+
+static bool detectEtc2();
+static bool readCookedChain(
+    FILE* file,
+    uint64_t fileSize,
+    const vtx::CookedTextureLevel* levels,
+    int levelCount,
+    vtx::CookedTexture* cooked
+);
+
+// **********************
+//  Global state context
+// **********************
+
+static int etc2Support = -1;  // not asked yet
+
+// *********
+//  Support
+// *********
+
+static bool detectEtc2()
+{
+    const char* setting = getenv("VTX_TEXTURE_ETC2");
+    if (setting != nullptr && strcmp(setting, "0") == 0) return false;
+#ifdef __EMSCRIPTEN__
+    // Not core in WebGL 2, the extension has to be enabled
+    return emscripten_webgl_enable_extension(
+        emscripten_webgl_get_current_context(),
+        "WEBGL_compressed_texture_etc"
+    );
+#else
+    // Desktop GPUs rarely sample ETC2, most drivers decompress it to
+    // RGBA8 on the CPU at upload, which saves no memory at all
+    if (setting == nullptr || strcmp(setting, "1") != 0) return false;
+
+    // Core since 4.3, a 3.3 context needs the ES 3 compatibility
+    return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility;
+#endif
+}
+
+bool vtx::supportsEtc2()
+{
+    if (etc2Support < 0) etc2Support = detectEtc2() ? 1 : 0;
+    return etc2Support == 1;
+}
+
+// *********
+//  Reading
+// *********
+
+static bool readCookedChain(
+    FILE* file,
+    uint64_t fileSize,
+    const vtx::CookedTextureLevel* levels,
+    int levelCount,
+    vtx::CookedTexture* cooked
+)
+{
+    // The levels follow each other, so the chain is a single read
+    uint64_t begin = levels[0].offset;
+    uint64_t end =
+        levels[levelCount - 1].offset + levels[levelCount - 1].bytes;
+    if (end < begin || end > fileSize) return false;
+    for (int i = 0; i < levelCount; i++) {
+        if (levels[i].offset < begin ||
+            levels[i].offset + levels[i].bytes > end) {
+            return false;
+        }
+        cooked->levelOffsets[i] = (size_t) (levels[i].offset - begin);
+        cooked->levelBytes[i]   = (size_t) levels[i].bytes;
+    }
+
+    cooked->data.resize((size_t) (end - begin));
+    return fseek(file, (long) begin, SEEK_SET) == 0 &&
+           fread(cooked->data.data(), 1, cooked->data.size(), file) ==
+               cooked->data.size();
+}
+
+bool vtx::readCookedTexture(
+    const char* path,
+    bool etc2,
+    vtx::CookedTexture* cooked
+)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return false;
+
+    VTX_TRACE_SCOPE_DETAIL("readCookedTexture", path);
+    vtx::CookedTextureHeader header = {};
+    long size = -1;
+    if (fread(&header, sizeof(header), 1, file) == 1 &&
+        fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+    }
+
+    bool compressed        = etc2 && header.etc2Format != 0;
+    cooked->width          = (int) header.width;
+    cooked->height         = (int) header.height;
+    cooked->levelCount     = (int) header.levelCount;
+    cooked->internalFormat = compressed ? header.etc2Format : GL_RGBA8;
+
+    bool valid = size > 0 && memcmp(header.magic, "VTXT", 4) == 0 &&
+                 header.version == VTX_COOKED_TEXTURE_VERSION &&
+                 header.fileSize == (uint64_t) size &&
+                 header.levelCount > 0 &&
+                 header.levelCount <= VTX_COOKED_TEXTURE_LEVELS &&
+                 readCookedChain(
+                     file, header.fileSize,
+                     compressed ? header.etc2 : header.rgba8,
+                     cooked->levelCount, cooked
+                 );
+    fclose(file);
+    if (!valid) {
+        std::cerr << "Cooked texture: stale file " << path
+                  << ", cook it again" << std::endl;
+        cooked->data.clear();
+    }
+    return valid;
+}
+
+// ***********
+//  Uploading
+// ***********
+
+void vtx::uploadCookedTexture(
+    const vtx::CookedTexture* cooked,
+    vtx::GpuTexture* texture,
+    const char* owner
+)
+{
+    VTX_TRACE_SCOPE_DETAIL("uploadCookedTexture", owner);
+    const void* levels[VTX_COOKED_TEXTURE_LEVELS];
+    for (int i = 0; i < cooked->levelCount; i++) {
+        levels[i] = cooked->data.data() + cooked->levelOffsets[i];
+    }
+
+    bool compressed = cooked->internalFormat != GL_RGBA8;
+    texture->createLevels2D(
+        cooked->width, cooked->height, cooked->internalFormat,
+        compressed ? 0 : GL_RGBA, compressed ? 0 : GL_UNSIGNED_BYTE,
+        cooked->levelCount, levels, cooked->levelBytes, owner
+    );
+}
+
+bool vtx::loadCookedTexture(const char* path, vtx::GpuTexture* texture)
+{
+    vtx::CookedTexture cooked;
+    if (!vtx::readCookedTexture(path, vtx::supportsEtc2(), &cooked)) {
+        return false;
+    }
+    vtx::uploadCookedTexture(&cooked, texture, path);
+    return true;
+}
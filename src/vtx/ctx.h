@@ -7,13 +7,38 @@
 #include <GLFW/glfw3.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #include <emscripten/html5.h>
 
 #endif
 
+#include "./arena.h"
+#include "./asset-loader.h"
+#include "./flight-recorder.h"
+#include "./frame-constants.h"
+#include "./gl-debug.h"
+#include "./gl-state.h"
+#include "./gpu-memory.h"
+#include "./input.h"
+#include "./jobs.h"
+#include "./pacing.h"
+#include "./profiler.h"
+#include "./shader-cache.h"
+#include "./stream-buffer.h"
+#include "./trace.h"
+
 // *******************************
 //  Declarations of all functions
 // *******************************
@@ -21,6 +46,9 @@
 // 1. OpenGL init subsystem
 
 static bool initVideo(const int screenWidth, const int screenHeight);
+static bool readHeadlessSize(int* width, int* height);
+static bool createHeadlessFramebuffer(int width, int height);
+static void destroyHeadlessFramebuffer();
 
 // 2. OpenGL shader subsystem
 namespace vtx {
@@ -28,8 +56,40 @@ GLuint createShaderProgram(
     const char* vertexShader,
     const char* fragmentShader
 );
-}
+
+// Starts compiling and linking, but does not wait for either. The
+// returned program can be used right away, its status is checked the
+// first time it is bound with vtx::useProgram().
+GLuint createShaderProgramAsync(
+    const char* vertexShader,
+    const char* fragmentShader
+);
+
+// Same as glUseProgram(), but finishes programs created with
+// vtx::createShaderProgramAsync() on their first use, and skips the
+// call when the program is already bound
+void useProgram(GLuint program);
+
+// Same as glDeleteProgram(), and forgets the program if it was never
+// bound, so a later program given the same name is not mistaken for it
+void deleteShaderProgram(GLuint program);
+
+// The program last bound with vtx::useProgram()
+GLuint currentProgram();
+
+// False while the driver is still working on the program, so binding
+// it would block. Always true without KHR_parallel_shader_compile.
+bool isShaderProgramReady(GLuint program);
+}  // namespace vtx
+static void enableParallelShaderCompile();
 static GLuint compileShader(GLenum type, const char* source);
+static GLuint submitShader(GLenum type, const char* source);
+static void checkShaderCompiled(
+    GLuint shader,
+    GLenum type,
+    const char* source
+);
+static void finishShaderProgram(size_t pendingIndex);
 
 // 3. OpenGL diagnostic utils
 
@@ -38,18 +98,59 @@ static void checkOpenGLError(const char* optionalTag);
 
 // 4. Main loop subsystem
 
+static uint64_t readClock();
+static uint64_t readClockFrequency();
+static void tickFrameClock();
+static void runFixedSteps();
 static void performOneCycle();
+static void checkTraceHotkey();
 namespace vtx {
 void openVortex(const int screenWidth, const int screenHeight);
 void exitVortex();
 }  // namespace vtx
 
+// 5. Benchmark subsystem
+
+namespace vtx {
+// Same as glDrawElements() and glDrawArrays(), but counted
+void drawElements(
+    GLenum mode,
+    GLsizei count,
+    GLenum type,
+    const void* indices
+);
+void drawArrays(GLenum mode, GLint first, GLsizei count);
+}  // namespace vtx
+static void readBenchmarkSettings();
+static void recordBenchmarkFrame(double frameMs, int drawCalls);
+static void writeBenchmarkReport();
+
+// 6. Render thread subsystem
+
+namespace vtx {
+struct FramePacket;  // see frame-packet.h
+}  // namespace vtx
+static void startRenderThread();
+static void stopRenderThread();
+static void publishFramePacket();
+static void runRenderThread();
+static void makeContextCurrent(bool current);
+
+// Bits of VertexContext::readyPacket next to the slot index
+#define VTX_FRAME_PACKET_SLOTS (3)
+#define VTX_FRAME_PACKET_NEW (4u)   // published, not yet taken
+#define VTX_FRAME_PACKET_STOP (8u)  // the render thread should quit
+
+// 7. Input latency subsystem
+
+static void latchFramePacket();
+
 // **********************
 //  Global state context
 // **********************
 
 namespace vtx {
-typedef struct {
+typedef struct VertexContext {
     bool shouldContinue;
 #ifdef __USE_SDL
     SDL_Window* sdlWindow;
@@ -58,10 +159,130 @@ typedef struct {
     GLFWwindow* glfwWindow;
 #endif
     int screenWidth, screenHeight;
+
+    // Headless mode renders into an offscreen framebuffer instead of
+    // a visible window, it is turned on with VTX_HEADLESS=WIDTHxHEIGHT
+    bool headless;
+    GLuint headlessFramebuffer;
+    GLuint headlessColorbuffer;
+    GLuint headlessDepthbuffer;
+
+    // Frame clock, refreshed before every vtx::loop() call
+    uint64_t clockFrequency;  // high resolution ticks per second
+    uint64_t clockStart;      // ticks when the main loop started
+    uint64_t frameStart;      // ticks when this frame started
+    uint64_t frameIndex;      // number of frames started so far
+    double frameTime;         // seconds since the main loop started
+    double deltaTime;         // seconds since the previous frame
+
+    // Fixed timestep simulation, see vtx::setFixedTimestep()
+    void (*simulate)(struct VertexContext* ctx, double stepSeconds);
+    double fixedStep;       // seconds simulated by one simulate() call
+    int maxStepsPerFrame;   // catch-up limit for slow frames
+    double simTime;         // seconds simulated so far
+    double simAccumulator;  // wall time not yet simulated
+    int simSteps;           // simulate() calls made in this frame
+    float alpha;  // how far between the last two sim states to render
+
+    // Benchmark mode, turned on with VTX_BENCHMARK_FRAMES=N
+    bool benchmark;
+    int benchmarkFrames;          // frames measured after the warm-up
+    int benchmarkWarmup;          // frames run before measuring starts
+    const char* benchmarkOutput;  // path of the JSON report
+    std::string benchmarkRenderer;
+    std::vector<double> benchmarkFrameMs;
+    std::vector<int> benchmarkDrawCalls;
+    // vtx::drawElements/drawArrays calls in this frame, atomic since
+    // they are made on the render thread when there is one
+    std::atomic<int> drawCalls;
+
+    // Render thread, see vtx::setRenderThread(). The three packets go
+    // round between loop() writing one, one waiting in readyPacket and
+    // the render thread reading one, so no lock is ever taken.
+    void (*render)(struct VertexContext* ctx, FramePacket* packet);
+    FramePacket* framePackets[VTX_FRAME_PACKET_SLOTS];
+    // False on the web and with VTX_RENDER_THREAD=0. Atomic since
+    // vtx::swapWindow() reads it on the render thread.
+    std::atomic<bool> renderThreaded;
+    std::atomic<uint32_t> readyPacket;  // slot | VTX_FRAME_PACKET_*
+    uint32_t writingPacket;             // owned by the main thread
+    uint32_t readingPacket;             // owned by the render thread
+    std::thread renderThread;
+
+    // Worker pool for fanning out work from init(), loop() and
+    // simulate(), see jobs.h. Runs every job inline on single
+    // threaded web builds.
+    vtx::JobSystem* jobs;
+
+    // Input of this frame, taken by vtx::pollInput() before simulate()
+    // and loop() run
+    vtx::InputSnapshot input;
+    // See vtx::setLateLatch()
+    void (*lateLatch)(struct VertexContext* ctx, FramePacket* packet);
+    uint64_t packetInputTimes[VTX_FRAME_PACKET_SLOTS];  // see input.h
+    // Milliseconds from the newest input a frame reflects to the end of
+    // its swap, of the last frame that had any input. Written by the
+    // thread that swaps.
+    std::atomic<float> inputLatency;
+
+    // Frame limiter, vsync and frames in flight, see pacing.h. The
+    // fences are only touched by the thread that swaps.
+    vtx::FramePacer pacer;
+
+    // Scratch memory of the main thread, emptied as each frame starts.
+    // Allocate with vtx::arenaAllocateArray(&ctx->frameArena, n), or
+    // hand &ctx->frameMemory to std::pmr containers. Nothing in it may
+    // be kept past the frame, not even in a frame packet.
+    vtx::LinearArena frameArena;
+    vtx::ArenaResource frameMemory;
+
+    // Room for vertices, indices and uniform ranges that are drawn in
+    // the frame they are written, see vtx::streamWrite(). Only for the
+    // thread that renders.
+    vtx::StreamBuffer* vertexStream;
+    vtx::StreamBuffer* indexStream;
 } VertexContext;
 
 void init(vtx::VertexContext* ctx);
 void loop(vtx::VertexContext* ctx);
+
+// Makes the main loop call simulate() at a fixed rate, independently
+// of how often frames are rendered. Frames that fall behind are caught
+// up with at most maxStepsPerFrame steps, the rest of the backlog is
+// dropped so that one slow frame cannot snowball into the next ones.
+void setFixedTimestep(
+    vtx::VertexContext* ctx,
+    double stepSeconds,
+    int maxStepsPerFrame,
+    void (*simulate)(vtx::VertexContext* ctx, double stepSeconds)
+);
+
+// Splits every frame in two: loop() fills the packet of
+// vtx::beginFramePacket() without making any GL call, and render()
+// draws it on a thread of its own that owns the GL context, while
+// loop() already works on the next frame. Call from init(), GL may
+// still be used there. On the web, or with VTX_RENDER_THREAD=0,
+// render() runs right after loop() on the main thread instead.
+void setRenderThread(
+    vtx::VertexContext* ctx,
+    vtx::FramePacket* packets[VTX_FRAME_PACKET_SLOTS],
+    void (*render)(vtx::VertexContext* ctx, vtx::FramePacket* packet)
+);
+
+// Calls lateLatch() on the main thread as late as possible before a
+// packet goes to render(), after the mouse was sampled again with
+// vtx::latchInput(). It may only touch the packet, typically to turn
+// worldToView to where the mouse is now. Frames without packets call
+// vtx::latchInput() themselves right before their camera math.
+void setLateLatch(
+    vtx::VertexContext* ctx,
+    void (*lateLatch)(vtx::VertexContext* ctx, vtx::FramePacket* packet)
+);
+
+// Same as SDL_GL_SwapWindow() or glfwSwapBuffers(), then caps the
+// frames in flight and measures VertexContext::inputLatency. Call it
+// from render() when there is one.
+void swapWindow(vtx::VertexContext* ctx);
 }  // namespace vtx
 
 // *********************************
@@ -70,6 +291,18 @@ void loop(vtx::VertexContext* ctx);
 
 static vtx::VertexContext ctx;
 
+// Programs from vtx::createShaderProgramAsync() not yet bound once
+struct PendingShaderProgram {
+    GLuint program;
+    GLuint vertexShader;    // 0 when the program came from the cache
+    GLuint fragmentShader;  // 0 when the program came from the cache
+    bool storeInCache;
+    uint64_t cacheKey;
+    std::string vertexSource;  // copies, only for error messages
+    std::string fragmentSource;
+};
+static std::vector<PendingShaderProgram> pendingShaderPrograms;
+
 // **************************
 //  1. OpenGL init subsystem
 // **************************
@@ -96,7 +329,16 @@ static EM_BOOL on_web_display_size_changed(
 #endif
 bool initVideo(const int screenWidth, const int screenHeight)
 {
+    VTX_TRACE_SCOPE("initVideo");
+
 #ifdef __USE_SDL
+    // The offscreen video driver creates its GL context with EGL on a
+    // pbuffer, so it works on machines without a display or GPU
+    // (Mesa llvmpipe is enough)
+    if (ctx.headless) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "offscreen");
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         std::cerr << "SDL could not initialize! SDL Error: "
                   << SDL_GetError() << std::endl;
@@ -115,6 +357,11 @@ bool initVideo(const int screenWidth, const int screenHeight)
     );
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    if (vtx::isGLDebugContextRequested()) {
+        SDL_GL_SetAttribute(
+            SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG
+        );
+    }
 #endif
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
     SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
@@ -125,7 +372,7 @@ bool initVideo(const int screenWidth, const int screenHeight)
         screenWidth,   // ignored in fullscreen
         screenHeight,  // ignored in fullscreen
         SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE |
-            SDL_WINDOW_SHOWN  
+            (ctx.headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN)
     );
 
     if (window == nullptr) {
@@ -157,8 +404,7 @@ bool initVideo(const int screenWidth, const int screenHeight)
     );
 #endif
 
-    // SDL_GL_SetSwapInterval(1);  // Use V-Sync
-     SDL_GL_SetSwapInterval(0);  // Disable V-Sync
+    // The swap interval is set by vtx::startFramePacing()
 
 #elif defined(__USE_GLFW)
     if (!glfwInit()) {
@@ -173,6 +419,11 @@ bool initVideo(const int screenWidth, const int screenHeight)
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_SAMPLES, 4);  // enable multisampling
+    if (vtx::isGLDebugContextRequested()) {
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+    }
+    // GLFW still needs a display server, so headless only hides it
+    glfwWindowHint(GLFW_VISIBLE, ctx.headless ? GLFW_FALSE : GLFW_TRUE);
 
     GLFWwindow* window = glfwCreateWindow(
         SCREEN_WIDTH, SCREEN_HEIGHT, "GLFW OpenGL program", NULL, NULL
@@ -184,20 +435,33 @@ bool initVideo(const int screenWidth, const int screenHeight)
     }
 
     glfwMakeContextCurrent(window);
-
-    glfwSwapInterval(1);  // V-Sync
 #endif
 
     // Loading Glew is necessary no matter which graphics library you
     // use
     glewExperimental = GL_TRUE;
-    GLenum err       = glewInit();
+    GLenum err;
+    {
+        VTX_TRACE_SCOPE("glewInit");
+        err = glewInit();
+    }
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW loads GL itself before it looks for GLX, which is not
+    // there when the context came from EGL
+    if (ctx.headless && err == GLEW_ERROR_NO_GLX_DISPLAY) {
+        err = GLEW_OK;
+    }
+#endif
     if (err != GLEW_OK) {
         std::cerr << "Error initializing GLEW! "
                   << glewGetErrorString(err) << std::endl;
         return false;
     }
 
+    vtx::enableGLDebugOutput();
+    enableParallelShaderCompile();
+    vtx::invalidateGLState();
+
     int width, height;
 #ifdef __USE_SDL
     SDL_GL_GetDrawableSize(window, &width, &height);
@@ -216,6 +480,18 @@ bool initVideo(const int screenWidth, const int screenHeight)
     ctx.glfwWindow = window;
 #endif
 
+    if (ctx.headless) {
+        // Window size is meaningless without a window, the program
+        // sees the size of the framebuffer it really renders into
+        width            = screenWidth;
+        height           = screenHeight;
+        ctx.screenWidth  = width;
+        ctx.screenHeight = height;
+        if (!createHeadlessFramebuffer(width, height)) {
+            return false;
+        }
+    }
+
     glViewport(0, 0, width, height);
 
     std::cerr << "Status: Using GLEW" << glewGetString(GLEW_VERSION)
@@ -229,6 +505,87 @@ bool initVideo(const int screenWidth, const int screenHeight)
     return true;
 }
 
+static bool readHeadlessSize(int* width, int* height)
+{
+#ifdef __EMSCRIPTEN__
+    return false;  // the browser always gives us a canvas
+#else
+    const char* value = getenv("VTX_HEADLESS");
+    if (value == nullptr || value[0] == '\0') return false;
+
+    int w = 0, h = 0;
+    if (sscanf(value, "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+        *width  = w;
+        *height = h;
+    }
+    // Any other value, like VTX_HEADLESS=1, keeps the default size
+    return true;
+#endif
+}
+
+static bool createHeadlessFramebuffer(int width, int height)
+{
+    glGenRenderbuffers(1, &ctx.headlessColorbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, ctx.headlessColorbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    vtx::trackGpuAllocation(
+        GL_RENDERBUFFER, ctx.headlessColorbuffer,
+        vtx::GPU_MEMORY_RENDER_TARGETS,
+        vtx::gpuImageBytes(GL_RGBA8, width, height), GL_RGBA8, width,
+        height, "headless color"
+    );
+
+    glGenRenderbuffers(1, &ctx.headlessDepthbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, ctx.headlessDepthbuffer);
+    glRenderbufferStorage(
+        GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height
+    );
+    vtx::trackGpuAllocation(
+        GL_RENDERBUFFER, ctx.headlessDepthbuffer,
+        vtx::GPU_MEMORY_RENDER_TARGETS,
+        vtx::gpuImageBytes(GL_DEPTH_COMPONENT24, width, height),
+        GL_DEPTH_COMPONENT24, width, height, "headless depth"
+    );
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &ctx.headlessFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, ctx.headlessFramebuffer);
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+        ctx.headlessColorbuffer
+    );
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+        ctx.headlessDepthbuffer
+    );
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Headless framebuffer is incomplete: " << status
+                  << std::endl;
+        return false;
+    }
+
+    // Stays bound for the whole run, so programs that draw to the
+    // default framebuffer draw into this one without knowing it
+    std::cerr << "Headless: rendering offscreen at " << width << "x"
+              << height << std::endl;
+    return true;
+}
+
+static void destroyHeadlessFramebuffer()
+{
+    if (ctx.headlessFramebuffer == 0) return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &ctx.headlessFramebuffer);
+    glDeleteRenderbuffers(1, &ctx.headlessColorbuffer);
+    glDeleteRenderbuffers(1, &ctx.headlessDepthbuffer);
+    vtx::untrackGpuAllocation(GL_RENDERBUFFER, ctx.headlessColorbuffer);
+    vtx::untrackGpuAllocation(GL_RENDERBUFFER, ctx.headlessDepthbuffer);
+    ctx.headlessFramebuffer = 0;
+}
+
 // ****************************
 //  2. OpenGL shader subsystem
 // ****************************
@@ -238,12 +595,31 @@ GLuint vtx::createShaderProgram(
     const char* fragmentShaderSource
 )
 {
+    VTX_TRACE_SCOPE("createShaderProgram");
+    GLuint shaderProgram = glCreateProgram();
+
+    // Linking is the slow part on Mesa, a binary from an earlier run
+    // skips both compiling and linking
+    bool useCache = vtx::isShaderCacheEnabled();
+    uint64_t key  = 0;
+    if (useCache) {
+        key = vtx::shaderProgramKey(
+            vertexShaderSource, fragmentShaderSource
+        );
+        if (vtx::loadCachedProgram(key, shaderProgram)) {
+            vtx::bindFrameConstantsBlock(shaderProgram);
+            return shaderProgram;
+        }
+        glProgramParameteri(
+            shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE
+        );
+    }
+
     GLuint vertexShader =
         compileShader(GL_VERTEX_SHADER, vertexShaderSource);
     GLuint fragmentShader =
         compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
 
-    GLuint shaderProgram = glCreateProgram();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
     glLinkProgram(shaderProgram);
@@ -251,15 +627,157 @@ GLuint vtx::createShaderProgram(
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
+    GLint linked = GL_FALSE;
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &linked);
+    if (linked) vtx::bindFrameConstantsBlock(shaderProgram);
+    if (useCache && linked) vtx::storeCachedProgram(key, shaderProgram);
+
     return shaderProgram;
 }
 
-static GLuint compileShader(GLenum type, const char* source)
+GLuint vtx::createShaderProgramAsync(
+    const char* vertexShaderSource,
+    const char* fragmentShaderSource
+)
+{
+    VTX_TRACE_SCOPE("createShaderProgramAsync");
+    GLuint shaderProgram = glCreateProgram();
+
+    PendingShaderProgram pending = {};
+    pending.program              = shaderProgram;
+    pending.vertexSource         = vertexShaderSource;
+    pending.fragmentSource       = fragmentShaderSource;
+
+    if (vtx::isShaderCacheEnabled()) {
+        pending.cacheKey = vtx::shaderProgramKey(
+            vertexShaderSource, fragmentShaderSource
+        );
+        // A cached binary is already linked, nothing left to wait for
+        if (vtx::loadCachedProgram(pending.cacheKey, shaderProgram)) {
+            vtx::bindFrameConstantsBlock(shaderProgram);
+            return shaderProgram;
+        }
+        pending.storeInCache = true;
+        glProgramParameteri(
+            shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE
+        );
+    }
+
+    // No status queries here, any of them would wait for the driver
+    pending.vertexShader =
+        submitShader(GL_VERTEX_SHADER, vertexShaderSource);
+    pending.fragmentShader =
+        submitShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+    glAttachShader(shaderProgram, pending.vertexShader);
+    glAttachShader(shaderProgram, pending.fragmentShader);
+    glLinkProgram(shaderProgram);
+
+    pendingShaderPrograms.push_back(pending);
+    return shaderProgram;
+}
+
+void vtx::useProgram(GLuint program)
+{
+    for (size_t i = 0; i < pendingShaderPrograms.size(); i++) {
+        if (pendingShaderPrograms[i].program == program) {
+            finishShaderProgram(i);
+            break;
+        }
+    }
+    vtx::useProgramCached(program);
+}
+
+void vtx::deleteShaderProgram(GLuint program)
+{
+    for (size_t i = 0; i < pendingShaderPrograms.size(); i++) {
+        const PendingShaderProgram& pending = pendingShaderPrograms[i];
+        if (pending.program != program) continue;
+
+        glDeleteShader(pending.vertexShader);
+        glDeleteShader(pending.fragmentShader);
+        pendingShaderPrograms.erase(pendingShaderPrograms.begin() + i);
+        break;
+    }
+    // Nor mistaken for the bound one
+    if (glState.program == program) vtx::useProgramCached(0);
+    glDeleteProgram(program);
+}
+
+GLuint vtx::currentProgram() { return glState.program; }
+
+bool vtx::isShaderProgramReady(GLuint program)
+{
+    if (!GLEW_KHR_parallel_shader_compile) return true;
+
+    GLint completed = GL_TRUE;
+    glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+static void enableParallelShaderCompile()
+{
+    if (GLEW_KHR_parallel_shader_compile) {
+        // Let the driver pick how many of its threads compile
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+}
+
+static void finishShaderProgram(size_t pendingIndex)
+{
+    VTX_TRACE_SCOPE("finishShaderProgram");
+    PendingShaderProgram pending = pendingShaderPrograms[pendingIndex];
+    pendingShaderPrograms.erase(
+        pendingShaderPrograms.begin() + pendingIndex
+    );
+
+    checkShaderCompiled(
+        pending.vertexShader, GL_VERTEX_SHADER,
+        pending.vertexSource.c_str()
+    );
+    checkShaderCompiled(
+        pending.fragmentShader, GL_FRAGMENT_SHADER,
+        pending.fragmentSource.c_str()
+    );
+    glDeleteShader(pending.vertexShader);
+    glDeleteShader(pending.fragmentShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(pending.program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char infoLog[512];
+        glGetProgramInfoLog(pending.program, 512, nullptr, infoLog);
+        std::cerr << "ERROR::PROGRAM::LINKING_FAILED\n"
+                  << infoLog << std::endl;
+        exit(1);
+    }
+    vtx::bindFrameConstantsBlock(pending.program);
+
+    if (pending.storeInCache) {
+        vtx::storeCachedProgram(pending.cacheKey, pending.program);
+    }
+}
+
+static GLuint submitShader(GLenum type, const char* source)
 {
     GLuint shader = glCreateShader(type);
     glShaderSource(shader, 1, &source, nullptr);
     glCompileShader(shader);
+    return shader;
+}
 
+static GLuint compileShader(GLenum type, const char* source)
+{
+    GLuint shader = submitShader(type, source);
+    checkShaderCompiled(shader, type, source);
+    return shader;
+}
+
+static void checkShaderCompiled(
+    GLuint shader,
+    GLenum type,
+    const char* source
+)
+{
     GLint success;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (!success) {
@@ -276,7 +794,6 @@ static GLuint compileShader(GLenum type, const char* source)
                   << infoLog << std::endl;
         exit(1);
     }
-    return shader;
 }
 
 // ****************************
@@ -301,29 +818,211 @@ static void printShaderVersions()
     printf("Renderer: %s\n", renderer);
 }
 
+// Reports what the KHR_debug callback collected, which costs no GL
+// call at all. glGetError() waits for the driver to catch up, so it is
+// only polled when built with -DVTX_STRICT_GL_ERRORS, and only then
+// does an error stop the program.
 static void checkOpenGLError(const char* optionalTag = "")
 {
+    int errors = vtx::reportGLDebugMessages();
+    if (errors > 0) {
+        std::cerr << optionalTag << errors << " OpenGL errors reported"
+                  << std::endl;
+    }
+
+#ifdef VTX_STRICT_GL_ERRORS
     GLenum err;
     while ((err = glGetError()) != GL_NO_ERROR) {
         std::cerr << optionalTag << "OpenGL error: " << err
                   << std::endl;
         exit(1);
     }
+#endif
 }
 
 // ************************
 //  4. Main loop subsystem
 // ************************
 
+static uint64_t readClock()
+{
+#ifdef __USE_SDL
+    return SDL_GetPerformanceCounter();
+#elif defined(__USE_GLFW)
+    return glfwGetTimerValue();
+#endif
+}
+
+static uint64_t readClockFrequency()
+{
+#ifdef __USE_SDL
+    return SDL_GetPerformanceFrequency();
+#elif defined(__USE_GLFW)
+    return glfwGetTimerFrequency();
+#endif
+}
+
+static void tickFrameClock()
+{
+    uint64_t now = readClock();
+
+    // Benchmarks must animate the same way on every machine, so time
+    // advances by exactly one 60 Hz frame however long frames take
+    if (ctx.benchmark) {
+        ctx.deltaTime  = 1.0 / 60.0;
+        ctx.frameTime  = (double) ctx.frameIndex / 60.0;
+        ctx.frameStart = now;
+        ctx.frameIndex++;
+        return;
+    }
+
+    // Differences of ticks are exact, only the results are divided
+    ctx.deltaTime =
+        (double) (now - ctx.frameStart) / (double) ctx.clockFrequency;
+    ctx.frameTime =
+        (double) (now - ctx.clockStart) / (double) ctx.clockFrequency;
+    ctx.frameStart = now;
+    ctx.frameIndex++;
+}
+
+static void runFixedSteps()
+{
+    ctx.simAccumulator += ctx.deltaTime;
+    ctx.simSteps = 0;
+
+    while (ctx.simAccumulator >= ctx.fixedStep &&
+           ctx.simSteps < ctx.maxStepsPerFrame) {
+        ctx.simulate(&ctx, ctx.fixedStep);
+        ctx.simTime += ctx.fixedStep;
+        ctx.simAccumulator -= ctx.fixedStep;
+        ctx.simSteps++;
+    }
+
+    // Still behind after the catch-up limit, so give up on that time
+    if (ctx.simAccumulator >= ctx.fixedStep) {
+        ctx.simAccumulator = std::fmod(ctx.simAccumulator, ctx.fixedStep);
+    }
+
+    ctx.alpha = (float) (ctx.simAccumulator / ctx.fixedStep);
+}
+
 static void performOneCycle()
 {
     ctx.shouldContinue = true;
-    vtx::loop(&ctx);
+
+    // Waiting is not part of the frame, and input is taken after it
+    vtx::waitForNextFrame(&ctx.pacer);
+
+    vtx::beginProfilerFrame();
+    {
+        VTX_PROFILE_SCOPE("performOneCycle");
+
+        tickFrameClock();
+        vtx::resetArena(&ctx.frameArena);
+        vtx::pollInput(&ctx.input);
+        checkTraceHotkey();
+        if (ctx.simulate != nullptr) {
+            VTX_PROFILE_SCOPE("simulate");
+            runFixedSteps();
+        }
+
+        // GL is current here unless there is a render thread, which
+        // then uploads right before it draws
+        if (!ctx.renderThreaded && vtx::pendingAssetCount() > 0) {
+            VTX_PROFILE_SCOPE("uploadAssets");
+            vtx::uploadLoadedAssets();
+        }
+
+        {
+            VTX_PROFILE_SCOPE("loop");
+            vtx::loop(&ctx);
+        }
+
+        // loop() may have quit, then there is nothing to render
+        if (ctx.render != nullptr && ctx.shouldContinue) {
+            if (ctx.renderThreaded) {
+                VTX_PROFILE_SCOPE("publishFramePacket");
+                publishFramePacket();
+            } else {
+                latchFramePacket();
+                ctx.render(&ctx, ctx.framePackets[ctx.writingPacket]);
+            }
+        }
+    }
+    vtx::endProfilerFrame();
+
+    // The render thread closes its own frames. If loop() quit,
+    // exitVortex() took the GL context with it.
+    if (!ctx.renderThreaded && ctx.shouldContinue) {
+        vtx::endGLStateFrame();
+        vtx::advanceStreamBuffer(ctx.vertexStream);
+        vtx::advanceStreamBuffer(ctx.indexStream);
+    }
+
+    // frameStart is still the real time this frame started at
+    double frameMs = (double) (readClock() - ctx.frameStart) * 1000.0 /
+                     (double) ctx.clockFrequency;
+    int drawCalls = ctx.drawCalls.exchange(0, std::memory_order_relaxed);
+    vtx::recordFlightFrame(ctx.frameIndex, (float) frameMs, drawCalls);
+    if (ctx.benchmark) {
+        recordBenchmarkFrame(frameMs, drawCalls);
+    }
+}
+
+// F9 writes the trace so far, without waiting for the exit
+static void checkTraceHotkey()
+{
+    if (!vtx::isTraceEnabled()) return;
+
+    bool pressed = false;
+#ifdef __USE_SDL
+    for (const SDL_Event& event : ctx.input.events) {
+        if (event.type == SDL_KEYDOWN && !event.key.repeat &&
+            event.key.keysym.sym == SDLK_F9) {
+            pressed = true;
+        }
+    }
+#elif defined(__USE_GLFW)
+    static bool wasDown = false;
+    bool down = glfwGetKey(ctx.glfwWindow, GLFW_KEY_F9) == GLFW_PRESS;
+    pressed   = down && !wasDown;
+    wasDown   = down;
+#endif
+    if (pressed) vtx::writeTrace(tracer.path.c_str());
+}
+
+void vtx::setFixedTimestep(
+    vtx::VertexContext* ctx,
+    double stepSeconds,
+    int maxStepsPerFrame,
+    void (*simulate)(vtx::VertexContext* ctx, double stepSeconds)
+)
+{
+    ctx->fixedStep        = stepSeconds;
+    ctx->maxStepsPerFrame = maxStepsPerFrame;
+    ctx->simulate         = simulate;
+    ctx->simAccumulator   = 0.0;
+    ctx->simSteps         = 0;
+    ctx->alpha            = 0.0f;
 }
 
 void vtx::exitVortex()
 {
     ctx.shouldContinue = false;
+    stopRenderThread();  // gives the GL context back to this thread
+    // Loads under way are waited for, they may still use the workers
+    vtx::stopAssetLoader();
+    vtx::stopJobSystem(&jobSystem);
+    vtx::stopFramePacing(&ctx.pacer);
+    // Every thread that recorded is done by now
+    if (vtx::isTraceEnabled()) vtx::writeTrace(tracer.path.c_str());
+    vtx::destroyArena(&ctx.frameArena);
+    vtx::destroyStreamBuffer(&vertexStreamBuffer);
+    vtx::destroyStreamBuffer(&indexStreamBuffer);
+    vtx::reportGLDebugMessages();  // whatever came in after the last frame
+    destroyHeadlessFramebuffer();
+    // Objects still alive go with the context
+    vtx::loseGpuMemoryContext();
 #ifdef __USE_SDL
     SDL_GL_DeleteContext(ctx.sdlContext);
     SDL_DestroyWindow(ctx.sdlWindow);
@@ -337,10 +1036,15 @@ void vtx::exitVortex()
 void vtx::openVortex(int screenWidth, int screenHeight)
 {
     ctx.shouldContinue = true;
+    vtx::setTraceThreadName("main");
+    // Everything up to the first frame is one span of the trace
+    int64_t startupBegin =
+        vtx::isTraceEnabled() ? vtx::traceClock() : -1;
 
 
     ctx.screenWidth = screenWidth;
     ctx.screenHeight = screenHeight;
+    ctx.headless = readHeadlessSize(&ctx.screenWidth, &ctx.screenHeight);
 
     if (!initVideo(ctx.screenWidth, ctx.screenHeight)) {
         std::cerr << "Failed to initialize!" << std::endl;
@@ -348,7 +1052,44 @@ void vtx::openVortex(int screenWidth, int screenHeight)
         exit(1);
     }
 
-    init(&ctx);
+    ctx.clockFrequency = readClockFrequency();
+    readBenchmarkSettings();
+    vtx::startFramePacing(&ctx.pacer, ctx.benchmark);
+#ifdef __USE_GLFW
+    ctx.input.glfwWindow = ctx.glfwWindow;
+#endif
+
+    vtx::startJobSystem(&jobSystem, vtx::defaultJobWorkerCount());
+    ctx.jobs = &jobSystem;
+
+    vtx::createArena(&ctx.frameArena, VTX_FRAME_ARENA_SIZE);
+    ctx.frameMemory.arena = &ctx.frameArena;
+
+    vtx::createStreamBuffer(
+        &vertexStreamBuffer, GL_ARRAY_BUFFER, VTX_STREAM_VERTEX_SIZE
+    );
+    vtx::createStreamBuffer(
+        &indexStreamBuffer, GL_ELEMENT_ARRAY_BUFFER,
+        VTX_STREAM_INDEX_SIZE
+    );
+    ctx.vertexStream = &vertexStreamBuffer;
+    ctx.indexStream  = &indexStreamBuffer;
+
+    {
+        VTX_TRACE_SCOPE("init");
+        init(&ctx);
+    }
+    if (ctx.render != nullptr) startRenderThread();
+    if (startupBegin >= 0) {
+        vtx::recordTraceEvent(
+            "openVortex", startupBegin,
+            vtx::traceClock() - startupBegin, nullptr
+        );
+    }
+
+    // Loading in init() should not show up as the first frame delta
+    ctx.clockStart = readClock();
+    ctx.frameStart = ctx.clockStart;
 
 #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop(performOneCycle, 0, 1);
@@ -369,3 +1110,303 @@ void vtx::openVortex(int screenWidth, int screenHeight)
     //
     // The End.
 }
+
+// *************************
+//  5. Benchmark subsystem
+// *************************
+
+void vtx::drawElements(
+    GLenum mode,
+    GLsizei count,
+    GLenum type,
+    const void* indices
+)
+{
+    ctx.drawCalls.fetch_add(1, std::memory_order_relaxed);
+    glDrawElements(mode, count, type, indices);
+}
+
+void vtx::drawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    ctx.drawCalls.fetch_add(1, std::memory_order_relaxed);
+    glDrawArrays(mode, first, count);
+}
+
+static void readBenchmarkSettings()
+{
+    const char* frames = getenv("VTX_BENCHMARK_FRAMES");
+    if (frames == nullptr || atoi(frames) <= 0) return;
+
+    const char* warmup = getenv("VTX_BENCHMARK_WARMUP");
+    const char* output = getenv("VTX_BENCHMARK_OUTPUT");
+
+    ctx.benchmark       = true;
+    ctx.benchmarkFrames = atoi(frames);
+    ctx.benchmarkWarmup = warmup != nullptr ? atoi(warmup) : 60;
+    ctx.benchmarkOutput = output != nullptr ? output : "benchmark.json";
+
+    // Kept as a copy, the report may be written after the context is
+    // gone. Null when GL failed, which std::string does not take.
+    const char* renderer  = (const char*) glGetString(GL_RENDERER);
+    ctx.benchmarkRenderer = renderer != nullptr ? renderer : "unknown";
+    ctx.benchmarkFrameMs.reserve(ctx.benchmarkFrames);
+    ctx.benchmarkDrawCalls.reserve(ctx.benchmarkFrames);
+
+    std::cerr << "Benchmark: " << ctx.benchmarkWarmup << " warm-up and "
+              << ctx.benchmarkFrames << " measured frames" << std::endl;
+}
+
+static void recordBenchmarkFrame(double frameMs, int drawCalls)
+{
+    if (ctx.frameIndex > (uint64_t) ctx.benchmarkWarmup) {
+        ctx.benchmarkFrameMs.push_back(frameMs);
+        ctx.benchmarkDrawCalls.push_back(drawCalls);
+    }
+
+    bool finished =
+        (int) ctx.benchmarkFrameMs.size() >= ctx.benchmarkFrames;
+    if (finished || !ctx.shouldContinue) {
+        writeBenchmarkReport();
+        ctx.benchmark = false;  // report only once
+    }
+    if (finished && ctx.shouldContinue) {
+        vtx::exitVortex();
+#ifdef __EMSCRIPTEN__
+        emscripten_cancel_main_loop();
+#endif
+    }
+}
+
+static void writeBenchmarkReport()
+{
+    std::vector<double> sorted = ctx.benchmarkFrameMs;
+    std::sort(sorted.begin(), sorted.end());
+
+    // Nearest rank, so every reported number is a real frame
+    auto percentile = [&sorted](double p) -> double {
+        if (sorted.empty()) return 0.0;
+        size_t rank = (size_t) std::ceil(p * (double) sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+    };
+
+    double totalMs = 0.0;
+    for (double ms : sorted) totalMs += ms;
+    double meanMs     = sorted.empty() ? 0.0 : totalMs / sorted.size();
+    double varianceMs = 0.0;
+    for (double ms : sorted) varianceMs += (ms - meanMs) * (ms - meanMs);
+    if (!sorted.empty()) varianceMs /= sorted.size();
+    long totalDrawCalls = 0;
+    int maxDrawCalls    = 0;
+    for (int calls : ctx.benchmarkDrawCalls) {
+        totalDrawCalls += calls;
+        maxDrawCalls = std::max(maxDrawCalls, calls);
+    }
+    size_t n = sorted.size();
+
+    FILE* file = fopen(ctx.benchmarkOutput, "w");
+    if (file == nullptr) {
+        std::cerr << "Benchmark: cannot write " << ctx.benchmarkOutput
+                  << std::endl;
+        file = stdout;
+    }
+
+    fprintf(file, "{\n");
+    // Driver strings may hold quotes, escaped like trace names
+    fprintf(file, "  \"renderer\": ");
+    writeTraceString(file, ctx.benchmarkRenderer.c_str());
+    fprintf(file, ",\n");
+    fprintf(file, "  \"width\": %d,\n", ctx.screenWidth);
+    fprintf(file, "  \"height\": %d,\n", ctx.screenHeight);
+    fprintf(file, "  \"warmupFrames\": %d,\n", ctx.benchmarkWarmup);
+    fprintf(file, "  \"frames\": %zu,\n", n);
+    fprintf(file, "  \"frameMs\": {\n");
+    fprintf(file, "    \"min\": %.4f,\n", n ? sorted.front() : 0.0);
+    fprintf(file, "    \"median\": %.4f,\n", percentile(0.50));
+    fprintf(file, "    \"p95\": %.4f,\n", percentile(0.95));
+    fprintf(file, "    \"p99\": %.4f,\n", percentile(0.99));
+    fprintf(file, "    \"max\": %.4f,\n", n ? sorted.back() : 0.0);
+    fprintf(file, "    \"mean\": %.4f,\n", meanMs);
+    fprintf(file, "    \"stddev\": %.4f\n", std::sqrt(varianceMs));
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"drawCalls\": {\n");
+    fprintf(file, "    \"total\": %ld,\n", totalDrawCalls);
+    fprintf(
+        file, "    \"perFrame\": %.2f,\n",
+        n ? (double) totalDrawCalls / n : 0.0
+    );
+    fprintf(file, "    \"max\": %d\n", maxDrawCalls);
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+
+    if (file != stdout) {
+        fclose(file);
+        std::cerr << "Benchmark: report written to "
+                  << ctx.benchmarkOutput << std::endl;
+    }
+}
+
+// *****************************
+//  6. Render thread subsystem
+// *****************************
+
+void vtx::setRenderThread(
+    vtx::VertexContext* ctx,
+    vtx::FramePacket* packets[VTX_FRAME_PACKET_SLOTS],
+    void (*render)(vtx::VertexContext* ctx, vtx::FramePacket* packet)
+)
+{
+    for (int i = 0; i < VTX_FRAME_PACKET_SLOTS; i++) {
+        ctx->framePackets[i] = packets[i];
+    }
+    ctx->render        = render;
+    ctx->writingPacket = 0;
+    ctx->readyPacket.store(1, std::memory_order_relaxed);
+    ctx->readingPacket = 2;
+}
+
+static void startRenderThread()
+{
+#ifdef __EMSCRIPTEN__
+    // The browser only lets the main thread touch the WebGL context
+    ctx.renderThreaded = false;
+#else
+    const char* setting = getenv("VTX_RENDER_THREAD");
+    ctx.renderThreaded  = setting == nullptr || strcmp(setting, "0") != 0;
+    if (!ctx.renderThreaded) return;
+
+    // A context is current on one thread at a time
+    makeContextCurrent(false);
+    ctx.renderThread = std::thread(runRenderThread);
+#endif
+}
+
+static void stopRenderThread()
+{
+    if (!ctx.renderThreaded) return;
+
+    // Changing the value is what wakes a waiting render thread
+    ctx.readyPacket.fetch_or(
+        VTX_FRAME_PACKET_STOP, std::memory_order_acq_rel
+    );
+    ctx.readyPacket.notify_all();
+    ctx.renderThread.join();
+    // Only now, a frame it still swaps is one of its packets
+    ctx.renderThreaded = false;
+
+    makeContextCurrent(true);
+}
+
+static void makeContextCurrent(bool current)
+{
+#ifdef __USE_SDL
+    SDL_GL_MakeCurrent(
+        ctx.sdlWindow, current ? ctx.sdlContext : nullptr
+    );
+#elif defined(__USE_GLFW)
+    glfwMakeContextCurrent(current ? ctx.glfwWindow : nullptr);
+#endif
+}
+
+static void publishFramePacket()
+{
+    // At most one packet waits for the render thread, which keeps the
+    // main thread from simulating frames that would never be drawn
+    uint32_t ready = ctx.readyPacket.load(std::memory_order_acquire);
+    while (ready & VTX_FRAME_PACKET_NEW) {
+        ctx.readyPacket.wait(ready, std::memory_order_acquire);
+        ready = ctx.readyPacket.load(std::memory_order_acquire);
+    }
+
+    // Only now, the wait above would otherwise age the input
+    latchFramePacket();
+    ready = ctx.readyPacket.exchange(
+        ctx.writingPacket | VTX_FRAME_PACKET_NEW, std::memory_order_acq_rel
+    );
+    ctx.writingPacket = ready & (VTX_FRAME_PACKET_NEW - 1);
+    ctx.readyPacket.notify_one();
+}
+
+static void runRenderThread()
+{
+    makeContextCurrent(true);
+    vtx::setTraceThreadName("render");
+
+    for (;;) {
+        uint32_t ready = ctx.readyPacket.load(std::memory_order_acquire);
+        while (!(ready & (VTX_FRAME_PACKET_NEW | VTX_FRAME_PACKET_STOP))) {
+            ctx.readyPacket.wait(ready, std::memory_order_acquire);
+            ready = ctx.readyPacket.load(std::memory_order_acquire);
+        }
+        if (ready & VTX_FRAME_PACKET_STOP) break;
+
+        // Take the new packet and leave the one just drawn for writing.
+        // Only a stop request can change the value meanwhile, and that
+        // must not be overwritten, so this is not a plain exchange.
+        if (!ctx.readyPacket.compare_exchange_strong(
+                ready, ctx.readingPacket, std::memory_order_acq_rel,
+                std::memory_order_acquire
+            )) {
+            continue;
+        }
+        ctx.readingPacket = ready & (VTX_FRAME_PACKET_NEW - 1);
+        ctx.readyPacket.notify_one();
+
+        if (vtx::pendingAssetCount() > 0) {
+            VTX_TRACE_SCOPE("uploadAssets");
+            vtx::uploadLoadedAssets();
+        }
+        {
+            VTX_TRACE_SCOPE("render");
+            ctx.render(&ctx, ctx.framePackets[ctx.readingPacket]);
+        }
+        vtx::endGLStateFrame();
+        vtx::advanceStreamBuffer(ctx.vertexStream);
+        vtx::advanceStreamBuffer(ctx.indexStream);
+    }
+
+    makeContextCurrent(false);
+}
+
+// ***************
+//  Input latency
+// ***************
+
+void vtx::setLateLatch(
+    vtx::VertexContext* ctx,
+    void (*lateLatch)(vtx::VertexContext* ctx, vtx::FramePacket* packet)
+)
+{
+    ctx->lateLatch = lateLatch;
+}
+
+static void latchFramePacket()
+{
+    if (ctx.lateLatch != nullptr) {
+        VTX_PROFILE_SCOPE("lateLatch");
+        vtx::latchInput(&ctx.input);
+        ctx.lateLatch(&ctx, ctx.framePackets[ctx.writingPacket]);
+    }
+    ctx.packetInputTimes[ctx.writingPacket] = ctx.input.inputTime;
+}
+
+void vtx::swapWindow(vtx::VertexContext* ctx)
+{
+    VTX_PROFILE_SCOPE("swapWindow");
+#ifdef __USE_SDL
+    SDL_GL_SwapWindow(ctx->sdlWindow);
+#elif defined(__USE_GLFW)
+    glfwSwapBuffers(ctx->glfwWindow);
+#endif
+    vtx::limitFramesInFlight(&ctx->pacer);
+
+    // The render thread swaps the packet it took, otherwise the frame
+    // is the one loop() just made
+    uint64_t inputTime = ctx->renderThreaded
+                             ? ctx->packetInputTimes[ctx->readingPacket]
+                             : ctx->input.inputTime;
+    if (inputTime == 0) return;
+
+    float latency = (float) ((double) (readClock() - inputTime) *
+                             1000.0 / (double) ctx->clockFrequency);
+    ctx->inputLatency.store(latency, std::memory_order_relaxed);
+}
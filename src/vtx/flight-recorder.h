@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "./profiler.h"
+#include "./trace.h"
+
+// Frames the recorder remembers, a hitch writes all of them
+#define VTX_FLIGHT_FRAMES (300)
+// Profiler scopes kept of each frame, the outermost ones come first
+#define VTX_FLIGHT_SCOPES (32)
+// The median frame time is worked out again every this many frames
+#define VTX_FLIGHT_MEDIAN_EVERY (30)
+// Frames recorded before anything counts as a hitch, loading makes
+// the first ones slow
+#define VTX_HITCH_WARMUP (60)
+// Frames after a dump before the next one, writing it may hitch too
+#define VTX_HITCH_COOLDOWN (60)
+// A hitch takes this many times the median frame time
+#define VTX_HITCH_FACTOR (2.0f)
+// and at least this long, so fast frames do not count, half a 60 Hz
+// frame
+#define VTX_HITCH_MIN_MS (8.0f)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+struct FlightScope {
+    const char* name;
+    int depth;
+    float startMs;  // since the frame started
+    float ms;
+};
+
+struct FlightFrame {
+    uint64_t frameIndex;
+    float frameMs;  // from the end of the wait to the end of the frame
+    int drawCalls;
+    int scopeCount;
+    FlightScope scopes[VTX_FLIGHT_SCOPES];
+};
+
+struct FlightRecorder {
+    // -1 until VTX_HITCH_REPORT is first looked at, then 0 or 1
+    int enabled = -1;
+    std::string path;  // dumps go to path-FRAME.json
+    float factor    = VTX_HITCH_FACTOR;
+    float minimumMs = VTX_HITCH_MIN_MS;
+
+    FlightFrame frames[VTX_FLIGHT_FRAMES];
+    int head          = 0;  // the slot the next frame goes into
+    uint64_t recorded = 0;
+    float medianMs    = 0.0f;
+    int cooldown      = 0;
+    int dumps         = 0;
+    std::vector<float> sorting;  // kept so the median does not allocate
+};
+
+// Recording is on when VTX_HITCH_REPORT names where dumps go. Then
+// VTX_HITCH_FACTOR and VTX_HITCH_MIN_MS override the threshold.
+bool isFlightRecorderEnabled();
+
+// A frame is a hitch when it takes more than factor times the median
+// frame time, and more than minimumMs
+void setHitchThreshold(float factor, float minimumMs);
+
+// Once per frame, after vtx::endProfilerFrame(), which ctx.h does.
+// The scopes of the frame are taken from the profiler.
+void recordFlightFrame(
+    uint64_t frameIndex,
+    float frameMs,
+    int drawCalls
+);
+
+// Writes the recorded frames as JSON, oldest first, with the frame
+// that hitched, 0 when there is none. Hitches do this on their own, it
+// is here to take a dump by hand.
+bool writeFlightRecord(const char* path, uint64_t hitchFrame);
+}  // namespace vtx
+
+static void updateFlightMedian();
+
+// **********************
+//  Global state context
+// **********************
+
+static vtx::FlightRecorder flightRecorder;
+
+// *****************
+//  Flight recorder
+// *****************
+
+bool vtx::isFlightRecorderEnabled()
+{
+    if (flightRecorder.enabled >= 0) return flightRecorder.enabled == 1;
+
+    const char* path   = getenv("VTX_HITCH_REPORT");
+    const char* factor = getenv("VTX_HITCH_FACTOR");
+    const char* minMs  = getenv("VTX_HITCH_MIN_MS");
+    if (path != nullptr && path[0] != '\0') flightRecorder.path = path;
+    if (factor != nullptr) flightRecorder.factor = (float) atof(factor);
+    if (minMs != nullptr) {
+        flightRecorder.minimumMs = (float) atof(minMs);
+    }
+    flightRecorder.sorting.reserve(VTX_FLIGHT_FRAMES);
+
+    flightRecorder.enabled = flightRecorder.path.empty() ? 0 : 1;
+    return flightRecorder.enabled == 1;
+}
+
+void vtx::setHitchThreshold(float factor, float minimumMs)
+{
+    flightRecorder.factor    = factor;
+    flightRecorder.minimumMs = minimumMs;
+}
+
+static void updateFlightMedian()
+{
+    int count = (int) std::min(
+        flightRecorder.recorded, (uint64_t) VTX_FLIGHT_FRAMES
+    );
+    flightRecorder.sorting.clear();
+    for (int i = 0; i < count; i++) {
+        flightRecorder.sorting.push_back(
+            flightRecorder.frames[i].frameMs
+        );
+    }
+    auto middle = flightRecorder.sorting.begin() + count / 2;
+    std::nth_element(
+        flightRecorder.sorting.begin(), middle,
+        flightRecorder.sorting.end()
+    );
+    flightRecorder.medianMs = *middle;
+}
+
+void vtx::recordFlightFrame(
+    uint64_t frameIndex,
+    float frameMs,
+    int drawCalls
+)
+{
+    if (!vtx::isFlightRecorderEnabled()) return;
+
+    vtx::FlightFrame* frame =
+        &flightRecorder.frames[flightRecorder.head];
+    frame->frameIndex = frameIndex;
+    frame->frameMs    = frameMs;
+    frame->drawCalls  = drawCalls;
+    frame->scopeCount = 0;
+
+    // The profiler frame just closed, its GPU times come much later
+    // and are left out
+    if (profiler.enabled) {
+        const vtx::ProfileFrame* profiled =
+            &profiler.frames[profiler.current];
+        int count = std::min(profiled->scopeCount, VTX_FLIGHT_SCOPES);
+        for (int i = 0; i < count; i++) {
+            const vtx::ProfileScope* scope = &profiled->scopes[i];
+            frame->scopes[i]               = {
+                scope->name, scope->depth, (float) scope->cpuStart,
+                (float) (scope->cpuEnd - scope->cpuStart)
+            };
+        }
+        frame->scopeCount = count;
+    }
+
+    flightRecorder.head = (flightRecorder.head + 1) % VTX_FLIGHT_FRAMES;
+    flightRecorder.recorded++;
+    if (flightRecorder.recorded % VTX_FLIGHT_MEDIAN_EVERY == 0) {
+        updateFlightMedian();
+    }
+
+    if (flightRecorder.cooldown > 0) {
+        flightRecorder.cooldown--;
+        return;
+    }
+    if (flightRecorder.recorded < VTX_HITCH_WARMUP) return;
+
+    float threshold = std::max(
+        flightRecorder.medianMs * flightRecorder.factor,
+        flightRecorder.minimumMs
+    );
+    if (frameMs <= threshold) return;
+
+    VTX_TRACE_INSTANT("hitch");
+    char path[512];
+    snprintf(
+        path, sizeof(path), "%s-%llu.json", flightRecorder.path.c_str(),
+        (unsigned long long) frameIndex
+    );
+    std::cerr << "Hitch: frame " << frameIndex << " took " << frameMs
+              << " ms, the median is " << flightRecorder.medianMs
+              << " ms" << std::endl;
+    vtx::writeFlightRecord(path, frameIndex);
+    flightRecorder.cooldown = VTX_HITCH_COOLDOWN;
+    flightRecorder.dumps++;
+}
+
+bool vtx::writeFlightRecord(const char* path, uint64_t hitchFrame)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        std::cerr << "Could not write flight record to " << path
+                  << std::endl;
+        return false;
+    }
+
+    int count = (int) std::min(
+        flightRecorder.recorded, (uint64_t) VTX_FLIGHT_FRAMES
+    );
+    // The oldest frame is where the next one goes, unless the ring is
+    // not full yet
+    int first = count < VTX_FLIGHT_FRAMES ? 0 : flightRecorder.head;
+    float threshold = std::max(
+        flightRecorder.medianMs * flightRecorder.factor,
+        flightRecorder.minimumMs
+    );
+
+    fprintf(file, "{\n");
+    fprintf(
+        file, "  \"hitchFrame\": %llu,\n",
+        (unsigned long long) hitchFrame
+    );
+    fprintf(file, "  \"medianMs\": %.3f,\n", flightRecorder.medianMs);
+    fprintf(file, "  \"thresholdMs\": %.3f,\n", threshold);
+    fprintf(file, "  \"frames\": [\n");
+    for (int i = 0; i < count; i++) {
+        const vtx::FlightFrame* frame =
+            &flightRecorder.frames[(first + i) % VTX_FLIGHT_FRAMES];
+        fprintf(
+            file,
+            "    {\"frame\": %llu, \"frameMs\": %.3f, "
+            "\"drawCalls\": %d, \"scopes\": [",
+            (unsigned long long) frame->frameIndex, frame->frameMs,
+            frame->drawCalls
+        );
+        for (int s = 0; s < frame->scopeCount; s++) {
+            const vtx::FlightScope* scope = &frame->scopes[s];
+            fprintf(
+                file,
+                "%s{\"name\": \"%s\", \"depth\": %d, "
+                "\"startMs\": %.3f, \"ms\": %.3f}",
+                s > 0 ? ", " : "", scope->name, scope->depth,
+                scope->startMs, scope->ms
+            );
+        }
+        fprintf(file, "]}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+
+    std::cerr << "Flight record written to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "./gl-state.h"
+#include "./gpu-memory.h"
+
+// Uniform buffer binding point the FrameConstants block is read from
+#define VTX_FRAME_CONSTANTS_BINDING (0)
+
+// The block as shaders declare it, goes right after the #version line:
+//     "#version 330 core" VTX_FRAME_CONSTANTS_GLSL R"( ... )"
+// See vtx::FrameConstants for what the members hold. They are highp so
+// vertex and fragment stages agree under GLES.
+#define VTX_FRAME_CONSTANTS_GLSL                                       \
+    "\nlayout(std140) uniform FrameConstants {\n"                      \
+    "    highp mat4 u_worldToView;\n"                                  \
+    "    highp mat4 u_projection;\n"                                   \
+    "    highp mat4 u_viewProjection;\n"                               \
+    "    highp vec4 u_cameraPosition;\n"                               \
+    "    highp vec4 u_frameTime;\n"                                    \
+    "    highp vec4 u_viewport;\n"                                     \
+    "};"
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// What every camera-relative shader reads once per frame, laid out as
+// std140 so it can be copied into the buffer as it is
+struct FrameConstants {
+    glm::mat4 worldToView;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition;  // w is 1
+    glm::vec4 frameTime;       // x seconds, y seconds since last frame
+    glm::vec4 viewport;        // width, height, 1/width, 1/height
+};
+static_assert(
+    sizeof(FrameConstants) == 240, "FrameConstants must match std140"
+);
+
+// Points the FrameConstants block of the program, if it has one, at
+// VTX_FRAME_CONSTANTS_BINDING. Linking resets block bindings, so this
+// runs after every link and every binary load.
+void bindFrameConstantsBlock(GLuint program);
+
+// Fills the frame constants buffer, once per frame before the first
+// draw. The buffer is orphaned each time, frames still in flight keep
+// reading their own copy.
+void writeFrameConstants(
+    const glm::mat4& worldToView,
+    const glm::mat4& projection,
+    double time,
+    double deltaTime,
+    int width,
+    int height
+);
+}  // namespace vtx
+
+// **********************
+//  Global state context
+// **********************
+
+static GLuint frameConstantsBuffer;
+static vtx::FrameConstants frameConstants;
+
+// *****************
+//  Frame constants
+// *****************
+
+void vtx::bindFrameConstantsBlock(GLuint program)
+{
+    GLuint index = glGetUniformBlockIndex(program, "FrameConstants");
+    if (index == GL_INVALID_INDEX) return;
+    glUniformBlockBinding(program, index, VTX_FRAME_CONSTANTS_BINDING);
+}
+
+void vtx::writeFrameConstants(
+    const glm::mat4& worldToView,
+    const glm::mat4& projection,
+    double time,
+    double deltaTime,
+    int width,
+    int height
+)
+{
+    frameConstants.worldToView    = worldToView;
+    frameConstants.projection     = projection;
+    frameConstants.viewProjection = projection * worldToView;
+    // The camera sits at the origin of view space
+    frameConstants.cameraPosition = glm::inverse(worldToView)[3];
+    frameConstants.frameTime =
+        glm::vec4((float) time, (float) deltaTime, 0.0f, 0.0f);
+    frameConstants.viewport = glm::vec4(
+        (float) width, (float) height, 1.0f / (float) width,
+        1.0f / (float) height
+    );
+
+    if (frameConstantsBuffer == 0) {
+        glGenBuffers(1, &frameConstantsBuffer);
+        vtx::bindBuffer(GL_UNIFORM_BUFFER, frameConstantsBuffer);
+        glBufferData(
+            GL_UNIFORM_BUFFER, sizeof(vtx::FrameConstants), nullptr,
+            GL_DYNAMIC_DRAW
+        );
+        vtx::trackGpuAllocation(
+            GL_BUFFER, frameConstantsBuffer, vtx::GPU_MEMORY_UNIFORMS,
+            sizeof(vtx::FrameConstants), GL_DYNAMIC_DRAW, 0, 0,
+            "frame constants"
+        );
+        // Nothing else uses this binding point, set once
+        glBindBufferBase(
+            GL_UNIFORM_BUFFER, VTX_FRAME_CONSTANTS_BINDING,
+            frameConstantsBuffer
+        );
+    }
+
+    vtx::bindBuffer(GL_UNIFORM_BUFFER, frameConstantsBuffer);
+    glBufferData(
+        GL_UNIFORM_BUFFER, sizeof(vtx::FrameConstants), &frameConstants,
+        GL_DYNAMIC_DRAW
+    );
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "./ctx.h"
+#include "./render-queue.h"
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// Everything render() needs to draw one frame, written by loop() and
+// only read once published. The camera reaches the shaders through
+// vtx::writeFrameConstants() in render(). Bone palettes travel as per
+// draw uniform arrays of the draw list. Derive from it to carry more,
+// like ImGui draw lists.
+struct FramePacket {
+    uint64_t frameIndex;
+    double frameTime;
+    double deltaTime;
+    float alpha;  // see VertexContext::alpha
+    int screenWidth, screenHeight;
+    glm::mat4 worldToView;
+    glm::mat4 projection;
+    RenderQueue drawList;
+};
+
+// The packet loop() fills in this frame, emptied and stamped with the
+// frame clock. Packet is the type given to vtx::setRenderThread().
+template <typename Packet>
+Packet* beginFramePacket(vtx::VertexContext* ctx);
+}  // namespace vtx
+
+// ***************
+//  Frame packets
+// ***************
+
+template <typename Packet>
+Packet* vtx::beginFramePacket(vtx::VertexContext* ctx)
+{
+    Packet* packet =
+        static_cast<Packet*>(ctx->framePackets[ctx->writingPacket]);
+    packet->frameIndex   = ctx->frameIndex;
+    packet->frameTime    = ctx->frameTime;
+    packet->deltaTime    = ctx->deltaTime;
+    packet->alpha        = ctx->alpha;
+    packet->screenWidth  = ctx->screenWidth;
+    packet->screenHeight = ctx->screenHeight;
+    packet->drawList.clear();
+    return packet;
+}
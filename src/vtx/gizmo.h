@@ -3,6 +3,7 @@
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
 #include "./ctx.h"
+#include "./shader-program.h"
 #include <glm/glm.hpp>
 
 struct Gizmo {
@@ -42,22 +43,22 @@ struct Gizmo {
     // clang-format on
 
     GLuint gizmoVAO;
-    GLuint gizmoShader;
+    vtx::GpuBuffer gizmoVBO;
+    vtx::ShaderProgram gizmoShader;
+    vtx::UniformHandle modelToWorldUniform = "u_modelToWorld";
 
     Gizmo() {}  // End of constructor Gizmo
 
     void init()
     {
         glGenVertexArrays(1, &gizmoVAO);
-        glBindVertexArray(this->gizmoVAO);
+        vtx::bindVertexArray(this->gizmoVAO);
+        vtx::labelObject(GL_VERTEX_ARRAY, this->gizmoVAO, "gizmo");
 
         // Create a vertex buffer for gizmo
-        GLuint gizmoVBO;
-        glGenBuffers(1, &gizmoVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, gizmoVBO);
-        glBufferData(
+        this->gizmoVBO.create(
             GL_ARRAY_BUFFER, sizeof(gizmoVertices), gizmoVertices,
-            GL_STATIC_DRAW
+            GL_STATIC_DRAW, "gizmo"
         );
         // Enable vertex attribute and bind it to shader location
         glVertexAttribPointer(
@@ -70,71 +71,36 @@ struct Gizmo {
         glEnableVertexAttribArray(0);
         glEnableVertexAttribArray(1);
 
-        glBindVertexArray(0);                      // VAO
-        glBindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
+        vtx::bindVertexArray(0);                      // VAO
+        vtx::bindBuffer(GL_ARRAY_BUFFER, 0);          // VBO
+        vtx::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);  // EBO
 
-        this->gizmoShader = vtx::createShaderProgram(
-            GIZMO_VERTEX_SHADER, GIZMO_FRAGMENT_SHADER
-        );
-    }
-
-    void updateProjectionMatrix(const glm::mat4 projectionMatrix) const
-    {
-        glUseProgram(this->gizmoShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->gizmoShader, "u_projection"
-            ),                                // uniform location
-            1,                                // number of matrices
-            GL_FALSE,                         // transpose
-            glm::value_ptr(projectionMatrix)  // value
+        this->gizmoShader.create(
+            GIZMO_VERTEX_SHADER, GIZMO_FRAGMENT_SHADER, "gizmo"
         );
     }
 
     void updateTransformationMatrix(const glm::mat4 transformationMatrix
     ) const
     {
-        glUseProgram(this->gizmoShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->gizmoShader, "u_modelToWorld"
-            ),                                    // uniform location
-            1,                                    // number of matrices
-            GL_FALSE,                             // transpose
-            glm::value_ptr(transformationMatrix)  // value
-        );
-    }
-
-    void updateViewMatrix(const glm::mat4 viewMatrix) const
-    {
-        glUseProgram(this->gizmoShader);
-
-        glUniformMatrix4fv(
-            glGetUniformLocation(
-                this->gizmoShader, "u_worldToView"
-            ),                          // uniform location
-            1,                          // number of matrices
-            GL_FALSE,                   // transpose
-            glm::value_ptr(viewMatrix)  // value
+        this->gizmoShader.set(
+            this->modelToWorldUniform, transformationMatrix
         );
     }
 
     void draw() const
     {
-        glUseProgram(this->gizmoShader);
-        glBindVertexArray(this->gizmoVAO);
+        this->gizmoShader.use();
+        vtx::bindVertexArray(this->gizmoVAO);
 
-        glDrawArrays(
+        vtx::drawArrays(
             GL_TRIANGLES,  // Only this is supported in GLES
             0,             // Start from
             sizeof(gizmoVertices) /
                 (4 * sizeof(GLfloat))  // total size / one vertex size
         );
 
-        glBindVertexArray(0);
+        vtx::bindVertexArray(0);
     }
 
 };  // end of Gizmo
@@ -145,6 +111,7 @@ const char* Gizmo::GIZMO_VERTEX_SHADER =
 #else
     "#version 330 core"
 #endif
+    VTX_FRAME_CONSTANTS_GLSL
     R"(
     precision mediump float;
 
@@ -154,8 +121,6 @@ const char* Gizmo::GIZMO_VERTEX_SHADER =
     out float v_direction;
 
     uniform mat4 u_modelToWorld;
-    uniform mat4 u_worldToView;  // World to View matrix
-    uniform mat4 u_projection;   // Projection matrix
 
     void main() {
         v_direction = a_direction;
@@ -163,7 +128,7 @@ const char* Gizmo::GIZMO_VERTEX_SHADER =
         // Transform the vertex position from world space to view space
         // and then to clip space
         vec3 crntPos = vec3(u_modelToWorld * vec4(a_position, 1.0f));
-        gl_Position  = u_projection * u_worldToView * vec4(crntPos, 1.0f);
+        gl_Position  = u_viewProjection * vec4(crntPos, 1.0f);
     }
     )";
 
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// WebGL has no KHR_debug, there only the strict glGetError() polling
+// of checkOpenGLError() is left.
+#ifndef __EMSCRIPTEN__
+#define VTX_GL_DEBUG_OUTPUT
+#endif
+
+// Messages waiting to be reported, must be a power of two
+#define VTX_GL_DEBUG_RING (64)
+// Longer messages are cut, drivers rarely go over this
+#define VTX_GL_DEBUG_MESSAGE_LENGTH (256)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+struct GLDebugMessage {
+    std::atomic<uint32_t> sequence;  // which lap of the ring owns it
+    GLenum source;
+    GLenum type;
+    GLenum severity;
+    GLuint id;
+    char text[VTX_GL_DEBUG_MESSAGE_LENGTH];
+};
+
+// Messages are written by the driver callback, which may run on any
+// of the driver's threads, and read once per frame by the main thread,
+// so the ring is a bounded multi producer queue without locks.
+struct GLDebugRing {
+    GLDebugMessage messages[VTX_GL_DEBUG_RING];
+    std::atomic<uint32_t> writeIndex;
+    uint32_t readIndex;
+    std::atomic<uint32_t> dropped;  // lost because the ring was full
+    bool installed;
+};
+
+// True when VTX_GL_DEBUG=1 asks for a debug context, which makes the
+// driver report much more than a normal context does
+bool isGLDebugContextRequested();
+
+// Installs the KHR_debug callback when the context has it, call once
+// after glewInit()
+void enableGLDebugOutput();
+
+// Prints the messages buffered since the last call, returns how many
+// of them were errors. Never calls into GL, so it does not stall.
+int reportGLDebugMessages();
+
+// Same as glObjectLabel(), drivers then name the object by its label
+// in their messages. Does nothing without KHR_debug.
+void labelObject(GLenum identifier, GLuint name, const char* label);
+}  // namespace vtx
+
+#ifdef VTX_GL_DEBUG_OUTPUT
+static void resetGLDebugRing();
+static void GLAPIENTRY onGLDebugMessage(
+    GLenum source,
+    GLenum type,
+    GLuint id,
+    GLenum severity,
+    GLsizei length,
+    const GLchar* message,
+    const void* userParam
+);
+static const char* glDebugSourceName(GLenum source);
+static const char* glDebugTypeName(GLenum type);
+static const char* glDebugSeverityName(GLenum severity);
+#endif
+
+// **********************
+//  Global state context
+// **********************
+
+static vtx::GLDebugRing glDebugRing;
+
+// ***************
+//  Driver output
+// ***************
+
+bool vtx::isGLDebugContextRequested()
+{
+#ifdef VTX_GL_DEBUG_OUTPUT
+    const char* setting = getenv("VTX_GL_DEBUG");
+    return setting != nullptr && strcmp(setting, "1") == 0;
+#else
+    return false;
+#endif
+}
+
+#ifdef VTX_GL_DEBUG_OUTPUT
+static void resetGLDebugRing()
+{
+    for (uint32_t i = 0; i < VTX_GL_DEBUG_RING; i++) {
+        glDebugRing.messages[i].sequence.store(
+            i, std::memory_order_relaxed
+        );
+    }
+    glDebugRing.writeIndex.store(0, std::memory_order_relaxed);
+    glDebugRing.readIndex = 0;
+    glDebugRing.dropped.store(0, std::memory_order_relaxed);
+}
+#endif
+
+void vtx::enableGLDebugOutput()
+{
+#ifdef VTX_GL_DEBUG_OUTPUT
+    // Core since 4.3, a 3.3 context needs the extension
+    if (!GLEW_VERSION_4_3 && !GLEW_KHR_debug) {
+        std::cerr << "KHR_debug not available, GL errors are only seen "
+                     "with VTX_STRICT_GL_ERRORS"
+                  << std::endl;
+        return;
+    }
+
+    resetGLDebugRing();
+    glDebugMessageCallback(onGLDebugMessage, nullptr);
+    glEnable(GL_DEBUG_OUTPUT);
+
+#ifdef VTX_STRICT_GL_ERRORS
+    // Messages then come from inside the failing call, which is what a
+    // breakpoint in onGLDebugMessage() wants, but it costs throughput
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+
+    // Notifications are chatty (buffer placement and such), they are
+    // only wanted when a debug context was asked for
+    if (!vtx::isGLDebugContextRequested()) {
+        glDebugMessageControl(
+            GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0,
+            nullptr, GL_FALSE
+        );
+    }
+    glDebugRing.installed = true;
+#endif
+}
+
+#ifdef VTX_GL_DEBUG_OUTPUT
+static void GLAPIENTRY onGLDebugMessage(
+    GLenum source,
+    GLenum type,
+    GLuint id,
+    GLenum severity,
+    GLsizei length,
+    const GLchar* message,
+    const void* userParam
+)
+{
+    (void) userParam;
+
+    // Claim a slot, or give up when the reader is a whole ring behind
+    uint32_t index = glDebugRing.writeIndex.load(std::memory_order_relaxed);
+    vtx::GLDebugMessage* slot;
+    for (;;) {
+        slot = &glDebugRing.messages[index & (VTX_GL_DEBUG_RING - 1)];
+        uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int32_t lap       = (int32_t) (sequence - index);
+        if (lap == 0) {
+            if (glDebugRing.writeIndex.compare_exchange_weak(
+                    index, index + 1, std::memory_order_relaxed
+                )) {
+                break;
+            }
+        } else if (lap < 0) {
+            glDebugRing.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            index = glDebugRing.writeIndex.load(std::memory_order_relaxed);
+        }
+    }
+
+    if (length < 0) length = (GLsizei) strlen(message);
+    size_t copied = std::min(
+        (size_t) length, (size_t) VTX_GL_DEBUG_MESSAGE_LENGTH - 1
+    );
+    memcpy(slot->text, message, copied);
+    slot->text[copied] = '\0';
+    slot->source       = source;
+    slot->type         = type;
+    slot->severity     = severity;
+    slot->id           = id;
+
+    // Publish, the reader only looks at slots whose lap is done
+    slot->sequence.store(index + 1, std::memory_order_release);
+}
+#endif
+
+int vtx::reportGLDebugMessages()
+{
+    int errors = 0;
+#ifdef VTX_GL_DEBUG_OUTPUT
+    if (!glDebugRing.installed) return 0;
+
+    for (;;) {
+        uint32_t index = glDebugRing.readIndex;
+        vtx::GLDebugMessage* slot =
+            &glDebugRing.messages[index & (VTX_GL_DEBUG_RING - 1)];
+        if (slot->sequence.load(std::memory_order_acquire) != index + 1) {
+            break;
+        }
+
+        std::cerr << "GL " << glDebugSeverityName(slot->severity) << " "
+                  << glDebugTypeName(slot->type) << " from "
+                  << glDebugSourceName(slot->source) << " (" << slot->id
+                  << "): " << slot->text << std::endl;
+        if (slot->type == GL_DEBUG_TYPE_ERROR) errors++;
+
+        // Hand the slot back to writers for the next lap
+        slot->sequence.store(
+            index + VTX_GL_DEBUG_RING, std::memory_order_release
+        );
+        glDebugRing.readIndex = index + 1;
+    }
+
+    uint32_t dropped =
+        glDebugRing.dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        std::cerr << "GL debug: " << dropped
+                  << " messages dropped, the ring was full" << std::endl;
+    }
+#endif
+    return errors;
+}
+
+void vtx::labelObject(GLenum identifier, GLuint name, const char* label)
+{
+#ifdef VTX_GL_DEBUG_OUTPUT
+    if (!glDebugRing.installed) return;
+    glObjectLabel(identifier, name, -1, label);
+#else
+    (void) identifier, (void) name, (void) label;
+#endif
+}
+
+// *****************
+//  Message strings
+// *****************
+
+#ifdef VTX_GL_DEBUG_OUTPUT
+static const char* glDebugSourceName(GLenum source)
+{
+    switch (source) {
+        case GL_DEBUG_SOURCE_API:
+            return "API";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+            return "window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER:
+            return "shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY:
+            return "third party";
+        case GL_DEBUG_SOURCE_APPLICATION:
+            return "application";
+    }
+    return "other";
+}
+
+static const char* glDebugTypeName(GLenum type)
+{
+    switch (type) {
+        case GL_DEBUG_TYPE_ERROR:
+            return "error";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+            return "deprecated";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+            return "undefined behavior";
+        case GL_DEBUG_TYPE_PORTABILITY:
+            return "portability";
+        case GL_DEBUG_TYPE_PERFORMANCE:
+            return "performance";
+    }
+    return "message";
+}
+
+static const char* glDebugSeverityName(GLenum severity)
+{
+    switch (severity) {
+        case GL_DEBUG_SEVERITY_HIGH:
+            return "high";
+        case GL_DEBUG_SEVERITY_MEDIUM:
+            return "medium";
+        case GL_DEBUG_SEVERITY_LOW:
+            return "low";
+    }
+    return "info";
+}
+#endif
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+
+// Texture units whose bindings are shadowed, higher units pass through
+#define VTX_GL_STATE_TEXTURE_UNITS (16)
+
+// Marks a binding that is not known, so the next bind always goes out
+#define VTX_GL_STATE_UNKNOWN (0xFFFFFFFFu)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// Shadow of the GL bindings we change most, calls that would set a
+// binding to what it already is are skipped.
+struct GLState {
+    GLuint program;
+    GLuint vertexArray;
+    GLuint arrayBuffer;
+    GLuint elementArrayBuffer;  // part of the VAO, reset with it
+    GLuint uniformBuffer;
+    GLenum activeTexture;  // GL_TEXTURE0 + unit
+    GLuint texture2D[VTX_GL_STATE_TEXTURE_UNITS];
+
+    // Capabilities, 0 off, 1 on, VTX_GL_STATE_UNKNOWN not known
+    GLuint blend;
+    GLuint depthTest;
+    GLuint cullFace;
+    GLuint scissorTest;
+    GLenum blendSrc, blendDst;
+    GLenum depthFunc;
+    GLuint depthMask;
+
+    // Counted since the frame started, and for the last whole frame
+    uint64_t issued, skipped;
+    uint64_t lastFrameIssued, lastFrameSkipped;
+};
+
+void useProgramCached(GLuint program);
+void bindVertexArray(GLuint vertexArray);
+void bindBuffer(GLenum target, GLuint buffer);
+void activeTexture(GLenum unit);
+void bindTexture(GLenum target, GLuint texture);
+void enable(GLenum capability);
+void disable(GLenum capability);
+void blendFunc(GLenum src, GLenum dst);
+void depthFunc(GLenum func);
+void depthMask(GLboolean flag);
+
+// Forget everything, call after code that changes GL state behind our
+// back (ImGui rendering, third party code) and after deleting objects
+// that may still be bound
+void invalidateGLState();
+
+// Moves the counters of this frame to lastFrame*, once per frame
+void endGLStateFrame();
+}  // namespace vtx
+
+static GLuint* capabilitySlot(GLenum capability);
+
+// **********************
+//  Global state context
+// **********************
+
+// Everything is unknown until vtx::invalidateGLState() is first called
+// once the context exists, which initVideo() does
+static vtx::GLState glState;
+
+// ****************
+//  Cached binding
+// ****************
+
+void vtx::invalidateGLState()
+{
+    glState.program            = VTX_GL_STATE_UNKNOWN;
+    glState.vertexArray        = VTX_GL_STATE_UNKNOWN;
+    glState.arrayBuffer        = VTX_GL_STATE_UNKNOWN;
+    glState.elementArrayBuffer = VTX_GL_STATE_UNKNOWN;
+    glState.uniformBuffer      = VTX_GL_STATE_UNKNOWN;
+    glState.activeTexture      = VTX_GL_STATE_UNKNOWN;
+    for (int i = 0; i < VTX_GL_STATE_TEXTURE_UNITS; i++) {
+        glState.texture2D[i] = VTX_GL_STATE_UNKNOWN;
+    }
+    glState.blend       = VTX_GL_STATE_UNKNOWN;
+    glState.depthTest   = VTX_GL_STATE_UNKNOWN;
+    glState.cullFace    = VTX_GL_STATE_UNKNOWN;
+    glState.scissorTest = VTX_GL_STATE_UNKNOWN;
+    glState.blendSrc    = VTX_GL_STATE_UNKNOWN;
+    glState.blendDst    = VTX_GL_STATE_UNKNOWN;
+    glState.depthFunc   = VTX_GL_STATE_UNKNOWN;
+    glState.depthMask   = VTX_GL_STATE_UNKNOWN;
+}
+
+void vtx::endGLStateFrame()
+{
+    glState.lastFrameIssued  = glState.issued;
+    glState.lastFrameSkipped = glState.skipped;
+    glState.issued           = 0;
+    glState.skipped          = 0;
+}
+
+void vtx::useProgramCached(GLuint program)
+{
+    if (glState.program == program) {
+        glState.skipped++;
+        return;
+    }
+    glUseProgram(program);
+    glState.program = program;
+    glState.issued++;
+}
+
+void vtx::bindVertexArray(GLuint vertexArray)
+{
+    if (glState.vertexArray == vertexArray) {
+        glState.skipped++;
+        return;
+    }
+    glBindVertexArray(vertexArray);
+    glState.vertexArray = vertexArray;
+    // Each VAO has its own element buffer binding
+    glState.elementArrayBuffer = VTX_GL_STATE_UNKNOWN;
+    glState.issued++;
+}
+
+void vtx::bindBuffer(GLenum target, GLuint buffer)
+{
+    GLuint* slot = nullptr;
+    switch (target) {
+        case GL_ARRAY_BUFFER:
+            slot = &glState.arrayBuffer;
+            break;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            slot = &glState.elementArrayBuffer;
+            break;
+        case GL_UNIFORM_BUFFER:
+            slot = &glState.uniformBuffer;
+            break;
+    }
+
+    if (slot != nullptr && *slot == buffer) {
+        glState.skipped++;
+        return;
+    }
+    glBindBuffer(target, buffer);
+    if (slot != nullptr) *slot = buffer;
+    glState.issued++;
+}
+
+void vtx::activeTexture(GLenum unit)
+{
+    if (glState.activeTexture == unit) {
+        glState.skipped++;
+        return;
+    }
+    glActiveTexture(unit);
+    glState.activeTexture = unit;
+    glState.issued++;
+}
+
+void vtx::bindTexture(GLenum target, GLuint texture)
+{
+    // Only 2D textures on the first units are shadowed, anything else
+    // goes straight to GL
+    GLuint* slot = nullptr;
+    if (target == GL_TEXTURE_2D &&
+        glState.activeTexture != VTX_GL_STATE_UNKNOWN) {
+        GLuint unit = glState.activeTexture - GL_TEXTURE0;
+        if (unit < VTX_GL_STATE_TEXTURE_UNITS) {
+            slot = &glState.texture2D[unit];
+        }
+    }
+
+    if (slot != nullptr && *slot == texture) {
+        glState.skipped++;
+        return;
+    }
+    glBindTexture(target, texture);
+    if (slot != nullptr) *slot = texture;
+    glState.issued++;
+}
+
+static GLuint* capabilitySlot(GLenum capability)
+{
+    switch (capability) {
+        case GL_BLEND:
+            return &glState.blend;
+        case GL_DEPTH_TEST:
+            return &glState.depthTest;
+        case GL_CULL_FACE:
+            return &glState.cullFace;
+        case GL_SCISSOR_TEST:
+            return &glState.scissorTest;
+    }
+    return nullptr;
+}
+
+void vtx::enable(GLenum capability)
+{
+    GLuint* slot = capabilitySlot(capability);
+    if (slot != nullptr && *slot == 1) {
+        glState.skipped++;
+        return;
+    }
+    glEnable(capability);
+    if (slot != nullptr) *slot = 1;
+    glState.issued++;
+}
+
+void vtx::disable(GLenum capability)
+{
+    GLuint* slot = capabilitySlot(capability);
+    if (slot != nullptr && *slot == 0) {
+        glState.skipped++;
+        return;
+    }
+    glDisable(capability);
+    if (slot != nullptr) *slot = 0;
+    glState.issued++;
+}
+
+void vtx::blendFunc(GLenum src, GLenum dst)
+{
+    if (glState.blendSrc == src && glState.blendDst == dst) {
+        glState.skipped++;
+        return;
+    }
+    glBlendFunc(src, dst);
+    glState.blendSrc = src;
+    glState.blendDst = dst;
+    glState.issued++;
+}
+
+void vtx::depthFunc(GLenum func)
+{
+    if (glState.depthFunc == func) {
+        glState.skipped++;
+        return;
+    }
+    glDepthFunc(func);
+    glState.depthFunc = func;
+    glState.issued++;
+}
+
+void vtx::depthMask(GLboolean flag)
+{
+    if (glState.depthMask == (GLuint) flag) {
+        glState.skipped++;
+        return;
+    }
+    glDepthMask(flag);
+    glState.depthMask = flag;
+    glState.issued++;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "./gpu-memory.h"
+#include "imgui.h"
+
+// Where the panel writes its report unless VTX_GPU_MEMORY_REPORT says
+#define VTX_GPU_MEMORY_REPORT_PATH "gpu-memory.json"
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// Draws the GPU memory window, call between ImGui::NewFrame() and
+// ImGui::Render() like any other ImGui window
+void showGpuMemoryPanel();
+}  // namespace vtx
+
+static float megabytes(size_t bytes);
+
+// ************************
+//  ImGui GPU memory panel
+// ************************
+
+static float megabytes(size_t bytes)
+{
+    return (float) bytes / (1024.0f * 1024.0f);
+}
+
+void vtx::showGpuMemoryPanel()
+{
+    if (ImGui::Begin("GPU memory")) {
+        ImGui::Text("Total: %.2f MB", megabytes(vtx::gpuMemoryTotal()));
+        ImGui::SameLine();
+        if (ImGui::Button("Write report")) {
+            const char* path = getenv("VTX_GPU_MEMORY_REPORT");
+            if (path == nullptr || path[0] == '\0') {
+                path = VTX_GPU_MEMORY_REPORT_PATH;
+            }
+            vtx::writeGpuMemoryReport(path);
+        }
+
+        std::lock_guard<std::mutex> guard(gpuMemory.lock);
+
+        if (ImGui::BeginTable(
+                "Categories", 5,
+                ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg
+            )) {
+            ImGui::TableSetupColumn("Category");
+            ImGui::TableSetupColumn("Objects");
+            ImGui::TableSetupColumn("MB");
+            ImGui::TableSetupColumn("Peak MB");
+            ImGui::TableSetupColumn("Budget");
+            ImGui::TableHeadersRow();
+
+            for (int i = 0; i < vtx::GPU_MEMORY_CATEGORIES; i++) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                auto category = (vtx::GpuMemoryCategory) i;
+                ImGui::Text("%s", vtx::gpuMemoryCategoryName(category));
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", gpuMemory.count[i]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", megabytes(gpuMemory.bytes[i]));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", megabytes(gpuMemory.peak[i]));
+                ImGui::TableNextColumn();
+                if (gpuMemory.budget[i] == 0) {
+                    ImGui::TextDisabled("-");
+                } else {
+                    // Red once over budget
+                    float used = (float) gpuMemory.bytes[i] /
+                                 (float) gpuMemory.budget[i];
+                    if (used > 1.0f) {
+                        ImGui::PushStyleColor(
+                            ImGuiCol_PlotHistogram,
+                            IM_COL32(200, 60, 60, 255)
+                        );
+                    }
+                    ImGui::ProgressBar(std::min(used, 1.0f));
+                    if (used > 1.0f) ImGui::PopStyleColor();
+                }
+            }
+            ImGui::EndTable();
+        }
+
+        // Biggest first, that is where budgets are won
+        if (ImGui::CollapsingHeader("Allocations")) {
+            std::vector<const vtx::GpuAllocation*> sorted;
+            for (const auto& [key, record] : gpuMemory.allocations) {
+                sorted.push_back(&record);
+            }
+            std::sort(
+                sorted.begin(), sorted.end(),
+                [](const vtx::GpuAllocation* a,
+                   const vtx::GpuAllocation* b) {
+                    return a->bytes > b->bytes;
+                }
+            );
+            for (const vtx::GpuAllocation* record : sorted) {
+                ImGui::Text(
+                    "%8.2f KB  %-13s %s",
+                    (float) record->bytes / 1024.0f,
+                    vtx::gpuMemoryCategoryName(record->category),
+                    record->owner.c_str()
+                );
+            }
+        }
+    }
+    ImGui::End();
+}
@@ -0,0 +1,532 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "./gl-debug.h"
+#include "./gl-state.h"
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+enum GpuMemoryCategory {
+    GPU_MEMORY_VERTICES,
+    GPU_MEMORY_INDICES,
+    GPU_MEMORY_UNIFORMS,
+    GPU_MEMORY_STREAMING,
+    GPU_MEMORY_TEXTURES,
+    GPU_MEMORY_RENDER_TARGETS,
+    GPU_MEMORY_CATEGORIES,  // how many there are
+};
+
+// One buffer, texture or renderbuffer. The bytes are what the data
+// takes, drivers may pad and align on top of it.
+struct GpuAllocation {
+    GLenum kind;  // GL_BUFFER, GL_TEXTURE or GL_RENDERBUFFER
+    GLuint name;
+    GpuMemoryCategory category;
+    size_t bytes;
+    GLenum format;      // internal format, or the usage of buffers
+    int width, height;  // 0 for buffers
+    std::string owner;
+};
+
+struct GpuMemory {
+    // The panel and the report may run on another thread than GL
+    std::mutex lock;
+    std::unordered_map<uint64_t, GpuAllocation> allocations;
+    size_t bytes[GPU_MEMORY_CATEGORIES];
+    size_t peak[GPU_MEMORY_CATEGORIES];
+    int count[GPU_MEMORY_CATEGORIES];
+    size_t budget[GPU_MEMORY_CATEGORIES];  // 0 is no budget
+    // Set once the context is gone, from then on destroying a wrapper
+    // only drops its record
+    bool contextLost;
+};
+
+const char* gpuMemoryCategoryName(vtx::GpuMemoryCategory category);
+
+// Records that the object now holds bytes, replacing what was recorded
+// for it before. The wrappers below call it, call it directly for
+// objects they do not fit, like buffers orphaned at a new size.
+void trackGpuAllocation(
+    GLenum kind,
+    GLuint name,
+    vtx::GpuMemoryCategory category,
+    size_t bytes,
+    GLenum format,
+    int width,
+    int height,
+    const char* owner
+);
+void untrackGpuAllocation(GLenum kind, GLuint name);
+
+// Bytes of one width x height image, for the formats we upload
+size_t gpuImageBytes(GLenum internalFormat, int width, int height);
+
+// Allocations that take a category over its budget are reported on
+// stderr with their owner, which is how budgets are enforced for now
+void setGpuMemoryBudget(vtx::GpuMemoryCategory category, size_t bytes);
+size_t gpuMemoryTotal();
+
+// Totals per category and every allocation, false when the file
+// cannot be written
+bool writeGpuMemoryReport(const char* path);
+
+// The context is about to be destroyed, which frees every object in it
+void loseGpuMemoryContext();
+
+// Owns a buffer and its record, destroying it frees both. Can be moved
+// but not copied.
+struct GpuBuffer {
+    GLuint id = 0;
+
+    GpuBuffer() = default;
+    GpuBuffer(const GpuBuffer&)            = delete;
+    GpuBuffer& operator=(const GpuBuffer&) = delete;
+    GpuBuffer(GpuBuffer&& other) noexcept;
+    GpuBuffer& operator=(GpuBuffer&& other) noexcept;
+    ~GpuBuffer() { this->destroy(); }
+
+    // Leaves the buffer bound to target. The owner names it in the
+    // report and in GL debug messages.
+    void create(
+        GLenum target,
+        size_t bytes,
+        const void* data,
+        GLenum usage,
+        const char* owner
+    );
+    void destroy();
+};
+
+// Owns a 2D texture and its record, the same way
+struct GpuTexture {
+    GLuint id = 0;
+
+    GpuTexture() = default;
+    GpuTexture(const GpuTexture&)            = delete;
+    GpuTexture& operator=(const GpuTexture&) = delete;
+    GpuTexture(GpuTexture&& other) noexcept;
+    GpuTexture& operator=(GpuTexture&& other) noexcept;
+    ~GpuTexture() { this->destroy(); }
+
+    // Uploads level 0 and generates the rest when mipmaps is set.
+    // Leaves the texture bound to the active unit, so parameters can be
+    // set right after.
+    void create2D(
+        int width,
+        int height,
+        GLenum internalFormat,
+        GLenum format,
+        GLenum type,
+        const void* pixels,
+        bool mipmaps,
+        const char* owner
+    );
+    // Uploads levelCount levels made beforehand, level 0 first, and
+    // generates none. Compressed when format and type are 0, then
+    // levelBytes says how big each level is.
+    void createLevels2D(
+        int width,
+        int height,
+        GLenum internalFormat,
+        GLenum format,
+        GLenum type,
+        int levelCount,
+        const void* const* levels,
+        const size_t* levelBytes,
+        const char* owner
+    );
+    void destroy();
+};
+}  // namespace vtx
+
+static uint64_t gpuAllocationKey(GLenum kind, GLuint name);
+static vtx::GpuMemoryCategory bufferCategory(GLenum target);
+
+// **********************
+//  Global state context
+// **********************
+
+static vtx::GpuMemory gpuMemory;
+
+// ************
+//  Accounting
+// ************
+
+static uint64_t gpuAllocationKey(GLenum kind, GLuint name)
+{
+    return ((uint64_t) kind << 32) | name;
+}
+
+static vtx::GpuMemoryCategory bufferCategory(GLenum target)
+{
+    switch (target) {
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return vtx::GPU_MEMORY_INDICES;
+        case GL_UNIFORM_BUFFER:
+            return vtx::GPU_MEMORY_UNIFORMS;
+        default:
+            return vtx::GPU_MEMORY_VERTICES;
+    }
+}
+
+const char* vtx::gpuMemoryCategoryName(vtx::GpuMemoryCategory category)
+{
+    switch (category) {
+        case vtx::GPU_MEMORY_VERTICES:
+            return "vertices";
+        case vtx::GPU_MEMORY_INDICES:
+            return "indices";
+        case vtx::GPU_MEMORY_UNIFORMS:
+            return "uniforms";
+        case vtx::GPU_MEMORY_STREAMING:
+            return "streaming";
+        case vtx::GPU_MEMORY_TEXTURES:
+            return "textures";
+        case vtx::GPU_MEMORY_RENDER_TARGETS:
+            return "renderTargets";
+        default:
+            return "unknown";
+    }
+}
+
+void vtx::trackGpuAllocation(
+    GLenum kind,
+    GLuint name,
+    vtx::GpuMemoryCategory category,
+    size_t bytes,
+    GLenum format,
+    int width,
+    int height,
+    const char* owner
+)
+{
+    std::lock_guard<std::mutex> guard(gpuMemory.lock);
+
+    vtx::GpuAllocation& record =
+        gpuMemory.allocations[gpuAllocationKey(kind, name)];
+    if (record.kind != 0) {
+        gpuMemory.bytes[record.category] -= record.bytes;
+        gpuMemory.count[record.category]--;
+    }
+    record.kind     = kind;
+    record.name     = name;
+    record.category = category;
+    record.bytes    = bytes;
+    record.format   = format;
+    record.width    = width;
+    record.height   = height;
+    record.owner    = owner != nullptr ? owner : "";
+
+    gpuMemory.bytes[category] += bytes;
+    gpuMemory.count[category]++;
+    gpuMemory.peak[category] =
+        std::max(gpuMemory.peak[category], gpuMemory.bytes[category]);
+
+    size_t budget = gpuMemory.budget[category];
+    if (budget > 0 && gpuMemory.bytes[category] > budget) {
+        std::cerr << "GPU memory over budget: " << record.owner << " ("
+                  << bytes << " bytes) takes "
+                  << vtx::gpuMemoryCategoryName(category) << " to "
+                  << gpuMemory.bytes[category] << " of " << budget
+                  << " bytes" << std::endl;
+    }
+}
+
+void vtx::untrackGpuAllocation(GLenum kind, GLuint name)
+{
+    std::lock_guard<std::mutex> guard(gpuMemory.lock);
+
+    auto found =
+        gpuMemory.allocations.find(gpuAllocationKey(kind, name));
+    if (found == gpuMemory.allocations.end()) return;
+    gpuMemory.bytes[found->second.category] -= found->second.bytes;
+    gpuMemory.count[found->second.category]--;
+    gpuMemory.allocations.erase(found);
+}
+
+size_t vtx::gpuImageBytes(GLenum internalFormat, int width, int height)
+{
+    // Compressed formats take whole 4x4 blocks
+    size_t blocks = (size_t) ((width + 3) / 4) * ((height + 3) / 4);
+    switch (internalFormat) {
+        case GL_COMPRESSED_RGB8_ETC2:
+            return blocks * 8;
+        case GL_COMPRESSED_RGBA8_ETC2_EAC:
+            return blocks * 16;
+    }
+
+    size_t texel;
+    switch (internalFormat) {
+        case GL_RED:
+        case GL_R8:
+            texel = 1;
+            break;
+        case GL_RG:
+        case GL_RG8:
+        case GL_R16F:
+        case GL_DEPTH_COMPONENT16:
+            texel = 2;
+            break;
+        case GL_RGB:
+        case GL_RGB8:
+        case GL_SRGB8:
+            texel = 3;
+            break;
+        case GL_RGBA16F:
+            texel = 8;
+            break;
+        case GL_RGBA32F:
+            texel = 16;
+            break;
+        default:  // RGBA8, R32F, 24 bit depth and the like
+            texel = 4;
+            break;
+    }
+    return texel * (size_t) width * (size_t) height;
+}
+
+void vtx::setGpuMemoryBudget(
+    vtx::GpuMemoryCategory category,
+    size_t bytes
+)
+{
+    std::lock_guard<std::mutex> guard(gpuMemory.lock);
+    gpuMemory.budget[category] = bytes;
+}
+
+size_t vtx::gpuMemoryTotal()
+{
+    std::lock_guard<std::mutex> guard(gpuMemory.lock);
+    size_t total = 0;
+    for (int i = 0; i < vtx::GPU_MEMORY_CATEGORIES; i++) {
+        total += gpuMemory.bytes[i];
+    }
+    return total;
+}
+
+bool vtx::writeGpuMemoryReport(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        std::cerr << "Could not write GPU memory report to " << path
+                  << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(gpuMemory.lock);
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"categories\": {\n");
+    for (int i = 0; i < vtx::GPU_MEMORY_CATEGORIES; i++) {
+        fprintf(
+            file,
+            "    \"%s\": {\"bytes\": %zu, \"peak\": %zu, "
+            "\"count\": %d, \"budget\": %zu}%s\n",
+            vtx::gpuMemoryCategoryName((vtx::GpuMemoryCategory) i),
+            gpuMemory.bytes[i], gpuMemory.peak[i], gpuMemory.count[i],
+            gpuMemory.budget[i],
+            i + 1 < vtx::GPU_MEMORY_CATEGORIES ? "," : ""
+        );
+    }
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"allocations\": [");
+    const char* separator = "\n";
+    for (const auto& [key, record] : gpuMemory.allocations) {
+        // Owners are our own labels, quotes and backslashes are all
+        // that could break the JSON
+        std::string owner;
+        for (char c : record.owner) {
+            if (c == '"' || c == '\\') owner += '\\';
+            owner += c;
+        }
+        fprintf(
+            file,
+            "%s    {\"owner\": \"%s\", \"category\": \"%s\", "
+            "\"bytes\": %zu, \"format\": %u, \"width\": %d, "
+            "\"height\": %d}",
+            separator, owner.c_str(),
+            vtx::gpuMemoryCategoryName(record.category), record.bytes,
+            (unsigned) record.format, record.width, record.height
+        );
+        separator = ",\n";
+    }
+    fprintf(file, "\n  ]\n");
+    fprintf(file, "}\n");
+    fclose(file);
+    return true;
+}
+
+void vtx::loseGpuMemoryContext()
+{
+    std::lock_guard<std::mutex> guard(gpuMemory.lock);
+    gpuMemory.contextLost = true;
+}
+
+// **********
+//  Wrappers
+// **********
+
+vtx::GpuBuffer::GpuBuffer(GpuBuffer&& other) noexcept
+    : id(std::exchange(other.id, 0))
+{
+}
+
+vtx::GpuBuffer& vtx::GpuBuffer::operator=(GpuBuffer&& other) noexcept
+{
+    if (this != &other) {
+        this->destroy();
+        this->id = std::exchange(other.id, 0);
+    }
+    return *this;
+}
+
+void vtx::GpuBuffer::create(
+    GLenum target,
+    size_t bytes,
+    const void* data,
+    GLenum usage,
+    const char* owner
+)
+{
+    this->destroy();
+    glGenBuffers(1, &this->id);
+    vtx::bindBuffer(target, this->id);
+    vtx::labelObject(GL_BUFFER, this->id, owner);
+    glBufferData(target, (GLsizeiptr) bytes, data, usage);
+    vtx::trackGpuAllocation(
+        GL_BUFFER, this->id, bufferCategory(target), bytes, usage, 0, 0,
+        owner
+    );
+}
+
+void vtx::GpuBuffer::destroy()
+{
+    if (this->id == 0) return;
+    vtx::untrackGpuAllocation(GL_BUFFER, this->id);
+    if (!gpuMemory.contextLost) {
+        glDeleteBuffers(1, &this->id);
+        // It may still be bound
+        vtx::invalidateGLState();
+    }
+    this->id = 0;
+}
+
+vtx::GpuTexture::GpuTexture(GpuTexture&& other) noexcept
+    : id(std::exchange(other.id, 0))
+{
+}
+
+vtx::GpuTexture& vtx::GpuTexture::operator=(GpuTexture&& other
+) noexcept
+{
+    if (this != &other) {
+        this->destroy();
+        this->id = std::exchange(other.id, 0);
+    }
+    return *this;
+}
+
+void vtx::GpuTexture::create2D(
+    int width,
+    int height,
+    GLenum internalFormat,
+    GLenum format,
+    GLenum type,
+    const void* pixels,
+    bool mipmaps,
+    const char* owner
+)
+{
+    this->destroy();
+    glGenTextures(1, &this->id);
+    vtx::bindTexture(GL_TEXTURE_2D, this->id);
+    vtx::labelObject(GL_TEXTURE, this->id, owner);
+    glTexImage2D(
+        GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format,
+        type, pixels
+    );
+
+    size_t bytes = vtx::gpuImageBytes(internalFormat, width, height);
+    if (mipmaps) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        for (int w = width, h = height; w > 1 || h > 1;) {
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+            bytes += vtx::gpuImageBytes(internalFormat, w, h);
+        }
+    }
+    vtx::trackGpuAllocation(
+        GL_TEXTURE, this->id, vtx::GPU_MEMORY_TEXTURES, bytes,
+        internalFormat, width, height, owner
+    );
+}
+
+void vtx::GpuTexture::createLevels2D(
+    int width,
+    int height,
+    GLenum internalFormat,
+    GLenum format,
+    GLenum type,
+    int levelCount,
+    const void* const* levels,
+    const size_t* levelBytes,
+    const char* owner
+)
+{
+    this->destroy();
+    glGenTextures(1, &this->id);
+    vtx::bindTexture(GL_TEXTURE_2D, this->id);
+    vtx::labelObject(GL_TEXTURE, this->id, owner);
+
+    size_t bytes = 0;
+    int w = width, h = height;
+    for (int level = 0; level < levelCount; level++) {
+        if (format == 0) {
+            glCompressedTexImage2D(
+                GL_TEXTURE_2D, level, internalFormat, w, h, 0,
+                (GLsizei) levelBytes[level], levels[level]
+            );
+        } else {
+            glTexImage2D(
+                GL_TEXTURE_2D, level, internalFormat, w, h, 0, format,
+                type, levels[level]
+            );
+        }
+        bytes += vtx::gpuImageBytes(internalFormat, w, h);
+        w = std::max(w / 2, 1);
+        h = std::max(h / 2, 1);
+    }
+    // A chain that stops before 1x1 is still complete this way
+    glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1
+    );
+
+    vtx::trackGpuAllocation(
+        GL_TEXTURE, this->id, vtx::GPU_MEMORY_TEXTURES, bytes,
+        internalFormat, width, height, owner
+    );
+}
+
+void vtx::GpuTexture::destroy()
+{
+    if (this->id == 0) return;
+    vtx::untrackGpuAllocation(GL_TEXTURE, this->id);
+    if (!gpuMemory.contextLost) {
+        glDeleteTextures(1, &this->id);
+        vtx::invalidateGLState();
+    }
+    this->id = 0;
+}
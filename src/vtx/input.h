@@ -0,0 +1,189 @@
+#pragma once
+
+#ifdef __USE_SDL
+#include <SDL2/SDL.h>
+#elif defined(__USE_GLFW)
+#include <GLFW/glfw3.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Queued motion events latchInput() looks at, with more than this the
+// newest one is taken to have happened just now
+#define VTX_INPUT_LATCH_EVENTS (64)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// What the user did since the previous frame. Times are ticks of the
+// frame clock (see VertexContext::clockFrequency).
+struct InputSnapshot {
+#ifdef __USE_SDL
+    std::vector<SDL_Event> events;  // oldest first
+#elif defined(__USE_GLFW)
+    GLFWwindow* glfwWindow;  // GLFW has no event queue to copy
+#endif
+    std::vector<uint64_t> eventTimes;  // when each event happened
+    int mouseX, mouseY;                // latest known position
+    uint32_t mouseButtons;             // SDL_BUTTON() masks
+    int coalesced;  // motion events merged into the one before them
+    // Newest input this frame reflects, 0 when there was none. Swapping
+    // measures the input latency from here.
+    uint64_t inputTime;
+};
+
+// Empties the event queue into the snapshot, which replaces the one of
+// the previous frame. A run of mouse motion events becomes one event
+// with the summed relative motion and the latest position.
+void pollInput(vtx::InputSnapshot* input);
+
+// Samples the mouse again without taking anything off the queue, call
+// it right before the camera is finalized so the frame shows where the
+// mouse is now rather than where it was when the frame started. The
+// events stay queued for the next pollInput().
+void latchInput(vtx::InputSnapshot* input);
+}  // namespace vtx
+
+static uint64_t readInputClock();
+#ifdef __USE_SDL
+static uint64_t sdlEventTime(
+    const SDL_Event* event,
+    uint64_t now,
+    uint32_t nowMs
+);
+#endif
+
+// *****************
+//  Input snapshots
+// *****************
+
+// Same clock as readClock() of ctx.h, which is declared after this
+static uint64_t readInputClock()
+{
+#ifdef __USE_SDL
+    return SDL_GetPerformanceCounter();
+#elif defined(__USE_GLFW)
+    return glfwGetTimerValue();
+#endif
+}
+
+#ifdef __USE_SDL
+// SDL stamps events in milliseconds when they are queued, which is
+// moved over to the frame clock by their age
+static uint64_t sdlEventTime(
+    const SDL_Event* event,
+    uint64_t now,
+    uint32_t nowMs
+)
+{
+    uint32_t ageMs = nowMs - event->common.timestamp;
+    if ((int32_t) ageMs < 0) return now;
+
+    uint64_t age =
+        (uint64_t) ageMs * SDL_GetPerformanceFrequency() / 1000;
+    return age < now ? now - age : now;
+}
+#endif
+
+void vtx::pollInput(vtx::InputSnapshot* input)
+{
+    input->eventTimes.clear();
+    input->coalesced = 0;
+    input->inputTime = 0;
+
+#ifdef __USE_SDL
+    input->events.clear();
+
+    uint64_t now   = readInputClock();
+    uint32_t nowMs = SDL_GetTicks();
+
+    SDL_Event event;
+    while (SDL_PollEvent(&event) != 0) {
+        uint64_t time = sdlEventTime(&event, now, nowMs);
+
+        SDL_Event* last =
+            input->events.empty() ? nullptr : &input->events.back();
+        if (event.type == SDL_MOUSEMOTION && last != nullptr &&
+            last->type == SDL_MOUSEMOTION &&
+            last->motion.windowID == event.motion.windowID &&
+            last->motion.which == event.motion.which &&
+            last->motion.state == event.motion.state) {
+            // A fast mouse queues hundreds of these per frame, nobody
+            // wants more than where it went and how far
+            event.motion.xrel += last->motion.xrel;
+            event.motion.yrel += last->motion.yrel;
+            *last                    = event;
+            input->eventTimes.back() = time;
+            input->coalesced++;
+        } else {
+            input->events.push_back(event);
+            input->eventTimes.push_back(time);
+        }
+        input->inputTime = std::max(input->inputTime, time);
+    }
+
+    input->mouseButtons =
+        SDL_GetMouseState(&input->mouseX, &input->mouseY);
+#elif defined(__USE_GLFW)
+    int oldX = input->mouseX, oldY = input->mouseY;
+    glfwPollEvents();
+
+    double x, y;
+    glfwGetCursorPos(input->glfwWindow, &x, &y);
+    input->mouseX       = (int) x;
+    input->mouseY       = (int) y;
+    input->mouseButtons = 0;
+    for (int i = 0; i < 3; i++) {
+        // GLFW counts left, right, middle, SDL left, middle, right
+        const int sdlButton[] = {1, 3, 2};
+        if (glfwGetMouseButton(input->glfwWindow, i) == GLFW_PRESS) {
+            input->mouseButtons |= 1u << (sdlButton[i] - 1);
+        }
+    }
+    // Only polled, so the time is when it was seen
+    if (input->mouseX != oldX || input->mouseY != oldY) {
+        input->inputTime = readInputClock();
+    }
+#endif
+}
+
+void vtx::latchInput(vtx::InputSnapshot* input)
+{
+#ifdef __USE_SDL
+    SDL_PumpEvents();
+
+    uint64_t now   = readInputClock();
+    uint32_t nowMs = SDL_GetTicks();
+
+    // Pumping already moved the mouse state past the queued motion,
+    // the events are only looked at for when the newest one happened
+    input->mouseButtons =
+        SDL_GetMouseState(&input->mouseX, &input->mouseY);
+
+    SDL_Event motion[VTX_INPUT_LATCH_EVENTS];
+    int count = SDL_PeepEvents(
+        motion, VTX_INPUT_LATCH_EVENTS, SDL_PEEKEVENT, SDL_MOUSEMOTION,
+        SDL_MOUSEMOTION
+    );
+    if (count == VTX_INPUT_LATCH_EVENTS) {
+        input->inputTime = now;
+    } else if (count > 0) {
+        uint64_t newest  = sdlEventTime(&motion[count - 1], now, nowMs);
+        input->inputTime = std::max(input->inputTime, newest);
+    }
+#elif defined(__USE_GLFW)
+    int oldX = input->mouseX, oldY = input->mouseY;
+
+    double x, y;
+    glfwGetCursorPos(input->glfwWindow, &x, &y);
+    input->mouseX = (int) x;
+    input->mouseY = (int) y;
+    if (input->mouseX != oldX || input->mouseY != oldY) {
+        input->inputTime = readInputClock();
+    }
+#endif
+}
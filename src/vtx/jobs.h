@@ -0,0 +1,442 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "./trace.h"
+
+// Web builds only get threads when built with -pthread (make
+// PTHREADS=1), without it every job runs inline on the main thread.
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define VTX_JOB_THREADS
+#endif
+
+// Jobs one thread may have queued at once, must be a power of two
+#define VTX_JOB_DEQUE_SIZE (4096)
+// Spins over the deques before a worker goes to sleep
+#define VTX_JOB_SPINS (64)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// Number of jobs started and not yet finished. Waiting for a counter
+// joins its jobs, and a job waiting for the counter of other jobs is
+// how one job depends on others.
+struct JobCounter {
+    std::atomic<int> pending{0};
+};
+
+typedef void (*JobFunction)(void* data, int begin, int end);
+
+struct Job {
+    JobFunction function;
+    void* data;
+    int begin, end;
+    JobCounter* counter;  // may be null
+};
+
+// Chase-Lev deque: the owner pushes and pops at the bottom, any other
+// thread steals from the top, none of them takes a lock
+struct JobDeque {
+    std::atomic<int64_t> top{0};
+    std::atomic<int64_t> bottom{0};
+    std::atomic<Job*> jobs[VTX_JOB_DEQUE_SIZE];
+
+    bool push(Job* job);
+    Job* pop();
+    Job* steal();
+};
+
+struct JobWorker {
+    JobDeque deque;
+    // Jobs are stored here while queued, reused round robin. A slot is
+    // busy from its push until its job was taken and copied out.
+    Job pool[VTX_JOB_DEQUE_SIZE];
+    std::atomic<bool> poolBusy[VTX_JOB_DEQUE_SIZE];
+    uint32_t poolNext = 0;
+    uint32_t random   = 0;  // picks whom to steal from
+    std::thread thread;
+};
+
+struct JobSystem {
+    int workerCount    = 0;        // threads besides the main thread
+    JobWorker* workers = nullptr;  // [0] belongs to the main thread
+    std::atomic<uint32_t> signal{0};  // bumped on push, sleepers wait
+    std::atomic<bool> stopping{false};
+
+    // Jobs queued by threads outside the pool, like the render thread
+    // or the asset loaders. They own no deque, so these take a lock.
+    std::mutex foreignLock;
+    std::deque<vtx::Job> foreignJobs;
+    std::atomic<int> foreignCount{0};
+};
+
+// VTX_JOB_WORKERS, or one less than the number of cores
+int defaultJobWorkerCount();
+
+// Starts the workers, the calling thread becomes the main thread of
+// the system. With 0 workers every job runs inline.
+void startJobSystem(vtx::JobSystem* jobs, int workerCount);
+void stopJobSystem(vtx::JobSystem* jobs);
+
+// Queues function(data, begin, end). Threads other than the main
+// thread and the workers queue it behind a lock, which is fine for
+// coarse jobs like decoding a texture.
+void runJob(
+    vtx::JobSystem* jobs,
+    vtx::JobCounter* counter,
+    vtx::JobFunction function,
+    void* data,
+    int begin = 0,
+    int end   = 0
+);
+
+// Runs other jobs until the counter drops to zero, so waiting inside a
+// job never deadlocks the pool
+void waitForCounter(vtx::JobSystem* jobs, vtx::JobCounter* counter);
+
+// Calls body(begin, end) over 0..count in chunks of grain elements
+// spread over all workers, returns when all chunks are done
+template <typename Body>
+void parallelFor(
+    vtx::JobSystem* jobs,
+    int count,
+    int grain,
+    const Body& body
+);
+}  // namespace vtx
+
+static bool runOneJob(vtx::JobSystem* jobs);
+static bool runForeignJob(vtx::JobSystem* jobs);
+static void queueForeignJob(vtx::JobSystem* jobs, const vtx::Job& job);
+static void finishJob(const vtx::Job& job);
+static void runJobWorker(vtx::JobSystem* jobs, int index);
+
+// **********************
+//  Global state context
+// **********************
+
+static vtx::JobSystem jobSystem;
+
+// Which deque the current thread owns, -1 for threads outside the pool
+static thread_local int jobWorkerIndex = -1;
+
+// ************
+//  Job deques
+// ************
+
+bool vtx::JobDeque::push(Job* job)
+{
+    int64_t b = this->bottom.load(std::memory_order_relaxed);
+    int64_t t = this->top.load(std::memory_order_acquire);
+    if (b - t >= VTX_JOB_DEQUE_SIZE) return false;
+
+    this->jobs[b & (VTX_JOB_DEQUE_SIZE - 1)].store(
+        job, std::memory_order_relaxed
+    );
+    std::atomic_thread_fence(std::memory_order_release);
+    this->bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+vtx::Job* vtx::JobDeque::pop()
+{
+    int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+    this->bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = this->top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // Was empty already
+        this->bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    vtx::Job* job = this->jobs[b & (VTX_JOB_DEQUE_SIZE - 1)].load(
+        std::memory_order_relaxed
+    );
+    if (t == b) {
+        // The last job, a thief may be after it too
+        if (!this->top.compare_exchange_strong(
+                t, t + 1, std::memory_order_seq_cst,
+                std::memory_order_relaxed
+            )) {
+            job = nullptr;
+        }
+        this->bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+vtx::Job* vtx::JobDeque::steal()
+{
+    int64_t t = this->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = this->bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    vtx::Job* job = this->jobs[t & (VTX_JOB_DEQUE_SIZE - 1)].load(
+        std::memory_order_relaxed
+    );
+    if (!this->top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst,
+            std::memory_order_relaxed
+        )) {
+        return nullptr;  // lost to the owner or another thief
+    }
+    return job;
+}
+
+// *************
+//  Worker pool
+// *************
+
+int vtx::defaultJobWorkerCount()
+{
+#ifdef VTX_JOB_THREADS
+    const char* setting = getenv("VTX_JOB_WORKERS");
+    if (setting != nullptr && setting[0] != '\0') {
+        return std::max(atoi(setting), 0);
+    }
+    int cores = (int) std::thread::hardware_concurrency();
+    return std::max(cores - 1, 0);
+#else
+    return 0;
+#endif
+}
+
+void vtx::startJobSystem(vtx::JobSystem* jobs, int workerCount)
+{
+#ifndef VTX_JOB_THREADS
+    workerCount = 0;
+#endif
+    jobs->workerCount = workerCount;
+    jobs->workers     = new vtx::JobWorker[workerCount + 1];
+    jobs->stopping.store(false);
+
+    jobWorkerIndex = 0;
+    for (int i = 0; i <= workerCount; i++) {
+        jobs->workers[i].random = 0x9e3779b9u * (uint32_t) (i + 1);
+    }
+    for (int i = 1; i <= workerCount; i++) {
+        jobs->workers[i].thread = std::thread(runJobWorker, jobs, i);
+    }
+}
+
+void vtx::stopJobSystem(vtx::JobSystem* jobs)
+{
+    if (jobs->workers == nullptr) return;
+
+    jobs->stopping.store(true);
+    jobs->signal.fetch_add(1);
+    jobs->signal.notify_all();
+    for (int i = 1; i <= jobs->workerCount; i++) {
+        jobs->workers[i].thread.join();
+    }
+
+    delete[] jobs->workers;
+    jobs->workers     = nullptr;
+    jobs->workerCount = 0;
+}
+
+static void runJobWorker(vtx::JobSystem* jobs, int index)
+{
+    jobWorkerIndex = index;
+
+    char name[32];
+    snprintf(name, sizeof(name), "worker %d", index);
+    vtx::setTraceThreadName(name);
+
+    while (!jobs->stopping.load(std::memory_order_relaxed)) {
+        // Read before looking, so a push made while looking is not
+        // slept through
+        uint32_t seen = jobs->signal.load();
+        bool ranAJob  = false;
+        for (int spin = 0; spin < VTX_JOB_SPINS && !ranAJob; spin++) {
+            ranAJob = runOneJob(jobs);
+        }
+        if (!ranAJob) jobs->signal.wait(seen);
+    }
+}
+
+static bool runOneJob(vtx::JobSystem* jobs)
+{
+    vtx::JobWorker* self  = &jobs->workers[jobWorkerIndex];
+    vtx::JobWorker* owner = self;
+    vtx::Job* taken       = self->deque.pop();
+
+    // Nothing of our own, so steal, starting from a random victim so
+    // that thieves do not all line up behind the same deque
+    int workers = jobs->workerCount + 1;
+    if (taken == nullptr && workers > 1) {
+        self->random ^= self->random << 13;
+        self->random ^= self->random >> 17;
+        self->random ^= self->random << 5;
+        int first = (int) (self->random % (uint32_t) workers);
+        for (int i = 0; i < workers && taken == nullptr; i++) {
+            int victim = (first + i) % workers;
+            if (victim == jobWorkerIndex) continue;
+            owner = &jobs->workers[victim];
+            taken = owner->deque.steal();
+        }
+    }
+    // The main thread leaves foreign jobs to the workers, a long one
+    // would stall its frame
+    if (taken == nullptr) {
+        return jobWorkerIndex != 0 && runForeignJob(jobs);
+    }
+
+    // Copied out before the slot is given back, the owner may reuse it
+    // while the job runs
+    vtx::Job job = *taken;
+    owner->poolBusy[taken - owner->pool].store(
+        false, std::memory_order_release
+    );
+    finishJob(job);
+    return true;
+}
+
+static bool runForeignJob(vtx::JobSystem* jobs)
+{
+    if (jobs->foreignCount.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    vtx::Job job;
+    {
+        std::lock_guard<std::mutex> guard(jobs->foreignLock);
+        if (jobs->foreignJobs.empty()) return false;
+        job = jobs->foreignJobs.front();
+        jobs->foreignJobs.pop_front();
+        jobs->foreignCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    finishJob(job);
+    return true;
+}
+
+static void finishJob(const vtx::Job& job)
+{
+    {
+        VTX_TRACE_SCOPE("job");
+        job.function(job.data, job.begin, job.end);
+    }
+    if (job.counter != nullptr) {
+        job.counter->pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+// **********************
+//  Starting and joining
+// **********************
+
+void vtx::runJob(
+    vtx::JobSystem* jobs,
+    vtx::JobCounter* counter,
+    vtx::JobFunction function,
+    void* data,
+    int begin,
+    int end
+)
+{
+    if (jobs->workerCount == 0) {
+        function(data, begin, end);
+        return;
+    }
+    if (jobWorkerIndex < 0) {
+        queueForeignJob(jobs, {function, data, begin, end, counter});
+        return;
+    }
+
+    vtx::JobWorker* self = &jobs->workers[jobWorkerIndex];
+    uint32_t slot        = self->poolNext & (VTX_JOB_DEQUE_SIZE - 1);
+    // Still queued or being copied out. Doing it now is the best back
+    // pressure there is.
+    if (self->poolBusy[slot].load(std::memory_order_acquire)) {
+        function(data, begin, end);
+        return;
+    }
+    self->poolNext++;
+
+    vtx::Job* job = &self->pool[slot];
+    job->function = function;
+    job->data     = data;
+    job->begin    = begin;
+    job->end      = end;
+    job->counter  = counter;
+    self->poolBusy[slot].store(true, std::memory_order_relaxed);
+
+    if (counter != nullptr) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Busy slots are never fewer than queued jobs, so with this one
+    // free the deque has room
+    self->deque.push(job);
+
+    jobs->signal.fetch_add(1);
+    jobs->signal.notify_one();
+}
+
+static void queueForeignJob(vtx::JobSystem* jobs, const vtx::Job& job)
+{
+    if (job.counter != nullptr) {
+        job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> guard(jobs->foreignLock);
+        jobs->foreignJobs.push_back(job);
+        jobs->foreignCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    jobs->signal.fetch_add(1);
+    jobs->signal.notify_one();
+}
+
+void vtx::waitForCounter(vtx::JobSystem* jobs, vtx::JobCounter* counter)
+{
+    while (counter->pending.load(std::memory_order_acquire) > 0) {
+        // Outside the pool only the queued foreign jobs can be helped
+        bool ranAJob = jobWorkerIndex < 0 ? runForeignJob(jobs)
+                                          : runOneJob(jobs);
+        if (!ranAJob) std::this_thread::yield();
+    }
+}
+
+template <typename Body>
+void vtx::parallelFor(
+    vtx::JobSystem* jobs,
+    int count,
+    int grain,
+    const Body& body
+)
+{
+    if (count <= 0) return;
+    grain = std::max(grain, 1);
+
+    // A single chunk is not worth a job
+    if (jobs == nullptr || jobs->workerCount == 0 || count <= grain) {
+        body(0, count);
+        return;
+    }
+
+    vtx::JobCounter counter;
+    vtx::JobFunction runChunk = [](void* data, int begin, int end) {
+        (*(const Body*) data)(begin, end);
+    };
+    for (int begin = grain; begin < count; begin += grain) {
+        vtx::runJob(
+            jobs, &counter, runChunk, (void*) &body, begin,
+            std::min(begin + grain, count)
+        );
+    }
+
+    // The first chunk is done here instead of waiting idle
+    body(0, grain);
+    vtx::waitForCounter(jobs, &counter);
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#ifndef __EMSCRIPTEN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "./shader-cache.h"
+#include "./trace.h"
+
+// The web has no files that outlive the page, so there the cache is a
+// no-op and every start imports
+#ifndef __EMSCRIPTEN__
+#define VTX_MESH_CACHE
+#endif
+
+// Bump when the file layout changes, old files are then ignored
+#define VTX_MESH_CACHE_VERSION (1)
+// Blobs start at multiples of this in the file, and so in the mapping
+#define VTX_MESH_CACHE_ALIGNMENT (16)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// A mesh ready for upload. After vtx::loadCookedMesh() the blobs point
+// into the mapped file. Before vtx::storeCookedMesh() they point to
+// whatever the import made.
+struct CookedMesh {
+    const void* vertices;
+    uint32_t vertexStride;  // bytes of one vertex
+    uint32_t vertexCount;
+    const uint32_t* indices;
+    uint32_t indexCount;
+
+    // Decoded texels of the diffuse texture, 8 bits per channel, or
+    // nullptr when the mesh has none
+    const void* texels;
+    uint32_t textureWidth, textureHeight;
+    GLenum textureFormat;  // GL_RGB or GL_RGBA
+
+    float transform[16];  // of the mesh node in the scene, column major
+
+    void* mapping;  // nullptr unless loaded from a cooked file
+    size_t mappingSize;
+};
+
+// Hash of the source file contents, the mesh, the import flags and the
+// vertex size, which names the cooked file. 0 when the source cannot
+// be read.
+uint64_t meshCacheKey(
+    const char* path,
+    const char* meshName,
+    unsigned int importFlags,
+    uint32_t vertexStride
+);
+
+// True when a cooked file was found, it is then mapped with a single
+// mmap() and the blobs can go straight into glBufferData()
+bool loadCookedMesh(uint64_t key, vtx::CookedMesh* mesh);
+
+// Written on the first import, so the next start finds it
+void storeCookedMesh(uint64_t key, const vtx::CookedMesh* mesh);
+
+// Unmaps the file, call when the blobs are uploaded
+void releaseCookedMesh(vtx::CookedMesh* mesh);
+
+bool isMeshCacheEnabled();
+}  // namespace vtx
+
+static uint64_t hashSourceFile(const char* path);
+static uint64_t fnv1aBytes(
+    uint64_t hash,
+    const void* data,
+    size_t size
+);
+static std::string cookedMeshPath(uint64_t key);
+static size_t alignCookedOffset(size_t offset);
+static bool writeCookedBlob(
+    FILE* file,
+    uint64_t offset,
+    const void* data,
+    size_t size
+);
+
+struct CookedMeshHeader {
+    char magic[4];  // "VTXM"
+    uint32_t version;
+    uint64_t key;
+    uint64_t fileSize;
+
+    uint32_t vertexStride, vertexCount, indexCount;
+    uint32_t textureWidth, textureHeight, textureFormat;
+    float transform[16];
+
+    // Where the blobs start, from the start of the file
+    uint64_t vertexOffset, indexOffset, texelOffset;
+    uint64_t texelBytes;
+};
+
+// **********************
+//  Global state context
+// **********************
+
+// Several meshes often come from one file, it is hashed only once.
+// Loader threads ask at the same time, the lock makes them wait for
+// the one hashing.
+static std::unordered_map<std::string, uint64_t> sourceFileHashes;
+static std::mutex sourceFileHashesLock;
+
+// **************
+//  Cache lookup
+// **************
+
+bool vtx::isMeshCacheEnabled()
+{
+#ifdef VTX_MESH_CACHE
+    const char* setting = getenv("VTX_MESH_CACHE");
+    return setting == nullptr || strcmp(setting, "0") != 0;
+#else
+    return false;
+#endif
+}
+
+// FNV-1a a word at a time, byte by byte is too slow for big models
+static uint64_t fnv1aBytes(
+    uint64_t hash,
+    const void* data,
+    size_t size
+)
+{
+    auto* bytes  = (const uint8_t*) data;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        memcpy(&word, bytes + i * 8, 8);
+        hash ^= word;
+        hash *= 0x100000001b3ull;
+    }
+    for (size_t i = words * 8; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t hashSourceFile(const char* path)
+{
+    std::lock_guard<std::mutex> guard(sourceFileHashesLock);
+    auto known = sourceFileHashes.find(path);
+    if (known != sourceFileHashes.end()) return known->second;
+
+    uint64_t hash = 0;
+#ifdef VTX_MESH_CACHE
+    VTX_TRACE_SCOPE_DETAIL("hashSourceFile", path);
+    int file = open(path, O_RDONLY);
+    if (file < 0) return 0;
+
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        size_t size = (size_t) status.st_size;
+        void* data =
+            mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data != MAP_FAILED) {
+            hash = fnv1aBytes(0xcbf29ce484222325ull, data, size);
+            hash = fnv1aBytes(hash, &size, sizeof(size));
+            munmap(data, size);
+        }
+    }
+    close(file);
+#endif
+    sourceFileHashes[path] = hash;
+    return hash;
+}
+
+uint64_t vtx::meshCacheKey(
+    const char* path,
+    const char* meshName,
+    unsigned int importFlags,
+    uint32_t vertexStride
+)
+{
+    if (!vtx::isMeshCacheEnabled()) return 0;
+
+    uint64_t hash = hashSourceFile(path);
+    if (hash == 0) return 0;
+    hash = fnv1a(hash, meshName);
+    hash = fnv1aBytes(hash, &importFlags, sizeof(importFlags));
+    hash = fnv1aBytes(hash, &vertexStride, sizeof(vertexStride));
+    return hash != 0 ? hash : 1;
+}
+
+static std::string cookedMeshPath(uint64_t key)
+{
+    char name[32];
+    snprintf(
+        name, sizeof(name), "/%016llx.mesh", (unsigned long long) key
+    );
+    return std::string(vtx::cacheDirectory()) + name;
+}
+
+static size_t alignCookedOffset(size_t offset)
+{
+    return (offset + VTX_MESH_CACHE_ALIGNMENT - 1) &
+           ~(size_t) (VTX_MESH_CACHE_ALIGNMENT - 1);
+}
+
+// Pads up to offset first, which is where the blob is expected
+static bool writeCookedBlob(
+    FILE* file,
+    uint64_t offset,
+    const void* data,
+    size_t size
+)
+{
+    static const char padding[VTX_MESH_CACHE_ALIGNMENT] = {};
+    size_t gap = (size_t) (offset - (uint64_t) ftell(file));
+    if (fwrite(padding, 1, gap, file) != gap) return false;
+    return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+// ****************
+//  Load and store
+// ****************
+
+bool vtx::loadCookedMesh(uint64_t key, vtx::CookedMesh* mesh)
+{
+    *mesh = {};
+#ifdef VTX_MESH_CACHE
+    if (key == 0) return false;
+
+    std::string path = cookedMeshPath(key);
+    int file         = open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    VTX_TRACE_SCOPE_DETAIL("loadCookedMesh", path.c_str());
+    struct stat status;
+    void* mapping = MAP_FAILED;
+    size_t size   = 0;
+    if (fstat(file, &status) == 0 &&
+        (size_t) status.st_size >= sizeof(CookedMeshHeader)) {
+        size    = (size_t) status.st_size;
+        mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    // The mapping stays valid without the descriptor
+    close(file);
+    if (mapping == MAP_FAILED) return false;
+
+    // Everything the header claims must lie inside the file
+    auto* header = (const CookedMeshHeader*) mapping;
+    auto* base   = (const uint8_t*) mapping;
+    uint64_t vertexBytes =
+        (uint64_t) header->vertexStride * header->vertexCount;
+    uint64_t indexBytes = (uint64_t) header->indexCount * 4;
+    bool valid = memcmp(header->magic, "VTXM", 4) == 0 &&
+                 header->version == VTX_MESH_CACHE_VERSION &&
+                 header->key == key && header->fileSize == size &&
+                 header->vertexOffset + vertexBytes <= size &&
+                 header->indexOffset + indexBytes <= size &&
+                 header->texelOffset + header->texelBytes <= size;
+    if (!valid) {
+        munmap(mapping, size);
+        std::cerr << "Mesh cache: stale file " << path << std::endl;
+        remove(path.c_str());
+        return false;
+    }
+
+    mesh->vertices     = base + header->vertexOffset;
+    mesh->vertexStride = header->vertexStride;
+    mesh->vertexCount  = header->vertexCount;
+    mesh->indices = (const uint32_t*) (base + header->indexOffset);
+    mesh->indexCount = header->indexCount;
+    if (header->texelBytes > 0) {
+        mesh->texels        = base + header->texelOffset;
+        mesh->textureWidth  = header->textureWidth;
+        mesh->textureHeight = header->textureHeight;
+        mesh->textureFormat = header->textureFormat;
+    }
+    memcpy(mesh->transform, header->transform, sizeof(mesh->transform));
+    mesh->mapping     = mapping;
+    mesh->mappingSize = size;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void vtx::storeCookedMesh(uint64_t key, const vtx::CookedMesh* mesh)
+{
+#ifdef VTX_MESH_CACHE
+    if (key == 0) return;
+
+    CookedMeshHeader header = {};
+    memcpy(header.magic, "VTXM", 4);
+    header.version       = VTX_MESH_CACHE_VERSION;
+    header.key           = key;
+    header.vertexStride  = mesh->vertexStride;
+    header.vertexCount   = mesh->vertexCount;
+    header.indexCount    = mesh->indexCount;
+    header.textureWidth  = mesh->textureWidth;
+    header.textureHeight = mesh->textureHeight;
+    header.textureFormat = mesh->textureFormat;
+    memcpy(header.transform, mesh->transform, sizeof(header.transform));
+
+    size_t vertexBytes =
+        (size_t) mesh->vertexStride * mesh->vertexCount;
+    size_t indexBytes  = (size_t) mesh->indexCount * 4;
+    size_t channels    = mesh->textureFormat == GL_RGBA ? 4 : 3;
+    size_t texelBytes  = 0;
+    if (mesh->texels != nullptr) {
+        texelBytes = (size_t) mesh->textureWidth * mesh->textureHeight *
+                     channels;
+    }
+
+    header.vertexOffset = alignCookedOffset(sizeof(header));
+    header.indexOffset =
+        alignCookedOffset(header.vertexOffset + vertexBytes);
+    header.texelOffset =
+        alignCookedOffset(header.indexOffset + indexBytes);
+    header.texelBytes   = texelBytes;
+    header.fileSize     = header.texelOffset + texelBytes;
+
+    vtx::createCacheDirectory();
+    vtx::writeFileAtomically(cookedMeshPath(key), [&](FILE* file) {
+        return fwrite(&header, sizeof(header), 1, file) == 1 &&
+               writeCookedBlob(
+                   file, header.vertexOffset, mesh->vertices,
+                   vertexBytes
+               ) &&
+               writeCookedBlob(
+                   file, header.indexOffset, mesh->indices, indexBytes
+               ) &&
+               writeCookedBlob(
+                   file, header.texelOffset, mesh->texels, texelBytes
+               );
+    });
+#endif
+}
+
+void vtx::releaseCookedMesh(vtx::CookedMesh* mesh)
+{
+#ifdef VTX_MESH_CACHE
+    if (mesh->mapping != nullptr) {
+        munmap(mesh->mapping, mesh->mappingSize);
+    }
+#endif
+    *mesh = {};
+}
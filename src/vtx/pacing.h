@@ -0,0 +1,264 @@
+#pragma once
+
+#include <GL/glew.h>
+#ifdef __USE_SDL
+#include <SDL2/SDL.h>
+#elif defined(__USE_GLFW)
+#include <GLFW/glfw3.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "./trace.h"
+
+// The browser paces frames with requestAnimationFrame() and WebGL
+// cannot block on a fence, so the web only keeps the statistics.
+#ifndef __EMSCRIPTEN__
+#define VTX_FRAME_PACING
+#endif
+
+// Upper limit of VTX_FRAMES_IN_FLIGHT
+#define VTX_PACING_MAX_IN_FLIGHT (4)
+// Frame intervals the statistics are taken over
+#define VTX_PACING_HISTORY (120)
+// Sleeping stops this many microseconds before the deadline and the
+// rest is spun, since the scheduler wakes sleepers up late
+#define VTX_PACING_SPIN_MICROSECONDS (1500)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+struct FramePacer {
+    int swapInterval;  // as the driver took it, -1 is adaptive vsync
+    double targetFps;  // 0 when frames are not limited
+    int64_t period;    // nanoseconds per frame at targetFps
+    int64_t deadline;  // when the next frame may start
+    float sleptMs;     // how the last frame waited for its deadline
+    float spunMs;
+
+    // Fences of the frames the GPU may still be working on, the driver
+    // would otherwise queue up frames and add their time to latency
+    int maxFramesInFlight;  // 0 when not capped
+    GLsync fences[VTX_PACING_MAX_IN_FLIGHT];
+    int nextFence;
+    float fenceWaitMs;  // how long the last swap waited for the GPU
+
+    // Achieved time between frame starts, in milliseconds
+    float intervals[VTX_PACING_HISTORY];
+    int intervalCount;
+    int nextInterval;
+    int64_t lastFrameStart;
+    float intervalMean;
+    float intervalVariance;  // ms squared
+    float intervalStdDev;
+};
+
+// Sets the swap interval and reads the settings, call with the context
+// current on this thread:
+// - VTX_SWAP_INTERVAL, -1 (the default) for adaptive vsync, which falls
+//   back to 1 where the driver lacks it, 0 for no vsync
+// - VTX_TARGET_FPS, 60 when there is no vsync and unlimited with it,
+//   0 turns the limiter off
+// - VTX_FRAMES_IN_FLIGHT, 2 by default, 0 turns the cap off
+// Benchmarks run with neither vsync nor a limiter.
+void startFramePacing(vtx::FramePacer* pacer, bool benchmark);
+void stopFramePacing(vtx::FramePacer* pacer);
+
+// Sleeps until the deadline of the next frame and spins the last bit,
+// then takes the frame interval into the statistics. Call at the start
+// of every frame, before input is taken.
+void waitForNextFrame(vtx::FramePacer* pacer);
+
+// Fences the frame just swapped and waits until no more than
+// maxFramesInFlight frames are unfinished. Call right after swapping,
+// on the thread that owns the context.
+void limitFramesInFlight(vtx::FramePacer* pacer);
+}  // namespace vtx
+
+static int64_t readPacingClock();
+#ifdef VTX_FRAME_PACING
+static int readPacingSetting(const char* name, int fallback);
+static int setSwapInterval(int interval);
+#endif
+
+// **************
+//  Frame pacing
+// **************
+
+static int64_t readPacingClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()
+    )
+        .count();
+}
+
+#ifdef VTX_FRAME_PACING
+static int readPacingSetting(const char* name, int fallback)
+{
+    const char* setting = getenv(name);
+    if (setting == nullptr || setting[0] == '\0') return fallback;
+    return atoi(setting);
+}
+
+// Returns the interval the driver took
+static int setSwapInterval(int interval)
+{
+#ifdef __USE_SDL
+    if (SDL_GL_SetSwapInterval(interval) == 0) return interval;
+    if (interval == -1 && SDL_GL_SetSwapInterval(1) == 0) return 1;
+    return SDL_GL_GetSwapInterval();
+#elif defined(__USE_GLFW)
+    if (interval == -1 &&
+        !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+        !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+        interval = 1;
+    }
+    glfwSwapInterval(interval);
+    return interval;
+#endif
+}
+#endif
+
+void vtx::startFramePacing(vtx::FramePacer* pacer, bool benchmark)
+{
+    *pacer = {};
+
+#ifdef VTX_FRAME_PACING
+    int interval = readPacingSetting("VTX_SWAP_INTERVAL", -1);
+    pacer->swapInterval = setSwapInterval(benchmark ? 0 : interval);
+
+    int fps = readPacingSetting(
+        "VTX_TARGET_FPS", pacer->swapInterval == 0 ? 60 : 0
+    );
+    if (!benchmark && fps > 0) {
+        pacer->targetFps = fps;
+        pacer->period    = 1000000000LL / fps;
+    }
+
+    pacer->maxFramesInFlight = std::clamp(
+        readPacingSetting("VTX_FRAMES_IN_FLIGHT", 2), 0,
+        VTX_PACING_MAX_IN_FLIGHT
+    );
+
+    std::cerr << "Frame pacing: swap interval " << pacer->swapInterval
+              << ", target " << pacer->targetFps << " FPS, "
+              << pacer->maxFramesInFlight << " frames in flight"
+              << std::endl;
+#else
+    (void) benchmark;
+#endif
+
+    pacer->deadline       = readPacingClock();
+    pacer->lastFrameStart = pacer->deadline;
+}
+
+void vtx::stopFramePacing(vtx::FramePacer* pacer)
+{
+#ifdef VTX_FRAME_PACING
+    for (int i = 0; i < VTX_PACING_MAX_IN_FLIGHT; i++) {
+        if (pacer->fences[i] != nullptr) glDeleteSync(pacer->fences[i]);
+        pacer->fences[i] = nullptr;
+    }
+#else
+    (void) pacer;
+#endif
+}
+
+void vtx::waitForNextFrame(vtx::FramePacer* pacer)
+{
+    VTX_TRACE_SCOPE("waitForNextFrame");
+    int64_t now = readPacingClock();
+
+#ifdef VTX_FRAME_PACING
+    pacer->sleptMs = 0.0f;
+    pacer->spunMs  = 0.0f;
+    if (pacer->period > 0) {
+        // Deadlines move by whole periods, so a late frame does not
+        // push every later one back. More than a period late starts a
+        // new schedule instead of rushing frames to catch up.
+        pacer->deadline += pacer->period;
+        if (now - pacer->deadline > pacer->period) {
+            pacer->deadline = now;
+        }
+
+        int64_t wakeUp =
+            pacer->deadline - VTX_PACING_SPIN_MICROSECONDS * 1000LL;
+        if (now < wakeUp) {
+            std::this_thread::sleep_for(
+                std::chrono::nanoseconds(wakeUp - now)
+            );
+        }
+        int64_t awake = readPacingClock();
+        pacer->sleptMs = (float) (awake - now) / 1e6f;
+        now = awake;
+        while (now < pacer->deadline) {
+            std::this_thread::yield();
+            now = readPacingClock();
+        }
+        pacer->spunMs = (float) (now - awake) / 1e6f;
+    }
+#endif
+
+    float interval = (float) (now - pacer->lastFrameStart) / 1e6f;
+    pacer->lastFrameStart = now;
+
+    pacer->intervals[pacer->nextInterval] = interval;
+    pacer->nextInterval =
+        (pacer->nextInterval + 1) % VTX_PACING_HISTORY;
+    pacer->intervalCount =
+        std::min(pacer->intervalCount + 1, VTX_PACING_HISTORY);
+
+    double sum = 0.0, squares = 0.0;
+    for (int i = 0; i < pacer->intervalCount; i++) {
+        sum += pacer->intervals[i];
+        squares += (double) pacer->intervals[i] * pacer->intervals[i];
+    }
+    double count            = (double) pacer->intervalCount;
+    double mean             = sum / count;
+    double variance         = squares / count - mean * mean;
+    pacer->intervalMean     = (float) mean;
+    pacer->intervalVariance = (float) std::max(variance, 0.0);
+    pacer->intervalStdDev   = std::sqrt(pacer->intervalVariance);
+}
+
+void vtx::limitFramesInFlight(vtx::FramePacer* pacer)
+{
+    VTX_TRACE_SCOPE("limitFramesInFlight");
+#ifdef VTX_FRAME_PACING
+    pacer->fenceWaitMs = 0.0f;
+    if (pacer->maxFramesInFlight == 0) return;
+
+    pacer->fences[pacer->nextFence] =
+        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pacer->nextFence =
+        (pacer->nextFence + 1) % pacer->maxFramesInFlight;
+
+    // The oldest fence, with a single frame in flight that is the one
+    // just made
+    GLsync oldest = pacer->fences[pacer->nextFence];
+    if (oldest == nullptr) return;
+
+    int64_t start = readPacingClock();
+    GLenum result;
+    do {
+        result = glClientWaitSync(
+            oldest, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000  // 100 ms
+        );
+    } while (result == GL_TIMEOUT_EXPIRED);
+    pacer->fenceWaitMs = (float) (readPacingClock() - start) / 1e6f;
+
+    glDeleteSync(oldest);
+    pacer->fences[pacer->nextFence] = nullptr;
+#else
+    (void) pacer;
+#endif
+}
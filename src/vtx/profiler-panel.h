@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "./gl-state.h"
+#include "./profiler.h"
+#include "imgui.h"
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// Draws the profiler window, call between ImGui::NewFrame() and
+// ImGui::Render() like any other ImGui window
+void showProfilerPanel();
+}  // namespace vtx
+
+static float profilePercentile(
+    const float* samples,
+    int count,
+    float percentile
+);
+static void showProfileTimeline(const vtx::ProfileFrame* frame);
+
+// *********************
+//  ImGui profiler panel
+// *********************
+
+static float profilePercentile(
+    const float* samples,
+    int count,
+    float percentile
+)
+{
+    if (count == 0) return 0.0f;
+
+    static std::vector<float> sorted;
+    sorted.assign(samples, samples + count);
+
+    int nth = (int) (percentile * (float) (count - 1) + 0.5f);
+    std::nth_element(sorted.begin(), sorted.begin() + nth, sorted.end());
+    return sorted[nth];
+}
+
+static void showProfileTimeline(const vtx::ProfileFrame* frame)
+{
+    const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+
+    int maxDepth = 0;
+    for (int i = 0; i < frame->scopeCount; i++) {
+        maxDepth = std::max(maxDepth, frame->scopes[i].depth);
+    }
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width   = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+    float height  = rowHeight * (float) (maxDepth + 1);
+    ImGui::Dummy(ImVec2(width, height));
+
+    if (frame->cpuTime <= 0.0) return;
+    float msToPixels = width / (float) frame->cpuTime;
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    for (int i = 0; i < frame->scopeCount; i++) {
+        const vtx::ProfileScope* scope = &frame->scopes[i];
+        if (scope->cpuEnd < 0.0) continue;
+
+        ImVec2 from(
+            origin.x + (float) scope->cpuStart * msToPixels,
+            origin.y + (float) scope->depth * rowHeight
+        );
+        ImVec2 to(
+            std::max(
+                origin.x + (float) scope->cpuEnd * msToPixels,
+                from.x + 1.0f
+            ),
+            from.y + rowHeight - 1.0f
+        );
+
+        // Scopes measured on the GPU as well are drawn in orange
+        ImU32 color = scope->gpuTime >= 0.0 ? IM_COL32(200, 120, 40, 255)
+                                            : IM_COL32(60, 120, 200, 255);
+        drawList->AddRectFilled(from, to, color);
+
+        // Only label the boxes that are wide enough to hold a label
+        if (to.x - from.x > 40.0f) {
+            drawList->AddText(
+                ImVec2(from.x + 2.0f, from.y + 2.0f),
+                IM_COL32(255, 255, 255, 255), scope->name
+            );
+        }
+    }
+}
+
+void vtx::showProfilerPanel()
+{
+    if (ImGui::Begin("Profiler")) {
+        ImGui::Checkbox("Enabled", &profiler.enabled);
+#ifdef VTX_PROFILER_GPU_TIMERS
+        ImGui::SameLine();
+        ImGui::Checkbox("GPU timers", &profiler.gpuTimers);
+#endif
+
+        const vtx::ProfileFrame* frame = &profiler.resolved;
+        ImGui::Text(
+            "Frame %llu: %.3f ms CPU",
+            (unsigned long long) frame->frameIndex, frame->cpuTime
+        );
+        showProfileTimeline(frame);
+        ImGui::Text(
+            "GL state calls: %llu issued, %llu skipped",
+            (unsigned long long) glState.lastFrameIssued,
+            (unsigned long long) glState.lastFrameSkipped
+        );
+
+        ImGui::Separator();
+        if (ImGui::BeginTable(
+                "Scopes", 7,
+                ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg
+            )) {
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("CPU p50");
+            ImGui::TableSetupColumn("CPU p95");
+            ImGui::TableSetupColumn("CPU p99");
+            ImGui::TableSetupColumn("GPU p50");
+            ImGui::TableSetupColumn("GPU p95");
+            ImGui::TableSetupColumn("GPU p99");
+            ImGui::TableHeadersRow();
+
+            for (const vtx::ProfileHistory& h : profiler.history) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", h.name);
+
+                const float percentiles[] = {0.50f, 0.95f, 0.99f};
+                for (float p : percentiles) {
+                    ImGui::TableNextColumn();
+                    ImGui::Text(
+                        "%.3f", profilePercentile(h.cpu, h.cpuCount, p)
+                    );
+                }
+                for (float p : percentiles) {
+                    ImGui::TableNextColumn();
+                    if (h.gpuCount == 0) {
+                        ImGui::TextDisabled("-");
+                    } else {
+                        ImGui::Text(
+                            "%.3f",
+                            profilePercentile(h.gpu, h.gpuCount, p)
+                        );
+                    }
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <GL/glew.h>
+#ifdef __USE_SDL
+#include <SDL2/SDL.h>
+#elif defined(__USE_GLFW)
+#include <GLFW/glfw3.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "./trace.h"
+
+// Frames are kept in a ring, GPU timer queries of a frame are only read
+// back when its slot comes around again, so they never stall the CPU.
+#define VTX_PROFILER_LATENCY (4)
+#define VTX_PROFILER_MAX_SCOPES (128)
+#define VTX_PROFILER_MAX_DEPTH (16)
+#define VTX_PROFILER_HISTORY (240)
+
+// WebGL only has timer queries behind a disjoint-timer extension,
+// which is not worth the trouble here, so the web build is CPU only.
+#ifndef __EMSCRIPTEN__
+#define VTX_PROFILER_GPU_TIMERS
+#endif
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+struct ProfileScope {
+    const char* name;
+    int depth;
+    double cpuStart;  // ms since the frame started
+    double cpuEnd;    // ms since the frame started
+    GLuint gpuQuery;  // 0 when GPU time is not measured
+    double gpuTime;   // ms, negative when not known
+};
+
+struct ProfileFrame {
+    uint64_t frameIndex;
+    double cpuTime;  // ms of the whole frame
+    int scopeCount;
+    ProfileScope scopes[VTX_PROFILER_MAX_SCOPES];
+};
+
+// Rolling samples of one scope name, for the percentiles
+struct ProfileHistory {
+    const char* name;
+    float cpu[VTX_PROFILER_HISTORY];
+    float gpu[VTX_PROFILER_HISTORY];
+    int cpuCount, gpuCount;
+    int cpuHead, gpuHead;
+};
+
+struct Profiler {
+    bool enabled   = true;
+    bool gpuTimers = true;
+
+    // Frames and scopes belong to the thread that runs the main loop,
+    // scopes on any other thread (the render thread) are ignored
+    std::thread::id thread = std::this_thread::get_id();
+
+    bool frameOpen   = false;
+    uint64_t frameIndex = 0;
+    uint64_t frameStart = 0;
+    double tickToMs     = 0.0;
+    int current         = 0;
+    ProfileFrame frames[VTX_PROFILER_LATENCY];
+
+    int stack[VTX_PROFILER_MAX_DEPTH];
+    int stackDepth = 0;
+    int gpuScope   = -1;  // owner of the single running GPU query
+
+    std::vector<GLuint> freeQueries;
+    std::vector<ProfileHistory> history;
+
+    // Newest frame with all GPU results resolved, this is what is shown
+    ProfileFrame resolved;
+};
+
+void beginProfilerFrame();
+void endProfilerFrame();
+int beginProfileScope(const char* name, bool gpu);
+void endProfileScope(int scopeIndex);
+
+struct ProfileScopeGuard {
+    int scopeIndex;
+
+    ProfileScopeGuard(const char* name, bool gpu)
+        : scopeIndex(beginProfileScope(name, gpu))
+    {
+    }
+    ~ProfileScopeGuard() { endProfileScope(scopeIndex); }
+};
+}  // namespace vtx
+
+static uint64_t readProfilerClock();
+static void resolveProfileFrame(vtx::ProfileFrame* frame);
+static void recordProfileHistory(
+    const char* name,
+    double cpuTime,
+    double gpuTime
+);
+static void pushProfileSample(
+    float* samples,
+    int* count,
+    int* head,
+    float value
+);
+
+// Profiled scopes are traced as well, see trace.h
+#ifdef VTX_DISABLE_PROFILER
+#define VTX_PROFILE_SCOPE(name) VTX_TRACE_SCOPE(name)
+#define VTX_PROFILE_GPU_SCOPE(name) VTX_TRACE_SCOPE(name)
+#else
+#define VTX_PROFILE_CONCAT_(a, b) a##b
+#define VTX_PROFILE_CONCAT(a, b) VTX_PROFILE_CONCAT_(a, b)
+// CPU time of the enclosing block
+#define VTX_PROFILE_SCOPE(name)                                    \
+    VTX_TRACE_SCOPE(name);                                         \
+    vtx::ProfileScopeGuard VTX_PROFILE_CONCAT(vtxProfileScope, __LINE__)( \
+        name, false                                                \
+    )
+// CPU and GPU time of the enclosing block, GPU scopes do not nest
+#define VTX_PROFILE_GPU_SCOPE(name)                                \
+    VTX_TRACE_SCOPE(name);                                         \
+    vtx::ProfileScopeGuard VTX_PROFILE_CONCAT(vtxProfileScope, __LINE__)( \
+        name, true                                                 \
+    )
+#endif
+
+// **********************
+//  Global state context
+// **********************
+
+static vtx::Profiler profiler;
+
+// *****************
+//  Frame lifecycle
+// *****************
+
+static uint64_t readProfilerClock()
+{
+#ifdef __USE_SDL
+    return SDL_GetPerformanceCounter();
+#elif defined(__USE_GLFW)
+    return glfwGetTimerValue();
+#endif
+}
+
+void vtx::beginProfilerFrame()
+{
+    if (!profiler.enabled) return;
+
+    if (profiler.tickToMs == 0.0) {
+#ifdef __USE_SDL
+        profiler.tickToMs = 1000.0 / (double) SDL_GetPerformanceFrequency();
+#elif defined(__USE_GLFW)
+        profiler.tickToMs = 1000.0 / (double) glfwGetTimerFrequency();
+#endif
+    }
+
+    // The slot about to be reused is the oldest one, its queries had
+    // VTX_PROFILER_LATENCY - 1 frames to finish on the GPU
+    profiler.current = (profiler.current + 1) % VTX_PROFILER_LATENCY;
+    vtx::ProfileFrame* frame = &profiler.frames[profiler.current];
+    if (frame->scopeCount > 0) {
+        resolveProfileFrame(frame);
+    }
+
+    frame->frameIndex = profiler.frameIndex++;
+    frame->cpuTime    = 0.0;
+    frame->scopeCount = 0;
+
+    profiler.stackDepth = 0;
+    profiler.gpuScope   = -1;
+    profiler.frameStart = readProfilerClock();
+    profiler.frameOpen  = true;
+}
+
+void vtx::endProfilerFrame()
+{
+    if (!profiler.frameOpen) return;
+
+    // Scopes left open would otherwise leak into the next frame
+    while (profiler.stackDepth > 0) {
+        endProfileScope(profiler.stack[profiler.stackDepth - 1]);
+    }
+
+    vtx::ProfileFrame* frame = &profiler.frames[profiler.current];
+    frame->cpuTime =
+        (double) (readProfilerClock() - profiler.frameStart) *
+        profiler.tickToMs;
+    profiler.frameOpen = false;
+}
+
+int vtx::beginProfileScope(const char* name, bool gpu)
+{
+    // Scopes outside of the main loop, like in vtx::init(), are ignored
+    if (std::this_thread::get_id() != profiler.thread) return -1;
+    if (!profiler.frameOpen) return -1;
+
+    vtx::ProfileFrame* frame = &profiler.frames[profiler.current];
+    if (frame->scopeCount >= VTX_PROFILER_MAX_SCOPES ||
+        profiler.stackDepth >= VTX_PROFILER_MAX_DEPTH) {
+        return -1;
+    }
+
+    int scopeIndex            = frame->scopeCount++;
+    vtx::ProfileScope* scope  = &frame->scopes[scopeIndex];
+    scope->name               = name;
+    scope->depth              = profiler.stackDepth;
+    scope->cpuEnd             = -1.0;
+    scope->gpuQuery           = 0;
+    scope->gpuTime            = -1.0;
+
+    profiler.stack[profiler.stackDepth++] = scopeIndex;
+
+#ifdef VTX_PROFILER_GPU_TIMERS
+    // Only one GL_TIME_ELAPSED query may run at a time,
+    // scopes nested in a GPU scope get CPU time only
+    if (gpu && profiler.gpuTimers && profiler.gpuScope < 0) {
+        if (profiler.freeQueries.empty()) {
+            GLuint query;
+            glGenQueries(1, &query);
+            profiler.freeQueries.push_back(query);
+        }
+        scope->gpuQuery = profiler.freeQueries.back();
+        profiler.freeQueries.pop_back();
+        profiler.gpuScope = scopeIndex;
+        glBeginQuery(GL_TIME_ELAPSED, scope->gpuQuery);
+    }
+#endif
+
+    // Taken last, so the setup above is not counted in the scope
+    scope->cpuStart = (double) (readProfilerClock() - profiler.frameStart) *
+                      profiler.tickToMs;
+    return scopeIndex;
+}
+
+void vtx::endProfileScope(int scopeIndex)
+{
+    if (scopeIndex < 0 || !profiler.frameOpen) return;
+
+    vtx::ProfileFrame* frame = &profiler.frames[profiler.current];
+    vtx::ProfileScope* scope = &frame->scopes[scopeIndex];
+    scope->cpuEnd = (double) (readProfilerClock() - profiler.frameStart) *
+                    profiler.tickToMs;
+
+#ifdef VTX_PROFILER_GPU_TIMERS
+    if (profiler.gpuScope == scopeIndex) {
+        glEndQuery(GL_TIME_ELAPSED);
+        profiler.gpuScope = -1;
+    }
+#endif
+
+    // Unwind to this scope, which also closes any forgotten children
+    while (profiler.stackDepth > 0) {
+        if (profiler.stack[--profiler.stackDepth] == scopeIndex) break;
+    }
+}
+
+// **********************
+//  Readback and history
+// **********************
+
+static void resolveProfileFrame(vtx::ProfileFrame* frame)
+{
+    for (int i = 0; i < frame->scopeCount; i++) {
+        vtx::ProfileScope* scope = &frame->scopes[i];
+
+#ifdef VTX_PROFILER_GPU_TIMERS
+        if (scope->gpuQuery != 0) {
+            GLint available = 0;
+            glGetQueryObjectiv(
+                scope->gpuQuery, GL_QUERY_RESULT_AVAILABLE, &available
+            );
+            // Not ready yet means the GPU is far behind,
+            // the sample is dropped rather than waited for
+            if (available) {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(
+                    scope->gpuQuery, GL_QUERY_RESULT, &nanoseconds
+                );
+                scope->gpuTime = (double) nanoseconds / 1000000.0;
+            }
+            profiler.freeQueries.push_back(scope->gpuQuery);
+            scope->gpuQuery = 0;
+        }
+#endif
+    }
+
+    // A scope that runs many times per frame, like a draw call,
+    // is recorded once with the sum of all its runs
+    for (int i = 0; i < frame->scopeCount; i++) {
+        const vtx::ProfileScope* scope = &frame->scopes[i];
+
+        bool seenBefore = false;
+        for (int j = 0; j < i && !seenBefore; j++) {
+            seenBefore = strcmp(frame->scopes[j].name, scope->name) == 0;
+        }
+        if (seenBefore) continue;
+
+        double cpuTotal = 0.0, gpuTotal = 0.0;
+        bool hasGpu = false;
+        for (int j = i; j < frame->scopeCount; j++) {
+            const vtx::ProfileScope* same = &frame->scopes[j];
+            if (strcmp(same->name, scope->name) != 0) continue;
+
+            if (same->cpuEnd >= 0.0) {
+                cpuTotal += same->cpuEnd - same->cpuStart;
+            }
+            if (same->gpuTime >= 0.0) {
+                gpuTotal += same->gpuTime;
+                hasGpu = true;
+            }
+        }
+        recordProfileHistory(scope->name, cpuTotal, hasGpu ? gpuTotal : -1.0);
+    }
+
+    profiler.resolved = *frame;
+}
+
+static void recordProfileHistory(
+    const char* name,
+    double cpuTime,
+    double gpuTime
+)
+{
+    vtx::ProfileHistory* history = nullptr;
+    for (vtx::ProfileHistory& h : profiler.history) {
+        if (h.name == name || strcmp(h.name, name) == 0) {
+            history = &h;
+            break;
+        }
+    }
+    if (history == nullptr) {
+        profiler.history.emplace_back();
+        history = &profiler.history.back();
+        memset(history, 0, sizeof(vtx::ProfileHistory));
+        history->name = name;
+    }
+
+    pushProfileSample(
+        history->cpu, &history->cpuCount, &history->cpuHead,
+        (float) cpuTime
+    );
+    if (gpuTime >= 0.0) {
+        pushProfileSample(
+            history->gpu, &history->gpuCount, &history->gpuHead,
+            (float) gpuTime
+        );
+    }
+}
+
+static void pushProfileSample(
+    float* samples,
+    int* count,
+    int* head,
+    float value
+)
+{
+    samples[*head] = value;
+    *head          = (*head + 1) % VTX_PROFILER_HISTORY;
+    if (*count < VTX_PROFILER_HISTORY) (*count)++;
+}
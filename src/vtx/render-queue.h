@@ -0,0 +1,447 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <vector>
+
+#include "./ctx.h"
+#include "./gl-state.h"
+#include "./profiler.h"
+#include "./shader-program.h"
+
+// Sort key layout, most significant bits first. Opaque passes sort by
+// state and then front to back, so the depth test rejects early:
+//
+//   63..60 pass | 59..48 program | 47..36 texture | 35..24 VAO |
+//   23..0 depth
+//
+// Blended passes must be drawn back to front whatever the state is,
+// so there the depth, inverted, comes right after the pass:
+//
+//   63..60 pass | 59..36 far-to-near depth | 35..24 program |
+//   23..12 texture | 11..0 VAO
+//
+// Object names are cut to 12 bits, two objects sharing the bits only
+// sort a little worse, state is always compared in full when drawing.
+#define VTX_RENDER_KEY_DEPTH_MAX (0xFFFFFFu)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+enum RenderPass {
+    RENDER_PASS_OPAQUE      = 0,
+    RENDER_PASS_TRANSPARENT = 8,  // this one and up sort back to front
+    RENDER_PASS_OVERLAY     = 12,
+};
+
+// depth is the distance from the camera scaled to 0..1, usually the
+// view space distance divided by the far plane
+uint64_t makeRenderKey(
+    RenderPass pass,
+    GLuint program,
+    GLuint texture,
+    GLuint vertexArray,
+    float depth
+);
+
+// One uniform value that belongs to a single draw, the bytes live in
+// RenderQueue::uniformData
+struct DrawUniform {
+    const UniformHandle* uniform;
+    GLenum type;
+    int count;  // array elements
+    bool transpose;
+    uint32_t offset;
+};
+
+struct DrawPacket {
+    uint64_t key;
+    const ShaderProgram* shader;
+    GLuint vertexArray;
+    GLuint texture;  // bound to unit 0, 0 to leave the unit alone
+    GLenum mode;
+    GLsizei count;
+    GLenum indexType;     // 0 draws with glDrawArrays()
+    const void* indices;  // byte offset into the element buffer
+    GLint first;          // first vertex, only for glDrawArrays()
+    uint32_t uniformFirst;
+    uint32_t uniformCount;
+};
+
+struct RenderSortItem {
+    uint64_t key;
+    uint32_t packet;
+};
+
+// Collects the draws of a frame, sorts them by key and then issues
+// them, so GL state changes follow the key and not the order in which
+// objects happened to submit. Uniform handles and programs are kept by
+// pointer and must live until flush().
+struct RenderQueue {
+    std::vector<DrawPacket> packets;
+    std::vector<DrawUniform> uniforms;
+    std::vector<unsigned char> uniformData;
+    std::vector<RenderSortItem> sorted;
+    std::vector<RenderSortItem> scratch;
+
+    // What the last flush() did, for the profiler panel and such
+    int lastPackets        = 0;
+    int lastProgramChanges = 0;
+
+    void drawElements(
+        uint64_t key,
+        const ShaderProgram* shader,
+        GLuint vertexArray,
+        GLuint texture,
+        GLenum mode,
+        GLsizei count,
+        GLenum indexType,
+        const void* indices
+    );
+    void drawArrays(
+        uint64_t key,
+        const ShaderProgram* shader,
+        GLuint vertexArray,
+        GLuint texture,
+        GLenum mode,
+        GLint first,
+        GLsizei count
+    );
+
+    // Uniform values of the draw submitted last
+    void set(const UniformHandle& uniform, int value);
+    void set(const UniformHandle& uniform, float value);
+    void set(const UniformHandle& uniform, const glm::vec3& value);
+    void set(const UniformHandle& uniform, const glm::vec4& value);
+    void set(const UniformHandle& uniform, const glm::mat4& value);
+    // Arrays like bone palettes, copied so the caller may reuse them
+    void set(
+        const UniformHandle& uniform,
+        const glm::mat4* values,
+        int count,
+        bool transpose = false
+    );
+
+    void sort();
+    void flush();  // sorts, draws and empties the queue
+    void clear();
+
+    DrawPacket* push(
+        uint64_t key,
+        const ShaderProgram* shader,
+        GLuint vertexArray,
+        GLuint texture,
+        GLenum mode,
+        GLsizei count
+    );
+    void pushUniform(
+        const UniformHandle& uniform,
+        GLenum type,
+        const void* data,
+        size_t bytes,
+        int count      = 1,
+        bool transpose = false
+    );
+};
+}  // namespace vtx
+
+static void radixSortRenderItems(
+    std::vector<vtx::RenderSortItem>* items,
+    std::vector<vtx::RenderSortItem>* scratch
+);
+
+// ***********
+//  Sort keys
+// ***********
+
+uint64_t vtx::makeRenderKey(
+    RenderPass pass,
+    GLuint program,
+    GLuint texture,
+    GLuint vertexArray,
+    float depth
+)
+{
+    uint64_t depthBits =
+        (uint64_t) (std::clamp(depth, 0.0f, 1.0f) *
+                    (float) VTX_RENDER_KEY_DEPTH_MAX);
+    uint64_t key = (uint64_t) (pass & 0xF) << 60;
+
+    if (pass >= RENDER_PASS_TRANSPARENT) {
+        key |= (VTX_RENDER_KEY_DEPTH_MAX - depthBits) << 36;
+        key |= (uint64_t) (program & 0xFFF) << 24;
+        key |= (uint64_t) (texture & 0xFFF) << 12;
+        key |= (uint64_t) (vertexArray & 0xFFF);
+    } else {
+        key |= (uint64_t) (program & 0xFFF) << 48;
+        key |= (uint64_t) (texture & 0xFFF) << 36;
+        key |= (uint64_t) (vertexArray & 0xFFF) << 24;
+        key |= depthBits;
+    }
+    return key;
+}
+
+// ************
+//  Submitting
+// ************
+
+vtx::DrawPacket* vtx::RenderQueue::push(
+    uint64_t key,
+    const ShaderProgram* shader,
+    GLuint vertexArray,
+    GLuint texture,
+    GLenum mode,
+    GLsizei count
+)
+{
+    this->packets.emplace_back();
+    vtx::DrawPacket* packet = &this->packets.back();
+    packet->key             = key;
+    packet->shader          = shader;
+    packet->vertexArray     = vertexArray;
+    packet->texture         = texture;
+    packet->mode            = mode;
+    packet->count           = count;
+    packet->indexType       = 0;
+    packet->indices         = nullptr;
+    packet->first           = 0;
+    packet->uniformFirst    = (uint32_t) this->uniforms.size();
+    packet->uniformCount    = 0;
+    return packet;
+}
+
+void vtx::RenderQueue::drawElements(
+    uint64_t key,
+    const ShaderProgram* shader,
+    GLuint vertexArray,
+    GLuint texture,
+    GLenum mode,
+    GLsizei count,
+    GLenum indexType,
+    const void* indices
+)
+{
+    vtx::DrawPacket* packet =
+        this->push(key, shader, vertexArray, texture, mode, count);
+    packet->indexType = indexType;
+    packet->indices   = indices;
+}
+
+void vtx::RenderQueue::drawArrays(
+    uint64_t key,
+    const ShaderProgram* shader,
+    GLuint vertexArray,
+    GLuint texture,
+    GLenum mode,
+    GLint first,
+    GLsizei count
+)
+{
+    vtx::DrawPacket* packet =
+        this->push(key, shader, vertexArray, texture, mode, count);
+    packet->first = first;
+}
+
+void vtx::RenderQueue::pushUniform(
+    const UniformHandle& uniform,
+    GLenum type,
+    const void* data,
+    size_t bytes,
+    int count,
+    bool transpose
+)
+{
+    if (this->packets.empty()) return;
+
+    vtx::DrawUniform value;
+    value.uniform   = &uniform;
+    value.type      = type;
+    value.count     = count;
+    value.transpose = transpose;
+    value.offset    = (uint32_t) this->uniformData.size();
+    this->uniformData.insert(
+        this->uniformData.end(), (const unsigned char*) data,
+        (const unsigned char*) data + bytes
+    );
+    this->uniforms.push_back(value);
+    this->packets.back().uniformCount++;
+}
+
+void vtx::RenderQueue::set(const UniformHandle& uniform, int value)
+{
+    this->pushUniform(uniform, GL_INT, &value, sizeof(value));
+}
+
+void vtx::RenderQueue::set(const UniformHandle& uniform, float value)
+{
+    this->pushUniform(uniform, GL_FLOAT, &value, sizeof(value));
+}
+
+void vtx::RenderQueue::set(
+    const UniformHandle& uniform,
+    const glm::vec3& value
+)
+{
+    this->pushUniform(
+        uniform, GL_FLOAT_VEC3, glm::value_ptr(value), sizeof(value)
+    );
+}
+
+void vtx::RenderQueue::set(
+    const UniformHandle& uniform,
+    const glm::vec4& value
+)
+{
+    this->pushUniform(
+        uniform, GL_FLOAT_VEC4, glm::value_ptr(value), sizeof(value)
+    );
+}
+
+void vtx::RenderQueue::set(
+    const UniformHandle& uniform,
+    const glm::mat4& value
+)
+{
+    this->pushUniform(
+        uniform, GL_FLOAT_MAT4, glm::value_ptr(value), sizeof(value)
+    );
+}
+
+void vtx::RenderQueue::set(
+    const UniformHandle& uniform,
+    const glm::mat4* values,
+    int count,
+    bool transpose
+)
+{
+    this->pushUniform(
+        uniform, GL_FLOAT_MAT4, glm::value_ptr(values[0]),
+        sizeof(glm::mat4) * count, count, transpose
+    );
+}
+
+// *********
+//  Sorting
+// *********
+
+void vtx::RenderQueue::sort()
+{
+    this->sorted.resize(this->packets.size());
+    for (size_t i = 0; i < this->packets.size(); i++) {
+        this->sorted[i].key    = this->packets[i].key;
+        this->sorted[i].packet = (uint32_t) i;
+    }
+    radixSortRenderItems(&this->sorted, &this->scratch);
+}
+
+// Least significant byte first, each pass is stable so the order of
+// the earlier bytes survives. Only the small items are moved, never
+// the packets themselves.
+static void radixSortRenderItems(
+    std::vector<vtx::RenderSortItem>* items,
+    std::vector<vtx::RenderSortItem>* scratch
+)
+{
+    size_t count = items->size();
+    if (count < 2) return;
+    scratch->resize(count);
+
+    vtx::RenderSortItem* from = items->data();
+    vtx::RenderSortItem* to   = scratch->data();
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {0};
+        for (size_t i = 0; i < count; i++) {
+            offsets[(from[i].key >> shift) & 0xFF]++;
+        }
+
+        // Keys often share whole bytes (same pass, few programs), a
+        // pass over such a byte would not move anything
+        if (offsets[(from[0].key >> shift) & 0xFF] == count) continue;
+
+        size_t total = 0;
+        for (int bucket = 0; bucket < 256; bucket++) {
+            size_t inBucket = offsets[bucket];
+            offsets[bucket] = total;
+            total += inBucket;
+        }
+        for (size_t i = 0; i < count; i++) {
+            to[offsets[(from[i].key >> shift) & 0xFF]++] = from[i];
+        }
+        std::swap(from, to);
+    }
+
+    if (from != items->data()) {
+        memcpy(items->data(), from, count * sizeof(vtx::RenderSortItem));
+    }
+}
+
+// *********
+//  Drawing
+// *********
+
+void vtx::RenderQueue::flush()
+{
+    VTX_PROFILE_GPU_SCOPE("RenderQueue::flush");
+
+    this->sort();
+
+    const vtx::ShaderProgram* shader = nullptr;
+    int programChanges               = 0;
+    for (const vtx::RenderSortItem& item : this->sorted) {
+        const vtx::DrawPacket* packet = &this->packets[item.packet];
+
+        if (packet->shader != shader) {
+            shader = packet->shader;
+            shader->use();
+            programChanges++;
+        }
+
+        // The program is bound, so these go out right away, and values
+        // that did not change since the last draw are skipped
+        for (uint32_t i = 0; i < packet->uniformCount; i++) {
+            const vtx::DrawUniform* value =
+                &this->uniforms[packet->uniformFirst + i];
+            shader->write(
+                *value->uniform, value->type,
+                &this->uniformData[value->offset], value->count,
+                value->transpose
+            );
+        }
+
+        vtx::bindVertexArray(packet->vertexArray);
+        if (packet->texture != 0) {
+            vtx::activeTexture(GL_TEXTURE0);
+            vtx::bindTexture(GL_TEXTURE_2D, packet->texture);
+        }
+
+        if (packet->indexType != 0) {
+            vtx::drawElements(
+                packet->mode, packet->count, packet->indexType,
+                packet->indices
+            );
+        } else {
+            vtx::drawArrays(packet->mode, packet->first, packet->count);
+        }
+    }
+    vtx::bindVertexArray(0);
+
+    this->lastPackets        = (int) this->sorted.size();
+    this->lastProgramChanges = programChanges;
+    this->clear();
+}
+
+void vtx::RenderQueue::clear()
+{
+    // Keeps the capacity, the next frame submits about as much
+    this->packets.clear();
+    this->uniforms.clear();
+    this->uniformData.clear();
+    this->sorted.clear();
+}
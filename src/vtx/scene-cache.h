@@ -0,0 +1,296 @@
+#pragma once
+
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <stb_image.h>
+
+#include <assimp/Importer.hpp>
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "./jobs.h"
+#include "./texture-batch.h"
+#include "./trace.h"
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// An embedded texture, decoded when the file is imported however many
+// meshes use it
+struct SceneTexture {
+    unsigned char* texels;  // 8 bits per channel
+    int width, height;
+    int channels;  // 3 or 4
+};
+
+// One import of a file, shared by every mesh loaded from it
+struct CachedScene {
+    std::string path;
+    unsigned int importFlags;
+    std::unique_ptr<Assimp::Importer> importer;
+    const aiScene* scene;  // nullptr until a mesh is asked for
+    bool failed;
+    int pins;  // under sceneCacheLock
+    // Held while importing and decoding, so a second thread asking for
+    // the same file waits for the first import instead of repeating it
+    std::mutex lock;
+
+    // Built once per import instead of searched per mesh
+    std::unordered_map<std::string, unsigned int> meshIndices;
+    std::vector<const aiNode*> meshNodes;  // by mesh index
+
+    std::unordered_map<const aiTexture*, vtx::SceneTexture> textures;
+};
+
+// Keeps the import of a file alive. Pinning is cheap, nothing is
+// imported until a mesh is looked up, and the last pin to go frees the
+// scene and its textures. Hold one around loading several meshes of a
+// file, so they share a single import. Pins may be taken and released
+// on any thread.
+struct ScenePin {
+    vtx::CachedScene* cached = nullptr;
+
+    ScenePin() = default;
+    ScenePin(const ScenePin&)            = delete;
+    ScenePin& operator=(const ScenePin&) = delete;
+    ScenePin(ScenePin&& other) noexcept;
+    ScenePin& operator=(ScenePin&& other) noexcept;
+    ~ScenePin() { this->release(); }
+
+    void pin(const char* path);
+    void release();
+};
+
+struct SceneMesh {
+    const aiScene* scene;  // nullptr when the file did not import
+    const aiMesh* mesh;    // nullptr when no mesh has the name
+    unsigned int meshIndex;
+    const aiNode* node;  // the node that draws the mesh
+};
+
+// Imports the pinned file on first use and finds the mesh by name. The
+// pointers stay valid while the pin is held. A file is imported with
+// the flags of the first lookup.
+vtx::SceneMesh findSceneMesh(
+    vtx::ScenePin* pin,
+    const char* meshName,
+    unsigned int importFlags
+);
+
+// The embedded diffuse texture of the mesh material, nullptr when there
+// is none or it did not decode. Valid while the pin is held.
+const vtx::SceneTexture* sceneDiffuseTexture(
+    vtx::ScenePin* pin,
+    const vtx::SceneMesh& mesh
+);
+}  // namespace vtx
+
+static void importCachedScene(vtx::CachedScene* cached);
+static void indexSceneNodes(
+    vtx::CachedScene* cached,
+    const aiNode* node
+);
+static void freeCachedScene(vtx::CachedScene* cached);
+static void decodeSceneTextures(vtx::CachedScene* cached);
+
+// **********************
+//  Global state context
+// **********************
+
+static std::unordered_map<std::string, vtx::CachedScene> sceneCache;
+static std::mutex sceneCacheLock;
+
+// *********
+//  Pinning
+// *********
+
+vtx::ScenePin::ScenePin(ScenePin&& other) noexcept
+    : cached(std::exchange(other.cached, nullptr))
+{
+}
+
+vtx::ScenePin& vtx::ScenePin::operator=(ScenePin&& other) noexcept
+{
+    if (this != &other) {
+        this->release();
+        this->cached = std::exchange(other.cached, nullptr);
+    }
+    return *this;
+}
+
+void vtx::ScenePin::pin(const char* path)
+{
+    this->release();
+    std::lock_guard<std::mutex> guard(sceneCacheLock);
+    vtx::CachedScene* cached = &sceneCache[path];
+    cached->path             = path;
+    cached->pins++;
+    this->cached = cached;
+}
+
+void vtx::ScenePin::release()
+{
+    if (this->cached == nullptr) return;
+    std::lock_guard<std::mutex> guard(sceneCacheLock);
+    if (--this->cached->pins == 0) {
+        freeCachedScene(this->cached);
+        std::string path = this->cached->path;  // erase() frees it
+        sceneCache.erase(path);
+    }
+    this->cached = nullptr;
+}
+
+static void freeCachedScene(vtx::CachedScene* cached)
+{
+    for (auto& [embedded, texture] : cached->textures) {
+        stbi_image_free(texture.texels);
+    }
+    cached->textures.clear();
+    cached->importer.reset();  // owns the scene
+    cached->scene = nullptr;
+}
+
+// ********
+//  Lookup
+// ********
+
+static void indexSceneNodes(
+    vtx::CachedScene* cached,
+    const aiNode* node
+)
+{
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+        cached->meshNodes[node->mMeshes[i]] = node;
+    }
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        indexSceneNodes(cached, node->mChildren[i]);
+    }
+}
+
+static void importCachedScene(vtx::CachedScene* cached)
+{
+    VTX_TRACE_SCOPE_DETAIL(
+        "Assimp::Importer::ReadFile", cached->path.c_str()
+    );
+    cached->importer = std::make_unique<Assimp::Importer>();
+    const aiScene* scene =
+        cached->importer->ReadFile(cached->path, cached->importFlags);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+        !scene->mRootNode) {
+        std::cerr << "Error loading " << cached->path << ": "
+                  << cached->importer->GetErrorString() << std::endl;
+        cached->failed = true;
+        return;
+    }
+    cached->scene = scene;
+
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        // The first of several meshes with one name wins
+        const char* name = scene->mMeshes[i]->mName.C_Str();
+        cached->meshIndices.emplace(name, i);
+    }
+    cached->meshNodes.assign(scene->mNumMeshes, nullptr);
+    indexSceneNodes(cached, scene->mRootNode);
+    decodeSceneTextures(cached);
+}
+
+// All embedded textures at once, spread over the job workers
+static void decodeSceneTextures(vtx::CachedScene* cached)
+{
+    const aiScene* scene = cached->scene;
+    std::vector<vtx::TextureDecode> decodes;
+    std::vector<const aiTexture*> embedded;
+    for (unsigned int i = 0; i < scene->mNumTextures; i++) {
+        const aiTexture* texture = scene->mTextures[i];
+        // A height of 0 means still compressed, with the byte size in
+        // mWidth. Raw texels are not supported.
+        if (texture->mHeight != 0) continue;
+
+        vtx::TextureDecode decode = {};
+        decode.path               = cached->path.c_str();
+        decode.bytes              = texture->pcData;
+        decode.size               = texture->mWidth;
+        decodes.push_back(decode);
+        embedded.push_back(texture);
+    }
+    vtx::decodeTextures(
+        &jobSystem, decodes.data(), (int) decodes.size()
+    );
+
+    for (size_t i = 0; i < decodes.size(); i++) {
+        const vtx::TextureDecode& decode = decodes[i];
+        if (decode.texels == nullptr) continue;
+        if (decode.channels != 3 && decode.channels != 4) {
+            stbi_image_free(decode.texels);
+            continue;
+        }
+        cached->textures[embedded[i]] = {
+            decode.texels, decode.width, decode.height, decode.channels
+        };
+    }
+}
+
+vtx::SceneMesh vtx::findSceneMesh(
+    vtx::ScenePin* pin,
+    const char* meshName,
+    unsigned int importFlags
+)
+{
+    vtx::SceneMesh found     = {};
+    vtx::CachedScene* cached = pin->cached;
+    if (cached == nullptr) return found;
+
+    std::lock_guard<std::mutex> guard(cached->lock);
+    if (cached->scene == nullptr && !cached->failed) {
+        cached->importFlags = importFlags;
+        importCachedScene(cached);
+    } else if (cached->importFlags != importFlags) {
+        std::cerr << cached->path << " was imported with other flags"
+                  << std::endl;
+    }
+    if (cached->scene == nullptr) return found;
+
+    found.scene = cached->scene;
+    auto index  = cached->meshIndices.find(meshName);
+    if (index == cached->meshIndices.end()) {
+        std::cerr << "Error loading mesh: " << meshName << std::endl;
+        return found;
+    }
+    found.meshIndex = index->second;
+    found.mesh      = cached->scene->mMeshes[index->second];
+    found.node      = cached->meshNodes[index->second];
+    return found;
+}
+
+const vtx::SceneTexture* vtx::sceneDiffuseTexture(
+    vtx::ScenePin* pin,
+    const vtx::SceneMesh& mesh
+)
+{
+    vtx::CachedScene* cached = pin->cached;
+    if (cached == nullptr || mesh.mesh == nullptr) return nullptr;
+
+    std::lock_guard<std::mutex> guard(cached->lock);
+    const aiMaterial* material =
+        mesh.scene->mMaterials[mesh.mesh->mMaterialIndex];
+    aiString texturePath;
+    if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) !=
+        AI_SUCCESS) {
+        return nullptr;
+    }
+
+    const aiTexture* embedded =
+        mesh.scene->GetEmbeddedTexture(texturePath.C_Str());
+    auto decoded = cached->textures.find(embedded);
+    if (decoded == cached->textures.end()) return nullptr;
+    return &decoded->second;
+}
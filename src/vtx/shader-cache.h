@@ -0,0 +1,183 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "./cache-file.h"
+
+// WebGL has no program binaries at all, so there the cache is a no-op.
+#ifndef __EMSCRIPTEN__
+#define VTX_SHADER_CACHE
+#endif
+
+// Bump when the file layout changes, old files are then ignored
+#define VTX_SHADER_CACHE_VERSION (1)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// Hash of both sources and the driver, which names the cache file
+uint64_t shaderProgramKey(
+    const char* vertexShader,
+    const char* fragmentShader
+);
+
+// True when a cached binary was found and the driver took it, the
+// program is then linked and ready to use
+bool loadCachedProgram(uint64_t key, GLuint program);
+
+// Call after a successful link, the program must have been linked
+// with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+void storeCachedProgram(uint64_t key, GLuint program);
+
+bool isShaderCacheEnabled();
+}  // namespace vtx
+
+static uint64_t fnv1a(uint64_t hash, const char* text);
+static std::string cachedProgramPath(uint64_t key);
+
+struct CachedProgramHeader {
+    char magic[4];  // "VTXP"
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+};
+
+// **************
+//  Shader cache
+// **************
+
+bool vtx::isShaderCacheEnabled()
+{
+#ifdef VTX_SHADER_CACHE
+    const char* setting = getenv("VTX_SHADER_CACHE");
+    if (setting != nullptr && strcmp(setting, "0") == 0) return false;
+
+    // Core only since 4.1, a 3.3 context needs the extension
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) return false;
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+#else
+    return false;
+#endif
+}
+
+static uint64_t fnv1a(uint64_t hash, const char* text)
+{
+    if (text == nullptr) return hash;
+    for (const char* c = text; *c != '\0'; c++) {
+        hash ^= (uint8_t) *c;
+        hash *= 0x100000001b3ull;
+    }
+    // Mix in the terminator too, so "ab"+"c" and "a"+"bc" differ
+    hash *= 0x100000001b3ull;
+    return hash;
+}
+
+uint64_t vtx::shaderProgramKey(
+    const char* vertexShader,
+    const char* fragmentShader
+)
+{
+    // A driver update may change the binary format without telling,
+    // so its version strings are part of the key
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash          = fnv1a(hash, vertexShader);
+    hash          = fnv1a(hash, fragmentShader);
+    hash = fnv1a(hash, (const char*) glGetString(GL_VENDOR));
+    hash = fnv1a(hash, (const char*) glGetString(GL_RENDERER));
+    hash = fnv1a(hash, (const char*) glGetString(GL_VERSION));
+    return hash;
+}
+
+static std::string cachedProgramPath(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long) key);
+    return std::string(vtx::cacheDirectory()) + name;
+}
+
+// ******************
+//  Load and store
+// ******************
+
+bool vtx::loadCachedProgram(uint64_t key, GLuint program)
+{
+#ifdef VTX_SHADER_CACHE
+    std::string path = cachedProgramPath(key);
+    FILE* file       = fopen(path.c_str(), "rb");
+    if (file == nullptr) return false;
+
+    CachedProgramHeader header;
+    std::vector<char> binary;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, "VTXP", 4) == 0 &&
+                 header.version == VTX_SHADER_CACHE_VERSION;
+    if (valid) {
+        binary.resize(header.binaryLength);
+        valid = fread(binary.data(), 1, binary.size(), file) ==
+                binary.size();
+    }
+    fclose(file);
+    if (!valid) return false;
+
+    glProgramBinary(
+        program, header.binaryFormat, binary.data(),
+        (GLsizei) binary.size()
+    );
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // Rejected binaries may leave an error behind, which must not
+        // reach checkOpenGLError() since we recover by compiling
+        while (glGetError() != GL_NO_ERROR) {
+        }
+        std::cerr << "Shader cache: stale binary " << path << std::endl;
+        remove(path.c_str());
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void vtx::storeCachedProgram(uint64_t key, GLuint program)
+{
+#ifdef VTX_SHADER_CACHE
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(
+        program, length, nullptr, &binaryFormat, binary.data()
+    );
+
+    CachedProgramHeader header;
+    memcpy(header.magic, "VTXP", 4);
+    header.version      = VTX_SHADER_CACHE_VERSION;
+    header.binaryFormat = binaryFormat;
+    header.binaryLength = (uint32_t) length;
+
+    vtx::createCacheDirectory();
+    vtx::writeFileAtomically(cachedProgramPath(key), [&](FILE* file) {
+        size_t bytes = (size_t) length;
+        return fwrite(&header, sizeof(header), 1, file) == 1 &&
+               fwrite(binary.data(), 1, bytes, file) == bytes;
+    });
+#endif
+}
@@ -0,0 +1,488 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "./ctx.h"
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// Names a uniform of one program. It is looked up in the program's
+// table the first time it is set, after that it is just an index until
+// it is set on another program.
+struct UniformHandle {
+    const char* name;
+    mutable uint32_t table = 0;   // the table slot was looked up in
+    mutable int slot       = -1;  // -1 not active
+
+    UniformHandle(const char* name) : name(name) {}
+};
+
+// One active uniform as reported by glGetActiveUniform()
+struct ReflectedUniform {
+    std::string name;  // without the "[0]" of arrays
+    GLint location;
+    GLenum type;
+    GLint size;           // number of array elements, 1 if not array
+    size_t offset;        // where its value starts in the shadow copy
+    size_t elementBytes;  // bytes of one array element
+    int pendingCount;     // elements set but not yet sent to GL
+    bool transpose;       // matrices are sent with transpose
+};
+
+// A value set before the program was reflected, kept by name
+struct QueuedUniform {
+    std::string name;
+    GLenum type;
+    std::vector<unsigned char> data;
+    int count;
+    bool transpose;
+};
+
+// A program with its active uniforms reflected on its first use, once
+// it is linked. Values are only sent to GL when they differ from what
+// GL already has, and are sent when the program is bound, so setting
+// uniforms never binds a program by itself.
+struct ShaderProgram {
+    GLuint id = 0;
+
+    // The label names the program in GL debug messages. Creating it
+    // again deletes the program made before.
+    void create(
+        const char* vertexShader,
+        const char* fragmentShader,
+        const char* label = nullptr
+    );
+    void use() const;
+
+    void set(const UniformHandle& uniform, int value) const;
+    void set(const UniformHandle& uniform, unsigned int value) const;
+    void set(const UniformHandle& uniform, float value) const;
+    void set(
+        const UniformHandle& uniform,
+        const glm::vec2& value
+    ) const;
+    void set(
+        const UniformHandle& uniform,
+        const glm::vec3& value
+    ) const;
+    void set(
+        const UniformHandle& uniform,
+        const glm::vec4& value
+    ) const;
+    void set(
+        const UniformHandle& uniform,
+        const glm::mat3& value
+    ) const;
+    void set(
+        const UniformHandle& uniform,
+        const glm::mat4& value
+    ) const;
+    void set(
+        const UniformHandle& uniform,
+        const glm::mat4* values,
+        int count,
+        bool transpose = false
+    ) const;
+
+    // The uniform table and the shadow copy are a cache of GL state,
+    // so setters stay const like the update*() methods calling them
+    mutable bool reflected = false;
+    mutable uint32_t table = 0;  // tells tables apart for the handles
+    mutable std::vector<ReflectedUniform> uniforms;
+    mutable std::vector<unsigned char> values;
+    mutable std::vector<int> pending;  // slots with pendingCount > 0
+    mutable std::vector<QueuedUniform> queuedUniforms;
+
+    void reflect() const;
+    int findSlot(const UniformHandle& uniform) const;
+    void write(
+        const UniformHandle& uniform,
+        GLenum type,
+        const void* data,
+        int count,
+        bool transpose = false
+    ) const;
+    void queue(
+        const UniformHandle& uniform,
+        GLenum type,
+        const void* data,
+        int count,
+        bool transpose
+    ) const;
+    void flush() const;
+};
+}  // namespace vtx
+
+static size_t uniformElementBytes(GLenum type);
+static bool isIntegerUniform(GLenum type);
+static void uploadUniform(
+    const vtx::ReflectedUniform* uniform,
+    const void* data
+);
+
+// **********************
+//  Global state context
+// **********************
+
+// Numbers the uniform tables, 0 is none
+static uint32_t uniformTableCount = 0;
+
+// **************
+//  Reflection
+// **************
+
+static size_t uniformElementBytes(GLenum type)
+{
+    switch (type) {
+        case GL_FLOAT:
+        case GL_INT:
+        case GL_UNSIGNED_INT:
+        case GL_BOOL:
+            return 4;
+        case GL_FLOAT_VEC2:
+        case GL_INT_VEC2:
+            return 8;
+        case GL_FLOAT_VEC3:
+        case GL_INT_VEC3:
+            return 12;
+        case GL_FLOAT_VEC4:
+        case GL_INT_VEC4:
+        case GL_FLOAT_MAT2:
+            return 16;
+        case GL_FLOAT_MAT3:
+            return 36;
+        case GL_FLOAT_MAT4:
+            return 64;
+    }
+    // Everything else we set is a sampler, which is set as an int
+    return 4;
+}
+
+static bool isIntegerUniform(GLenum type)
+{
+    switch (type) {
+        case GL_FLOAT:
+        case GL_FLOAT_VEC2:
+        case GL_FLOAT_VEC3:
+        case GL_FLOAT_VEC4:
+        case GL_FLOAT_MAT2:
+        case GL_FLOAT_MAT3:
+        case GL_FLOAT_MAT4:
+            return false;
+    }
+    return true;  // ints, bools and samplers
+}
+
+void vtx::ShaderProgram::create(
+    const char* vertexShader,
+    const char* fragmentShader,
+    const char* label
+)
+{
+    VTX_TRACE_SCOPE_DETAIL("ShaderProgram::create", label);
+    // Nothing of the program made before carries over
+    if (this->id != 0) vtx::deleteShaderProgram(this->id);
+    this->reflected = false;
+    this->table     = 0;
+    this->uniforms.clear();
+    this->values.clear();
+    this->pending.clear();
+    this->queuedUniforms.clear();
+
+    this->id =
+        vtx::createShaderProgramAsync(vertexShader, fragmentShader);
+    if (label != nullptr) vtx::labelObject(GL_PROGRAM, this->id, label);
+}
+
+void vtx::ShaderProgram::reflect() const
+{
+    this->reflected = true;
+    this->table     = ++uniformTableCount;
+    this->uniforms.clear();
+    this->values.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(this->id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(this->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength + 1);
+
+    for (GLint i = 0; i < count; i++) {
+        vtx::ReflectedUniform uniform;
+        GLsizei length = 0;
+        glGetActiveUniform(
+            this->id, i, (GLsizei) name.size(), &length, &uniform.size,
+            &uniform.type, name.data()
+        );
+        uniform.name.assign(name.data(), length);
+
+        // Arrays are reported as "u_bones[0]"
+        size_t bracket = uniform.name.find('[');
+        if (bracket != std::string::npos) uniform.name.resize(bracket);
+
+        // Members of uniform blocks have no location of their own
+        uniform.location =
+            glGetUniformLocation(this->id, uniform.name.c_str());
+        if (uniform.location < 0) continue;
+
+        uniform.elementBytes = uniformElementBytes(uniform.type);
+        uniform.offset       = this->values.size();
+        uniform.pendingCount = 0;
+        uniform.transpose    = false;
+        this->values.resize(
+            this->values.size() + uniform.elementBytes * uniform.size
+        );
+        this->uniforms.push_back(uniform);
+    }
+
+    // GL starts every uniform at zero, so the shadow copy does too
+    std::fill(this->values.begin(), this->values.end(), 0);
+}
+
+int vtx::ShaderProgram::findSlot(const UniformHandle& uniform) const
+{
+    if (uniform.table == this->table) return uniform.slot;
+
+    uniform.table = this->table;
+    uniform.slot  = -1;
+    for (size_t i = 0; i < this->uniforms.size(); i++) {
+        if (this->uniforms[i].name == uniform.name) {
+            uniform.slot = (int) i;
+            break;
+        }
+    }
+    // Not an error, the compiler drops uniforms the shader never reads
+    return uniform.slot;
+}
+
+// ******************
+//  Setting uniforms
+// ******************
+
+void vtx::ShaderProgram::write(
+    const UniformHandle& uniform,
+    GLenum type,
+    const void* data,
+    int count,
+    bool transpose
+) const
+{
+    // Reflecting before the first use() would wait for the link
+    if (!this->reflected) {
+        this->queue(uniform, type, data, count, transpose);
+        return;
+    }
+    int slot = this->findSlot(uniform);
+    if (slot < 0) return;
+
+    vtx::ReflectedUniform* reflected = &this->uniforms[slot];
+    bool compatible                  = reflected->type == type;
+    if (isIntegerUniform(type)) {
+        compatible = isIntegerUniform(reflected->type);
+    }
+    if (!compatible) {
+        std::cerr << "Uniform " << uniform.name << " set with type 0x"
+                  << std::hex << type << " but it is 0x"
+                  << reflected->type << std::dec << std::endl;
+        return;
+    }
+
+    count                 = std::min(count, (int) reflected->size);
+    size_t bytes          = reflected->elementBytes * count;
+    unsigned char* shadow = &this->values[reflected->offset];
+    if (memcmp(shadow, data, bytes) == 0 &&
+        reflected->transpose == transpose) {
+        return;
+    }
+
+    memcpy(shadow, data, bytes);
+    reflected->transpose = transpose;
+    if (reflected->pendingCount == 0) this->pending.push_back(slot);
+    reflected->pendingCount = std::max(reflected->pendingCount, count);
+
+    // Already bound, so it can go to GL right away like glUniform*()
+    if (vtx::currentProgram() == this->id) this->flush();
+}
+
+void vtx::ShaderProgram::queue(
+    const UniformHandle& uniform,
+    GLenum type,
+    const void* data,
+    int count,
+    bool transpose
+) const
+{
+    vtx::QueuedUniform* queued = nullptr;
+    for (vtx::QueuedUniform& candidate : this->queuedUniforms) {
+        if (candidate.name == uniform.name) queued = &candidate;
+    }
+    if (queued == nullptr) {
+        queued       = &this->queuedUniforms.emplace_back();
+        queued->name = uniform.name;
+    }
+
+    const unsigned char* bytes = (const unsigned char*) data;
+    size_t byteCount           = uniformElementBytes(type) * count;
+    queued->data.assign(bytes, bytes + byteCount);
+    queued->type      = type;
+    queued->count     = count;
+    queued->transpose = transpose;
+}
+
+void vtx::ShaderProgram::use() const
+{
+    // Finishes the link, so reflecting right after does not wait
+    vtx::useProgram(this->id);
+    if (!this->reflected) {
+        this->reflect();
+        for (const vtx::QueuedUniform& queued : this->queuedUniforms) {
+            vtx::UniformHandle uniform = queued.name.c_str();
+            this->write(
+                uniform, queued.type, queued.data.data(), queued.count,
+                queued.transpose
+            );
+        }
+        this->queuedUniforms.clear();
+    }
+    this->flush();
+}
+
+void vtx::ShaderProgram::flush() const
+{
+    for (int slot : this->pending) {
+        vtx::ReflectedUniform* uniform = &this->uniforms[slot];
+        uploadUniform(uniform, &this->values[uniform->offset]);
+        uniform->pendingCount = 0;
+    }
+    this->pending.clear();
+}
+
+static void uploadUniform(
+    const vtx::ReflectedUniform* uniform,
+    const void* data
+)
+{
+    GLint location        = uniform->location;
+    GLsizei count         = uniform->pendingCount;
+    const GLfloat* floats = (const GLfloat*) data;
+    const GLint* ints     = (const GLint*) data;
+
+    switch (uniform->type) {
+        case GL_FLOAT:
+            glUniform1fv(location, count, floats);
+            break;
+        case GL_FLOAT_VEC2:
+            glUniform2fv(location, count, floats);
+            break;
+        case GL_FLOAT_VEC3:
+            glUniform3fv(location, count, floats);
+            break;
+        case GL_FLOAT_VEC4:
+            glUniform4fv(location, count, floats);
+            break;
+        case GL_FLOAT_MAT3:
+            glUniformMatrix3fv(
+                location, count, uniform->transpose, floats
+            );
+            break;
+        case GL_FLOAT_MAT4:
+            glUniformMatrix4fv(
+                location, count, uniform->transpose, floats
+            );
+            break;
+        case GL_UNSIGNED_INT:
+            glUniform1uiv(location, count, (const GLuint*) data);
+            break;
+        default:
+            glUniform1iv(location, count, ints);
+            break;
+    }
+}
+
+void vtx::ShaderProgram::set(
+    const UniformHandle& uniform,
+    int value
+) const
+{
+    this->write(uniform, GL_INT, &value, 1);
+}
+
+void vtx::ShaderProgram::set(
+    const UniformHandle& uniform,
+    unsigned int value
+) const
+{
+    this->write(uniform, GL_UNSIGNED_INT, &value, 1);
+}
+
+void vtx::ShaderProgram::set(
+    const UniformHandle& uniform,
+    float value
+) const
+{
+    this->write(uniform, GL_FLOAT, &value, 1);
+}
+
+void vtx::ShaderProgram::set(
+    const UniformHandle& uniform,
+    const glm::vec2& value
+) const
+{
+    this->write(uniform, GL_FLOAT_VEC2, glm::value_ptr(value), 1);
+}
+
+void vtx::ShaderProgram::set(
+    const UniformHandle& uniform,
+    const glm::vec3& value
+) const
+{
+    this->write(uniform, GL_FLOAT_VEC3, glm::value_ptr(value), 1);
+}
+
+void vtx::ShaderProgram::set(
+    const UniformHandle& uniform,
+    const glm::vec4& value
+) const
+{
+    this->write(uniform, GL_FLOAT_VEC4, glm::value_ptr(value), 1);
+}
+
+void vtx::ShaderProgram::set(
+    const UniformHandle& uniform,
+    const glm::mat3& value
+) const
+{
+    this->write(uniform, GL_FLOAT_MAT3, glm::value_ptr(value), 1);
+}
+
+void vtx::ShaderProgram::set(
+    const UniformHandle& uniform,
+    const glm::mat4& value
+) const
+{
+    this->write(uniform, GL_FLOAT_MAT4, glm::value_ptr(value), 1);
+}
+
+void vtx::ShaderProgram::set(
+    const UniformHandle& uniform,
+    const glm::mat4* values,
+    int count,
+    bool transpose
+) const
+{
+    this->write(
+        uniform, GL_FLOAT_MAT4, glm::value_ptr(values[0]), count,
+        transpose
+    );
+}
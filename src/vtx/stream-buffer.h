@@ -0,0 +1,272 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "./gl-state.h"
+#include "./gpu-memory.h"
+
+// WebGL has neither buffer mapping nor fences, there the whole buffer
+// is orphaned once per frame and written with glBufferSubData() instead
+#ifndef __EMSCRIPTEN__
+#define VTX_STREAM_MAPPED
+#endif
+
+// Frames a stream buffer is split into, the GPU may read two of them
+// while the third is written
+#define VTX_STREAM_REGIONS (3)
+// Bytes of the stream buffers openVortex() makes, they grow when a
+// single frame needs more than a region
+#define VTX_STREAM_VERTEX_SIZE (3 << 20)
+#define VTX_STREAM_INDEX_SIZE (3 << 18)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// One big buffer for data that lives for a single frame. Each frame
+// writes into its own region with unsynchronized maps, so writing never
+// waits on draws that still read older regions, and a fence per region
+// holds the writer back only if the GPU falls more than the other
+// regions behind.
+struct StreamBuffer {
+    GLuint buffer;
+    GLenum target;      // GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+    size_t size;        // bytes of all regions
+    size_t regionSize;  // bytes one frame may write
+    int region;         // the one this frame writes
+    size_t offset;      // next free byte of it
+    GLsync fences[VTX_STREAM_REGIONS];
+
+    size_t lastUsed;    // bytes written in the last frame
+    int orphans;        // times a frame ran out of room
+    float fenceWaitMs;  // how long the last frame waited for the GPU
+};
+
+// Vertex streams also hold uniform ranges. Index streams are separate,
+// WebGL does not let an element buffer be bound to any other target.
+void createStreamBuffer(
+    vtx::StreamBuffer* stream,
+    GLenum target,
+    size_t size
+);
+void destroyStreamBuffer(vtx::StreamBuffer* stream);
+
+// Copies size bytes into the region of this frame and returns where
+// they went in stream->buffer. The offset is a multiple of alignment,
+// which need not be a power of two, so a vertex stride works and
+// offset / stride is the first vertex to draw. An alignment of 0 is
+// reported and taken as 1.
+//
+// The range is good until the end of the frame, unless a later write
+// runs out of room: that orphans the buffer, and ranges not drawn yet
+// are lost. Draw each range before the next write when a frame may
+// write more than a region, stream->orphans counts how often it did.
+size_t streamWrite(
+    vtx::StreamBuffer* stream,
+    const void* data,
+    size_t size,
+    size_t alignment
+);
+
+// What uniform ranges written to a stream must be aligned to for
+// glBindBufferRange()
+size_t streamUniformAlignment();
+
+// Fences the region of the frame that just ended and moves on to the
+// next one, waiting if the GPU still reads it. Once per frame on the
+// thread that renders, ctx.h does it.
+void advanceStreamBuffer(vtx::StreamBuffer* stream);
+}  // namespace vtx
+
+static GLenum streamWriteTarget(vtx::StreamBuffer* stream);
+static size_t alignStreamOffset(size_t offset, size_t alignment);
+static void orphanStreamBuffer(vtx::StreamBuffer* stream, size_t size);
+
+// **********************
+//  Global state context
+// **********************
+
+static vtx::StreamBuffer vertexStreamBuffer;
+static vtx::StreamBuffer indexStreamBuffer;
+
+// ****************
+//  Stream buffers
+// ****************
+
+// Binds the buffer for writing. Native builds use the copy target,
+// which is not part of any VAO and not shadowed by gl-state.h.
+static GLenum streamWriteTarget(vtx::StreamBuffer* stream)
+{
+#ifdef VTX_STREAM_MAPPED
+    vtx::bindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    return GL_COPY_WRITE_BUFFER;
+#else
+    // Otherwise it would go into whatever VAO is bound
+    if (stream->target == GL_ELEMENT_ARRAY_BUFFER) {
+        vtx::bindVertexArray(0);
+    }
+    vtx::bindBuffer(stream->target, stream->buffer);
+    return stream->target;
+#endif
+}
+
+static size_t alignStreamOffset(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// New storage for the whole buffer. Draws already made keep reading the
+// old one, so every region is free to write and no fence is needed.
+static void orphanStreamBuffer(vtx::StreamBuffer* stream, size_t size)
+{
+    glBufferData(
+        streamWriteTarget(stream), (GLsizeiptr) size, nullptr,
+        GL_STREAM_DRAW
+    );
+    vtx::trackGpuAllocation(
+        GL_BUFFER, stream->buffer, vtx::GPU_MEMORY_STREAMING, size,
+        GL_STREAM_DRAW, 0, 0,
+        stream->target == GL_ELEMENT_ARRAY_BUFFER ? "index stream"
+                                                  : "vertex stream"
+    );
+    stream->size = size;
+#ifdef VTX_STREAM_MAPPED
+    stream->regionSize = size / VTX_STREAM_REGIONS;
+    for (int i = 0; i < VTX_STREAM_REGIONS; i++) {
+        if (stream->fences[i] != nullptr) {
+            glDeleteSync(stream->fences[i]);
+        }
+        stream->fences[i] = nullptr;
+    }
+#else
+    stream->regionSize = size;
+#endif
+    stream->region = 0;
+    stream->offset = 0;
+}
+
+void vtx::createStreamBuffer(
+    vtx::StreamBuffer* stream,
+    GLenum target,
+    size_t size
+)
+{
+    *stream        = {};
+    stream->target = target;
+    glGenBuffers(1, &stream->buffer);
+    orphanStreamBuffer(stream, size);
+}
+
+void vtx::destroyStreamBuffer(vtx::StreamBuffer* stream)
+{
+    if (stream->buffer == 0) return;
+
+    for (int i = 0; i < VTX_STREAM_REGIONS; i++) {
+        if (stream->fences[i] != nullptr) {
+            glDeleteSync(stream->fences[i]);
+        }
+    }
+    vtx::untrackGpuAllocation(GL_BUFFER, stream->buffer);
+    glDeleteBuffers(1, &stream->buffer);
+    // It may still be bound
+    vtx::invalidateGLState();
+    *stream = {};
+}
+
+size_t vtx::streamWrite(
+    vtx::StreamBuffer* stream,
+    const void* data,
+    size_t size,
+    size_t alignment
+)
+{
+    if (alignment == 0) {
+        std::cerr << "streamWrite: alignment 0, taken as 1"
+                  << std::endl;
+        alignment = 1;
+    }
+
+    // Aligned in the whole buffer, regions need not start at a
+    // multiple of a vertex stride
+    size_t base = stream->region * stream->regionSize;
+    size_t at   = alignStreamOffset(base + stream->offset, alignment);
+    if (at + size > base + stream->regionSize) {
+        // Out of room for this frame. Orphaning starts over at the
+        // beginning, grown if a region could never hold this write.
+        size_t grown = stream->size;
+        while (grown / VTX_STREAM_REGIONS < size) grown *= 2;
+        orphanStreamBuffer(stream, grown);
+        stream->orphans++;
+        base = 0;
+        at   = 0;
+    }
+    stream->offset = at - base + size;
+
+    GLenum target = streamWriteTarget(stream);
+#ifdef VTX_STREAM_MAPPED
+    // The fences made sure the GPU is done with this region, so the
+    // driver need not check
+    void* mapped = glMapBufferRange(
+        target, (GLintptr) at, (GLsizeiptr) size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT
+    );
+    if (mapped != nullptr) {
+        memcpy(mapped, data, size);
+        if (glUnmapBuffer(target)) return at;
+    }
+#endif
+    // Freshly orphaned on the web, and where mapping fails the driver
+    // is left to sort it out
+    glBufferSubData(target, (GLintptr) at, (GLsizeiptr) size, data);
+    return at;
+}
+
+size_t vtx::streamUniformAlignment()
+{
+    static GLint alignment = 0;
+    if (alignment == 0) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment <= 0) alignment = 256;
+    }
+    return (size_t) alignment;
+}
+
+void vtx::advanceStreamBuffer(vtx::StreamBuffer* stream)
+{
+    stream->lastUsed    = stream->offset;
+    stream->fenceWaitMs = 0.0f;
+
+#ifdef VTX_STREAM_MAPPED
+    stream->fences[stream->region] =
+        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->region = (stream->region + 1) % VTX_STREAM_REGIONS;
+    stream->offset = 0;
+
+    GLsync fence = stream->fences[stream->region];
+    if (fence == nullptr) return;
+
+    auto start = std::chrono::steady_clock::now();
+    GLenum result;
+    do {
+        result = glClientWaitSync(
+            fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000  // 100 ms
+        );
+    } while (result == GL_TIMEOUT_EXPIRED);
+    stream->fenceWaitMs = std::chrono::duration<float, std::milli>(
+                              std::chrono::steady_clock::now() - start
+    )
+                              .count();
+
+    glDeleteSync(fence);
+    stream->fences[stream->region] = nullptr;
+#else
+    if (stream->offset > 0) orphanStreamBuffer(stream, stream->size);
+#endif
+}
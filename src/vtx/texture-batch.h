@@ -0,0 +1,164 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <stb_image.h>
+
+#include <cstddef>
+#include <iostream>
+
+#include "./gl-state.h"
+#include "./gpu-memory.h"
+#include "./jobs.h"
+#include "./trace.h"
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+// One image to decode, from encoded bytes in memory or from a file
+struct TextureDecode {
+    const char* path;   // read when bytes is null, names it anyway
+    const void* bytes;  // a PNG, JPEG... still encoded
+    size_t size;
+    bool flipVertically;  // only for this image, other threads decode
+                          // with their own setting
+    int desiredChannels;  // 0 keeps what the image has
+
+    // Filled by vtx::decodeTextures()
+    unsigned char* texels;  // nullptr when the image could not be read
+    int width, height, channels;
+
+    // Used by vtx::uploadTextures()
+    bool mipmaps    = true;
+    GLint minFilter = GL_LINEAR;
+    GLint magFilter = GL_LINEAR;
+    GLint wrap      = GL_REPEAT;
+};
+
+// Decodes all of them at once spread over the workers, and returns
+// when the last is done. Any thread may call it.
+void decodeTextures(
+    vtx::JobSystem* jobs,
+    vtx::TextureDecode* decodes,
+    int count
+);
+
+// Creates textures[i] from decodes[i] one after another, then frees
+// the texels. Images that did not decode leave their texture as it
+// was. Call on the thread that owns the GL context.
+void uploadTextures(
+    vtx::TextureDecode* decodes,
+    vtx::GpuTexture* textures,
+    int count
+);
+
+// For decoded images that are not uploaded with vtx::uploadTextures()
+void freeDecodedTextures(vtx::TextureDecode* decodes, int count);
+}  // namespace vtx
+
+static void decodeTexture(vtx::TextureDecode* decode);
+
+// **********
+//  Decoding
+// **********
+
+static void decodeTexture(vtx::TextureDecode* decode)
+{
+    VTX_TRACE_SCOPE_DETAIL("decodeTexture", decode->path);
+
+    // stb_image keeps the flip per thread this way, so images decoded
+    // at the same time do not flip each other
+    stbi_set_flip_vertically_on_load_thread(decode->flipVertically);
+    if (decode->bytes != nullptr) {
+        decode->texels = stbi_load_from_memory(
+            (const stbi_uc*) decode->bytes, (int) decode->size,
+            &decode->width, &decode->height, &decode->channels,
+            decode->desiredChannels
+        );
+    } else {
+        decode->texels = stbi_load(
+            decode->path, &decode->width, &decode->height,
+            &decode->channels, decode->desiredChannels
+        );
+    }
+    stbi_set_flip_vertically_on_load_thread(0);
+
+    if (decode->texels == nullptr) {
+        std::cerr << "Could not decode " << decode->path << ": "
+                  << stbi_failure_reason() << std::endl;
+        return;
+    }
+    // The channels in texels, not the ones in the file
+    if (decode->desiredChannels != 0) {
+        decode->channels = decode->desiredChannels;
+    }
+}
+
+void vtx::decodeTextures(
+    vtx::JobSystem* jobs,
+    vtx::TextureDecode* decodes,
+    int count
+)
+{
+    // One image per job, they take milliseconds each
+    vtx::parallelFor(jobs, count, 1, [decodes](int begin, int end) {
+        for (int i = begin; i < end; i++) decodeTexture(&decodes[i]);
+    });
+}
+
+// ***********
+//  Uploading
+// ***********
+
+void vtx::uploadTextures(
+    vtx::TextureDecode* decodes,
+    vtx::GpuTexture* textures,
+    int count
+)
+{
+    for (int i = 0; i < count; i++) {
+        vtx::TextureDecode* decode = &decodes[i];
+        if (decode->texels == nullptr) continue;
+
+        // Sized internal formats, WebGL 2 takes no unsized red or RG
+        static const GLenum formats[] = {
+            0, GL_RED, GL_RG, GL_RGB, GL_RGBA
+        };
+
+        static const GLenum internalFormats[] = {
+            0, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8
+        };
+        int channels = decode->channels;
+        // Rows of 1, 2 or 3 channels need not be 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        textures[i].create2D(
+            decode->width, decode->height, internalFormats[channels],
+            formats[channels],
+            GL_UNSIGNED_BYTE, decode->texels, decode->mipmaps,
+            decode->path
+        );
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, decode->minFilter
+        );
+        glTexParameteri(
+            GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, decode->magFilter
+        );
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, decode->wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, decode->wrap);
+
+        stbi_image_free(decode->texels);
+        decode->texels = nullptr;
+    }
+    vtx::bindTexture(GL_TEXTURE_2D, 0);
+}
+
+void vtx::freeDecodedTextures(vtx::TextureDecode* decodes, int count)
+{
+    for (int i = 0; i < count; i++) {
+        stbi_image_free(decodes[i].texels);
+        decodes[i].texels = nullptr;
+    }
+}
@@ -0,0 +1,463 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "./cache-file.h"
+
+// Makes no GL call, so the cooker builds without GL. These are the
+// values of the GL enums with the same names.
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
+// Bump when the file layout changes, the cooker must then run again
+#define VTX_COOKED_TEXTURE_VERSION (1)
+// Enough for a 32768 x 32768 chain
+#define VTX_COOKED_TEXTURE_LEVELS (16)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+struct CookedTextureLevel {
+    uint64_t offset;  // from the start of the file
+    uint64_t bytes;
+    uint32_t width, height;
+};
+
+// What the texture cooker writes, the full mip chain twice: in ETC2
+// blocks when it was asked to encode them, and in RGBA8 for GPUs
+// without ETC2. The levels of a chain follow each other in the file.
+struct CookedTextureHeader {
+    char magic[4];  // "VTXT"
+    uint32_t version;
+    uint64_t fileSize;
+    uint32_t width, height;
+    uint32_t levelCount;
+
+    // GL_COMPRESSED_RGB8_ETC2 or GL_COMPRESSED_RGBA8_ETC2_EAC, 0 when
+    // only the RGBA8 chain is there
+    uint32_t etc2Format;
+    vtx::CookedTextureLevel etc2[VTX_COOKED_TEXTURE_LEVELS];
+    vtx::CookedTextureLevel rgba8[VTX_COOKED_TEXTURE_LEVELS];
+};
+
+// Builds the mip chain of an RGBA8 image down to 1x1 with a box filter
+// and writes it to path. With etc2 the chain is also encoded, in RGB
+// ETC2 when every texel is opaque and with EAC alpha otherwise. False
+// when the file cannot be written.
+bool cookTexture(
+    const unsigned char* rgba,
+    int width,
+    int height,
+    bool etc2,
+    const char* path
+);
+
+// A 4x4 block of RGBA8 texels, row after row, into 8 bytes. Uses the
+// modes ETC2 shares with ETC1.
+void encodeEtc2Block(
+    const unsigned char* block,
+    unsigned char* out
+);
+// The alpha of the same block into the 8 bytes of EAC that come first
+// in GL_COMPRESSED_RGBA8_ETC2_EAC
+void encodeEacAlphaBlock(
+    const unsigned char* block,
+    unsigned char* out
+);
+}  // namespace vtx
+
+static int clampTexel(int value);
+static void writeBigEndian(uint64_t bits, unsigned char* out);
+static int fitEtc2Subblock(
+    const unsigned char* block,
+    const int* pixels,
+    const int* color,
+    int* table,
+    int* indices
+);
+static void downsampleLevel(
+    const unsigned char* source,
+    int width,
+    int height,
+    unsigned char* target
+);
+static void encodeEtc2Level(
+    const unsigned char* rgba,
+    int width,
+    int height,
+    uint32_t format,
+    unsigned char* out
+);
+
+// The modifiers of each table. A texel index picks the small or the
+// large one, either added or taken away.
+static const int etc2Modifiers[8][2] = {
+    {2, 8},   {5, 17},  {9, 29},  {13, 42},
+    {18, 60}, {24, 80}, {33, 106}, {47, 183},
+};
+
+static const int eacModifiers[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},  {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},  {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},   {-3, -5, -7, -9, 2, 4, 6, 8},
+};
+
+// **********
+//  Encoding
+// **********
+
+static int clampTexel(int value) { return std::clamp(value, 0, 255); }
+
+// Blocks are stored most significant byte first
+static void writeBigEndian(uint64_t bits, unsigned char* out)
+{
+    for (int i = 0; i < 8; i++) {
+        out[i] = (unsigned char) (bits >> (56 - i * 8));
+    }
+}
+
+// Picks the table, and the index of each of the 8 texels, that come
+// closest around color. Returns the squared error.
+static int fitEtc2Subblock(
+    const unsigned char* block,
+    const int* pixels,
+    const int* color,
+    int* table,
+    int* indices
+)
+{
+    int bestError = INT_MAX;
+    for (int t = 0; t < 8; t++) {
+        int error = 0;
+        int chosen[8];
+        for (int k = 0; k < 8; k++) {
+            const unsigned char* texel = &block[pixels[k] * 4];
+            int bestTexel              = INT_MAX;
+            for (int index = 0; index < 4; index++) {
+                int modifier = etc2Modifiers[t][index & 1];
+                if (index & 2) modifier = -modifier;
+                int texelError = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = clampTexel(color[c] + modifier) - texel[c];
+                    texelError += d * d;
+                }
+                if (texelError < bestTexel) {
+                    bestTexel = texelError;
+                    chosen[k] = index;
+                }
+            }
+            error += bestTexel;
+        }
+        if (error < bestError) {
+            bestError = error;
+            *table    = t;
+            for (int k = 0; k < 8; k++) indices[pixels[k]] = chosen[k];
+        }
+    }
+    return bestError;
+}
+
+void vtx::encodeEtc2Block(
+    const unsigned char* block,
+    unsigned char* out
+)
+{
+    uint64_t bestBits = 0;
+    int bestError     = INT_MAX;
+    for (int flip = 0; flip < 2; flip++) {
+        // Two halves side by side, or one above the other when flipped
+        int pixels[2][8], sums[2][3] = {};
+        int count[2] = {};
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                int half = flip ? y / 2 : x / 2;
+                pixels[half][count[half]++] = y * 4 + x;
+                for (int c = 0; c < 3; c++) {
+                    sums[half][c] += block[(y * 4 + x) * 4 + c];
+                }
+            }
+        }
+
+        // Differential keeps 5 bits a channel, when the two colours are
+        // close enough. Individual keeps 4 bits of each.
+        for (int differential = 1; differential >= 0; differential--) {
+            int bits = differential ? 31 : 15;
+            int q[2][3], color[2][3];
+            for (int half = 0; half < 2; half++) {
+                for (int c = 0; c < 3; c++) {
+                    int value  = (sums[half][c] * bits + 1020) / 2040;
+                    q[half][c] = value;
+                    if (differential) {
+                        color[half][c] = (value << 3) | (value >> 2);
+                    } else {
+                        color[half][c] = value * 17;
+                    }
+                }
+            }
+            bool fits = true;
+            for (int c = 0; c < 3 && differential; c++) {
+                int delta = q[1][c] - q[0][c];
+                fits      = fits && delta >= -4 && delta <= 3;
+            }
+            if (!fits) continue;
+
+            int tables[2], indices[16];
+            int error = 0;
+            for (int half = 0; half < 2; half++) {
+                error += fitEtc2Subblock(
+                    block, pixels[half], color[half], &tables[half],
+                    indices
+                );
+            }
+            if (error >= bestError) continue;
+            bestError = error;
+
+            uint64_t packed = 0;
+            for (int c = 0; c < 3; c++) {
+                int shift = 56 - c * 8;  // red, green, then blue
+                if (differential) {
+                    packed |= (uint64_t) q[0][c] << (shift + 3);
+                    packed |= (uint64_t) ((q[1][c] - q[0][c]) & 7)
+                              << shift;
+                } else {
+                    packed |= (uint64_t) q[0][c] << (shift + 4);
+                    packed |= (uint64_t) q[1][c] << shift;
+                }
+            }
+            packed |= (uint64_t) tables[0] << 37;
+            packed |= (uint64_t) tables[1] << 34;
+            packed |= (uint64_t) differential << 33;
+            packed |= (uint64_t) flip << 32;
+            // Texel indices go column after column, split in a high
+            // and a low bit
+            for (int i = 0; i < 16; i++) {
+                int bit = (i % 4) * 4 + i / 4;
+                packed |= (uint64_t) (indices[i] >> 1) << (16 + bit);
+                packed |= (uint64_t) (indices[i] & 1) << bit;
+            }
+            bestBits = packed;
+        }
+    }
+    writeBigEndian(bestBits, out);
+}
+
+void vtx::encodeEacAlphaBlock(
+    const unsigned char* block,
+    unsigned char* out
+)
+{
+    int low = 255, high = 0;
+    for (int i = 0; i < 16; i++) {
+        low  = std::min(low, (int) block[i * 4 + 3]);
+        high = std::max(high, (int) block[i * 4 + 3]);
+    }
+
+    // Table 13 has a 0 modifier at index 4, which is exact when every
+    // texel has the same alpha
+    int bestBase = low, bestMultiplier = 1, bestTable = 13;
+    int bestIndices[16];
+    std::fill(bestIndices, bestIndices + 16, 4);
+
+    // The multiplier stretches the table over the alpha range, only
+    // the ones around that are tried
+    int bestError = INT_MAX;
+    for (int t = 0; t < 16 && low != high; t++) {
+        int span  = eacModifiers[t][7] - eacModifiers[t][3];
+        int guess = (high - low + span / 2) / span;
+        for (int m = guess - 1; m <= guess + 1; m++) {
+            if (m < 1 || m > 15) continue;
+            int base = clampTexel(
+                (low + high) / 2 -
+                (eacModifiers[t][3] + eacModifiers[t][7]) * m / 2
+            );
+            int error = 0, indices[16];
+            for (int i = 0; i < 16; i++) {
+                int alpha     = block[i * 4 + 3];
+                int bestAlpha = INT_MAX;
+                for (int index = 0; index < 8; index++) {
+                    int modifier = eacModifiers[t][index] * m;
+                    int d        = clampTexel(base + modifier) - alpha;
+                    if (d * d < bestAlpha) {
+                        bestAlpha  = d * d;
+                        indices[i] = index;
+                    }
+                }
+                error += bestAlpha;
+            }
+            if (error < bestError) {
+                bestError      = error;
+                bestBase       = base;
+                bestMultiplier = m;
+                bestTable      = t;
+                std::copy(indices, indices + 16, bestIndices);
+            }
+        }
+    }
+
+    uint64_t packed = (uint64_t) bestBase << 56;
+    packed |= (uint64_t) bestMultiplier << 52;
+    packed |= (uint64_t) bestTable << 48;
+    // Three bits a texel, column after column from the top
+    for (int i = 0; i < 16; i++) {
+        int position = (i % 4) * 4 + i / 4;
+        packed |= (uint64_t) bestIndices[i] << (45 - position * 3);
+    }
+    writeBigEndian(packed, out);
+}
+
+// Blocks past the edge of small levels repeat the last row and column
+static void encodeEtc2Level(
+    const unsigned char* rgba,
+    int width,
+    int height,
+    uint32_t format,
+    unsigned char* out
+)
+{
+    unsigned char block[64];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            for (int y = 0; y < 4; y++) {
+                for (int x = 0; x < 4; x++) {
+                    int sx = std::min(bx + x, width - 1);
+                    int sy = std::min(by + y, height - 1);
+                    memcpy(
+                        &block[(y * 4 + x) * 4],
+                        &rgba[((size_t) sy * width + sx) * 4], 4
+                    );
+                }
+            }
+            if (format == GL_COMPRESSED_RGBA8_ETC2_EAC) {
+                vtx::encodeEacAlphaBlock(block, out);
+                out += 8;
+            }
+            vtx::encodeEtc2Block(block, out);
+            out += 8;
+        }
+    }
+}
+
+// *********
+//  Cooking
+// *********
+
+// Averages 2x2 texels, an odd last row or column is dropped the way
+// glGenerateMipmap often does
+static void downsampleLevel(
+    const unsigned char* source,
+    int width,
+    int height,
+    unsigned char* target
+)
+{
+    int targetWidth  = std::max(width / 2, 1);
+    int targetHeight = std::max(height / 2, 1);
+    for (int y = 0; y < targetHeight; y++) {
+        for (int x = 0; x < targetWidth; x++) {
+            int x0 = std::min(x * 2, width - 1);
+            int x1 = std::min(x * 2 + 1, width - 1);
+            int y0 = std::min(y * 2, height - 1);
+            int y1 = std::min(y * 2 + 1, height - 1);
+            for (int c = 0; c < 4; c++) {
+                int sum = source[((size_t) y0 * width + x0) * 4 + c] +
+                          source[((size_t) y0 * width + x1) * 4 + c] +
+                          source[((size_t) y1 * width + x0) * 4 + c] +
+                          source[((size_t) y1 * width + x1) * 4 + c];
+                target[((size_t) y * targetWidth + x) * 4 + c] =
+                    (unsigned char) ((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+bool vtx::cookTexture(
+    const unsigned char* rgba,
+    int width,
+    int height,
+    bool etc2,
+    const char* path
+)
+{
+    vtx::CookedTextureHeader header = {};
+    memcpy(header.magic, "VTXT", 4);
+    header.version = VTX_COOKED_TEXTURE_VERSION;
+    header.width   = (uint32_t) width;
+    header.height  = (uint32_t) height;
+
+    std::vector<std::vector<unsigned char>> levels;
+    levels.emplace_back(rgba, rgba + (size_t) width * height * 4);
+    for (int w = width, h = height; w > 1 || h > 1;) {
+        if (levels.size() == VTX_COOKED_TEXTURE_LEVELS) return false;
+        std::vector<unsigned char> next(
+            (size_t) std::max(w / 2, 1) * std::max(h / 2, 1) * 4
+        );
+        downsampleLevel(levels.back().data(), w, h, next.data());
+        levels.push_back(std::move(next));
+        w = std::max(w / 2, 1);
+        h = std::max(h / 2, 1);
+    }
+    header.levelCount = (uint32_t) levels.size();
+
+    if (etc2) {
+        bool opaque = true;
+        for (size_t i = 3; i < levels[0].size() && opaque; i += 4) {
+            opaque = levels[0][i] == 255;
+        }
+        header.etc2Format = opaque ? GL_COMPRESSED_RGB8_ETC2
+                                   : GL_COMPRESSED_RGBA8_ETC2_EAC;
+    }
+
+    // The ETC2 chain first, then the RGBA8 one
+    std::vector<std::vector<unsigned char>> blocks(levels.size());
+    uint64_t offset = sizeof(header);
+    for (size_t i = 0; i < levels.size() && etc2; i++) {
+        uint32_t w = std::max(header.width >> i, 1u);
+        uint32_t h = std::max(header.height >> i, 1u);
+        size_t blockBytes =
+            header.etc2Format == GL_COMPRESSED_RGB8_ETC2 ? 8 : 16;
+        blocks[i].resize(((w + 3) / 4) * ((h + 3) / 4) * blockBytes);
+        encodeEtc2Level(
+            levels[i].data(), (int) w, (int) h, header.etc2Format,
+            blocks[i].data()
+        );
+        header.etc2[i] = {offset, blocks[i].size(), w, h};
+        offset += blocks[i].size();
+    }
+    for (size_t i = 0; i < levels.size(); i++) {
+        uint32_t w      = std::max(header.width >> i, 1u);
+        uint32_t h      = std::max(header.height >> i, 1u);
+        header.rgba8[i] = {offset, levels[i].size(), w, h};
+        offset += levels[i].size();
+    }
+    header.fileSize = offset;
+
+    return vtx::writeFileAtomically(path, [&](FILE* file) {
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+        for (const auto* chain : {&blocks, &levels}) {
+            for (const auto& level : *chain) {
+                size_t size = level.size();
+                if (fwrite(level.data(), 1, size, file) != size) {
+                    written = false;
+                }
+            }
+        }
+        return written;
+    });
+}
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Events one thread keeps. The first VTX_TRACE_PINNED_EVENTS are never
+// overwritten, so startup stays in the trace, the rest is a ring of the
+// newest events.
+#define VTX_TRACE_EVENTS (1 << 15)
+#define VTX_TRACE_PINNED_EVENTS (4096)
+// Threads that can record, later ones are not traced
+#define VTX_TRACE_MAX_THREADS (64)
+// Bytes of the detail text an event keeps, longer ones are cut
+#define VTX_TRACE_DETAIL (40)
+
+// *******************************
+//  Declarations of all functions
+// *******************************
+
+namespace vtx {
+struct TraceEvent {
+    const char* name;  // must outlive the trace, string literals do
+    int64_t start;     // nanoseconds since the tracer started
+    int64_t duration;  // nanoseconds, -1 for instant events
+    char detail[VTX_TRACE_DETAIL];
+};
+
+// Written by its own thread only. The flushing thread reads the events
+// below head while they may be overwritten, and drops the ones the
+// head has passed by the time it is done.
+struct TraceBuffer {
+    std::atomic<uint64_t> head{0};  // events recorded so far
+    int tid;
+    char threadName[32];
+    TraceEvent events[VTX_TRACE_EVENTS];
+};
+
+struct Tracer {
+    // -1 until VTX_TRACE is first looked at, then 0 or 1
+    std::atomic<int> enabled{-1};
+    std::string path;  // where the trace is written
+    std::chrono::steady_clock::time_point origin;
+    std::atomic<int> threadCount{0};
+    std::atomic<TraceBuffer*> threads[VTX_TRACE_MAX_THREADS];
+};
+
+// Tracing is on when VTX_TRACE names the file to write, which happens
+// when the program exits and when F9 is pressed
+bool isTraceEnabled();
+
+// Appears in the trace viewer instead of the thread id
+void setTraceThreadName(const char* name);
+
+int64_t traceClock();
+void recordTraceEvent(
+    const char* name,
+    int64_t start,
+    int64_t duration,
+    const char* detail
+);
+
+// Chrome Trace Event JSON, which Perfetto and chrome://tracing open.
+// Safe to call while other threads record.
+bool writeTrace(const char* path);
+
+struct TraceScopeGuard {
+    const char* name;
+    const char* detail;
+    int64_t start;
+
+    TraceScopeGuard(const char* name, const char* detail = nullptr)
+        : name(name),
+          detail(detail),
+          start(isTraceEnabled() ? traceClock() : -1)
+    {
+    }
+    ~TraceScopeGuard()
+    {
+        if (start < 0) return;
+        recordTraceEvent(name, start, traceClock() - start, detail);
+    }
+};
+}  // namespace vtx
+
+static vtx::TraceBuffer* traceBuffer();
+static void writeTraceString(FILE* file, const char* text);
+
+#ifdef VTX_DISABLE_TRACE
+#define VTX_TRACE_SCOPE(name)
+#define VTX_TRACE_SCOPE_DETAIL(name, detail)
+#define VTX_TRACE_INSTANT(name)
+#else
+#define VTX_TRACE_CONCAT_(a, b) a##b
+#define VTX_TRACE_CONCAT(a, b) VTX_TRACE_CONCAT_(a, b)
+// Time of the enclosing block
+#define VTX_TRACE_SCOPE(name)                                          \
+    vtx::TraceScopeGuard VTX_TRACE_CONCAT(vtxTraceScope, __LINE__)(name)
+// The same, with a string shown next to it, like a file name. It is
+// read when the block ends.
+#define VTX_TRACE_SCOPE_DETAIL(name, detail)                           \
+    vtx::TraceScopeGuard VTX_TRACE_CONCAT(vtxTraceScope, __LINE__)(    \
+        name, detail                                                   \
+    )
+// A moment rather than a span
+#define VTX_TRACE_INSTANT(name)                                        \
+    if (vtx::isTraceEnabled()) {                                       \
+        vtx::recordTraceEvent(name, vtx::traceClock(), -1, nullptr);   \
+    }
+#endif
+
+// **********************
+//  Global state context
+// **********************
+
+static vtx::Tracer tracer;
+static thread_local vtx::TraceBuffer* threadTraceBuffer;
+
+// ***********
+//  Recording
+// ***********
+
+bool vtx::isTraceEnabled()
+{
+    int enabled = tracer.enabled.load(std::memory_order_relaxed);
+    if (enabled >= 0) return enabled == 1;
+
+    // The first event comes from the main thread before any other
+    // thread starts, so this runs once
+    const char* path = getenv("VTX_TRACE");
+    tracer.origin    = std::chrono::steady_clock::now();
+    if (path != nullptr && path[0] != '\0') tracer.path = path;
+    tracer.enabled.store(tracer.path.empty() ? 0 : 1);
+    return !tracer.path.empty();
+}
+
+int64_t vtx::traceClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - tracer.origin
+    )
+        .count();
+}
+
+// The buffer of the calling thread, made on its first event
+static vtx::TraceBuffer* traceBuffer()
+{
+    if (threadTraceBuffer != nullptr) return threadTraceBuffer;
+
+    int slot = tracer.threadCount.fetch_add(1);
+    if (slot >= VTX_TRACE_MAX_THREADS) return nullptr;
+
+    auto* buffer = new vtx::TraceBuffer();
+    buffer->tid  = slot + 1;
+    snprintf(
+        buffer->threadName, sizeof(buffer->threadName), "thread %d",
+        buffer->tid
+    );
+    tracer.threads[slot].store(buffer, std::memory_order_release);
+    threadTraceBuffer = buffer;
+    return buffer;
+}
+
+void vtx::setTraceThreadName(const char* name)
+{
+    if (!vtx::isTraceEnabled()) return;
+    vtx::TraceBuffer* buffer = traceBuffer();
+    if (buffer == nullptr) return;
+    snprintf(
+        buffer->threadName, sizeof(buffer->threadName), "%s", name
+    );
+}
+
+void vtx::recordTraceEvent(
+    const char* name,
+    int64_t start,
+    int64_t duration,
+    const char* detail
+)
+{
+    vtx::TraceBuffer* buffer = traceBuffer();
+    if (buffer == nullptr) return;
+
+    uint64_t index = buffer->head.load(std::memory_order_relaxed);
+    uint64_t slot  = index;
+    if (index >= VTX_TRACE_PINNED_EVENTS) {
+        slot = VTX_TRACE_PINNED_EVENTS +
+               (index - VTX_TRACE_PINNED_EVENTS) %
+                   (VTX_TRACE_EVENTS - VTX_TRACE_PINNED_EVENTS);
+    }
+
+    vtx::TraceEvent* event = &buffer->events[slot];
+    event->name            = name;
+    event->start           = start;
+    event->duration        = duration;
+    event->detail[0]       = '\0';
+    if (detail != nullptr) {
+        snprintf(event->detail, VTX_TRACE_DETAIL, "%s", detail);
+    }
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+// **********
+//  Flushing
+// **********
+
+static void writeTraceString(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if ((unsigned char) *c < 0x20) {
+            fputc(' ', file);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+bool vtx::writeTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        std::cerr << "Could not write trace to " << path << std::endl;
+        return false;
+    }
+
+    const uint64_t ring = VTX_TRACE_EVENTS - VTX_TRACE_PINNED_EVENTS;
+    std::vector<vtx::TraceEvent> events;
+    size_t written = 0;
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    int threadCount = std::min(
+        tracer.threadCount.load(), (int) VTX_TRACE_MAX_THREADS
+    );
+    for (int t = 0; t < threadCount; t++) {
+        vtx::TraceBuffer* buffer =
+            tracer.threads[t].load(std::memory_order_acquire);
+        if (buffer == nullptr) continue;  // still being registered
+
+        fprintf(
+            file,
+            "%s{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+            "\"name\": \"thread_name\", \"args\": {\"name\": ",
+            written++ > 0 ? ",\n" : "", buffer->tid
+        );
+        writeTraceString(file, buffer->threadName);
+        fprintf(file, "}}");
+
+        // Copied first, then whatever the writer may have overwritten
+        // meanwhile is dropped
+        uint64_t head   = buffer->head.load(std::memory_order_acquire);
+        uint64_t pinned =
+            std::min(head, (uint64_t) VTX_TRACE_PINNED_EVENTS);
+        uint64_t first  = head > pinned + ring ? head - ring : pinned;
+        events.clear();
+        for (uint64_t i = 0; i < pinned; i++) {
+            events.push_back(buffer->events[i]);
+        }
+        for (uint64_t i = first; i < head; i++) {
+            uint64_t slot = VTX_TRACE_PINNED_EVENTS +
+                            (i - VTX_TRACE_PINNED_EVENTS) % ring;
+            events.push_back(buffer->events[slot]);
+        }
+        uint64_t after = buffer->head.load(std::memory_order_acquire);
+        size_t keepFrom = 0;
+        if (after > pinned + ring && after - ring > first) {
+            keepFrom = (size_t) (after - ring - first);
+        }
+
+        for (size_t e = 0; e < events.size(); e++) {
+            if (e >= pinned && e - pinned < keepFrom) continue;
+            const vtx::TraceEvent& event = events[e];
+            fprintf(file, ",\n{\"name\": ");
+            writeTraceString(file, event.name);
+            if (event.duration < 0) {
+                fprintf(
+                    file,
+                    ", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, "
+                    "\"tid\": %d, \"ts\": %.3f",
+                    buffer->tid, (double) event.start / 1000.0
+                );
+            } else {
+                fprintf(
+                    file,
+                    ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                    "\"ts\": %.3f, \"dur\": %.3f",
+                    buffer->tid, (double) event.start / 1000.0,
+                    (double) event.duration / 1000.0
+                );
+            }
+            if (event.detail[0] != '\0') {
+                fprintf(file, ", \"args\": {\"detail\": ");
+                writeTraceString(file, event.detail);
+                fprintf(file, "}");
+            }
+            fprintf(file, "}");
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    std::cerr << "Trace written to " << path << std::endl;
+    return true;
+}
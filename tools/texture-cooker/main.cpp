@@ -0,0 +1,65 @@
+// Cooks images into .vtxt files, see "Cooked textures" in the README.
+// Usage: texture-cooker [--etc2] [--flip] image...
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "../../src/vtx/texture-cooker.h"
+
+// heart.png cooks to heart.vtxt next to it
+static std::string cookedPath(const char* imagePath)
+{
+    std::string path = imagePath;
+    size_t dot       = path.find_last_of('.');
+    size_t slash     = path.find_last_of('/');
+    if (dot != std::string::npos &&
+        (slash == std::string::npos || dot > slash)) {
+        path.erase(dot);
+    }
+    return path + ".vtxt";
+}
+
+int main(int argc, char** argv)
+{
+    bool etc2    = false;
+    bool flip    = false;
+    int failures = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--etc2") == 0) {
+            etc2 = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--flip") == 0) {
+            flip = true;
+            continue;
+        }
+
+        // Flipped like the runtime would before glTexImage2D
+        stbi_set_flip_vertically_on_load(flip);
+        int width, height, channels;
+        unsigned char* rgba =
+            stbi_load(argv[i], &width, &height, &channels, 4);
+        if (rgba == nullptr) {
+            std::cerr << "Could not decode " << argv[i] << ": "
+                      << stbi_failure_reason() << std::endl;
+            failures++;
+            continue;
+        }
+
+        std::string path = cookedPath(argv[i]);
+        if (vtx::cookTexture(rgba, width, height, etc2, path.c_str())) {
+            std::cerr << "Cooked " << path << " " << width << "x"
+                      << height << (etc2 ? " with ETC2" : "")
+                      << std::endl;
+        } else {
+            std::cerr << "Could not write " << path << std::endl;
+            failures++;
+        }
+        stbi_image_free(rgba);
+    }
+    return failures == 0 ? 0 : 1;
+}